@@ -338,6 +338,11 @@ int sqlite3Fts3PutVarint(char *p, sqlite_int64 v){
 int sqlite3Fts3GetVarint(const char *p, sqlite_int64 *v){
   const unsigned char *q = (const unsigned char *) p;
   sqlite_uint64 x = 0, y = 1;
+  if( (*q&0x80)==0 ){
+    /* Most docid deltas and positions fit in a single byte. */
+    *v = *q;
+    return 1;
+  }
   while( (*q&0x80)==0x80 && q-(unsigned char *)p<FTS3_VARINT_MAX ){
     x += y * (*q++ & 0x7f);
     y <<= 7;
@@ -1287,7 +1292,7 @@ static int fts3InitVtab(
   p->bHasStat = isFts4;
   p->bFts4 = isFts4;
   p->bDescIdx = bDescIdx;
-  p->bAutoincrmerge = 0xff;   /* 0xff means setting unknown */
+  p->nAutoincrmerge = 0xff;   /* 0xff means setting unknown */
   p->zContentTbl = zContent;
   p->zLanguageid = zLanguageid;
   zContent = 0;
@@ -1522,6 +1527,7 @@ static int fts3CloseMethod(sqlite3_vtab_cursor *pCursor){
   sqlite3Fts3FreeDeferredTokens(pCsr);
   sqlite3_free(pCsr->aDoclist);
   sqlite3_free(pCsr->aMatchinfo);
+  sqlite3_free(pCsr->aBm25);
   assert( ((Fts3Table *)pCsr->base.pVtab)->pSegments==0 );
   sqlite3_free(pCsr);
   return SQLITE_OK;
@@ -1825,6 +1831,32 @@ static void fts3PoslistCopy(char **pp, char **ppPoslist){
   *ppPoslist = pEnd;
 }
 
+/*
+** This does the same as fts3PoslistCopy(0, ppPoslist), for a position
+** list that ends before pEnd.  Instead of testing one byte at a time, the
+** POS_END terminator is found with memchr(), which the C library runs a
+** word or vector at a time.  Stepping over the position lists of a common
+** term is most of the work of merging its doclist with that of a rare
+** one, and common terms have the longest position lists.
+**
+** If there is no terminator before pEnd (a corrupt doclist), *ppPoslist
+** is set to pEnd.
+*/
+static void fts3PoslistSkip(char **ppPoslist, char *pEnd){
+  char *pStart = *ppPoslist;
+  char *p = pStart;
+  char *pZero;
+
+  /* As in fts3PoslistCopy(), a 0x00 byte preceded by a byte with the 0x80
+  ** bit set is the tail of a multi-byte varint, not a POS_END. */
+  while( (pZero = memchr(p, 0, pEnd-p))!=0
+      && pZero>pStart && (pZero[-1]&0x80)
+  ){
+    p = pZero+1;
+  }
+  *ppPoslist = pZero ? pZero+1 : pEnd;
+}
+
 /*
 ** When this function is called, *ppPoslist is assumed to point to the 
 ** start of a column-list. After it returns, *ppPoslist points to the
@@ -2342,12 +2374,18 @@ static int fts3DoclistOrMerge(
       fts3GetDeltaVarint3(&p1, pEnd1, bDescDoclist, &i1);
       fts3GetDeltaVarint3(&p2, pEnd2, bDescDoclist, &i2);
     }else if( !p2 || (p1 && iDiff<0) ){
+      char *pList = p1;
       fts3PutDeltaVarint3(&p, bDescDoclist, &iPrev, &bFirstOut, i1);
-      fts3PoslistCopy(&p, &p1);
+      fts3PoslistSkip(&p1, pEnd1);
+      memcpy(p, pList, p1-pList);
+      p += p1-pList;
       fts3GetDeltaVarint3(&p1, pEnd1, bDescDoclist, &i1);
     }else{
+      char *pList = p2;
       fts3PutDeltaVarint3(&p, bDescDoclist, &iPrev, &bFirstOut, i2);
-      fts3PoslistCopy(&p, &p2);
+      fts3PoslistSkip(&p2, pEnd2);
+      memcpy(p, pList, p2-pList);
+      p += p2-pList;
       fts3GetDeltaVarint3(&p2, pEnd2, bDescDoclist, &i2);
     }
   }
@@ -2409,10 +2447,10 @@ static void fts3DoclistPhraseMerge(
       fts3GetDeltaVarint3(&p1, pEnd1, bDescDoclist, &i1);
       fts3GetDeltaVarint3(&p2, pEnd2, bDescDoclist, &i2);
     }else if( iDiff<0 ){
-      fts3PoslistCopy(0, &p1);
+      fts3PoslistSkip(&p1, pEnd1);
       fts3GetDeltaVarint3(&p1, pEnd1, bDescDoclist, &i1);
     }else{
-      fts3PoslistCopy(0, &p2);
+      fts3PoslistSkip(&p2, pEnd2);
       fts3GetDeltaVarint3(&p2, pEnd2, bDescDoclist, &i2);
     }
   }
@@ -2954,6 +2992,7 @@ static int fts3FilterMethod(
   /* In case the cursor has been used before, clear it now. */
   sqlite3_finalize(pCsr->pStmt);
   sqlite3_free(pCsr->aDoclist);
+  sqlite3_free(pCsr->aBm25);
   sqlite3Fts3ExprFree(pCsr->pExpr);
   memset(&pCursor[1], 0, sizeof(Fts3Cursor)-sizeof(sqlite3_vtab_cursor));
 
@@ -3144,7 +3183,10 @@ static int fts3SyncMethod(sqlite3_vtab *pVtab){
   Fts3Table *p = (Fts3Table*)pVtab;
   int rc = sqlite3Fts3PendingTermsFlush(p);
 
-  if( rc==SQLITE_OK && p->bAutoincrmerge==1 && p->nLeafAdd>(nMinMerge/16) ){
+  if( rc==SQLITE_OK
+   && p->nAutoincrmerge && p->nAutoincrmerge!=0xff
+   && p->nLeafAdd>(nMinMerge/16)
+  ){
     int mxLevel = 0;              /* Maximum relative level value in db */
     int A;                        /* Incr-merge parameter A */
 
@@ -3152,7 +3194,7 @@ static int fts3SyncMethod(sqlite3_vtab *pVtab){
     assert( rc==SQLITE_OK || mxLevel==0 );
     A = p->nLeafAdd * mxLevel;
     A += (A/2);
-    if( A>(int)nMinMerge ) rc = sqlite3Fts3Incrmerge(p, A, 8);
+    if( A>(int)nMinMerge ) rc = sqlite3Fts3Incrmerge(p, A, p->nAutoincrmerge);
   }
   sqlite3Fts3SegmentsClose(p);
   return rc;
@@ -3371,6 +3413,21 @@ static void fts3MatchinfoFunc(
   }
 }
 
+/*
+** Implementation of the bm25() function for FTS3
+*/
+static void fts3Bm25Func(
+  sqlite3_context *pContext,      /* SQLite function call context */
+  int nVal,                       /* Size of argument array */
+  sqlite3_value **apVal           /* Array of arguments */
+){
+  Fts3Cursor *pCsr;               /* Cursor handle passed through apVal[0] */
+  assert( nVal>=1 );
+  if( SQLITE_OK==fts3FunctionArg(pContext, "bm25", apVal[0], &pCsr) ){
+    sqlite3Fts3Bm25(pContext, pCsr, nVal-1, &apVal[1]);
+  }
+}
+
 /*
 ** This routine implements the xFindFunction method for the FTS3
 ** virtual table.
@@ -3390,6 +3447,7 @@ static int fts3FindFunctionMethod(
     { "offsets", fts3OffsetsFunc },
     { "optimize", fts3OptimizeFunc },
     { "matchinfo", fts3MatchinfoFunc },
+    { "bm25", fts3Bm25Func },
   };
   int i;                          /* Iterator variable */
 
@@ -3637,6 +3695,7 @@ int sqlite3Fts3Init(sqlite3 *db){
    && SQLITE_OK==(rc = sqlite3_overload_function(db, "matchinfo", 1))
    && SQLITE_OK==(rc = sqlite3_overload_function(db, "matchinfo", 2))
    && SQLITE_OK==(rc = sqlite3_overload_function(db, "optimize", 1))
+   && SQLITE_OK==(rc = sqlite3_overload_function(db, "bm25", -1))
   ){
     rc = sqlite3_create_module_v2(
         db, "fts3", &fts3Module, (void *)pHash, hashDestroy
@@ -4114,6 +4173,68 @@ static int fts3EvalPhraseNext(
   return rc;
 }
 
+/*
+** Advance the phrase iterator to the first docid that is not smaller than
+** iTarget (not larger, if the cursor visits rows in descending order).
+** If there is no such docid, set *pbEof to 1.  This is used to leap-frog
+** the iterators of an AND or NEAR expression to a common docid.
+**
+** If the whole doclist is in memory and is being read in index order,
+** entries before the target are skipped by a tight scan that decodes
+** only the docids, without visiting each one as a separate row.
+** Otherwise the iterator is simply advanced one row at a time.
+*/
+static int fts3EvalPhraseSkip(
+  Fts3Cursor *pCsr,               /* FTS Cursor handle */
+  Fts3Phrase *p,                  /* Phrase object to advance */
+  sqlite3_int64 iTarget,          /* Docid to advance to */
+  u8 *pbEof                       /* OUT: Set to 1 if EOF */
+){
+  int rc = SQLITE_OK;
+  int bDescDoclist = pCsr->bDesc;         /* Used by DOCID_CMP() macro */
+  Fts3Doclist *pDL = &p->doclist;
+  Fts3Table *pTab = (Fts3Table *)pCsr->base.pVtab;
+
+  if( p->bIncr==0 && pCsr->bDesc==pTab->bDescIdx && pDL->nAll ){
+    char *pEnd = &pDL->aAll[pDL->nAll];   /* 1 byte past end of aAll */
+    char *pIter;                          /* Used to iterate through aAll */
+    char *pList;                          /* Position list of iDocid */
+    sqlite3_int64 iDocid = pDL->iDocid;   /* Docid of current entry */
+    int bFirst = (pDL->pNextDocid==0);    /* True before the first entry */
+
+    pIter = bFirst ? pDL->aAll : pDL->pNextDocid;
+    do{
+      sqlite3_int64 iDelta;
+      while( pIter<pEnd && *pIter==0 ) pIter++;
+      if( pIter>=pEnd ){
+        *pbEof = 1;
+        return SQLITE_OK;
+      }
+      pIter += sqlite3Fts3GetVarint(pIter, &iDelta);
+      if( pTab->bDescIdx==0 || bFirst ){
+        iDocid += iDelta;
+      }else{
+        iDocid -= iDelta;
+      }
+      bFirst = 0;
+      pList = pIter;
+      fts3PoslistSkip(&pIter, pEnd);
+    }while( DOCID_CMP(iDocid, iTarget)<0 );
+
+    pDL->iDocid = iDocid;
+    pDL->pList = pList;
+    pDL->nList = (int)(pIter - pList);
+    while( pIter<pEnd && *pIter==0 ) pIter++;
+    pDL->pNextDocid = pIter;
+    *pbEof = 0;
+  }else{
+    do{
+      rc = fts3EvalPhraseNext(pCsr, p, pbEof);
+    }while( rc==SQLITE_OK && *pbEof==0 && DOCID_CMP(pDL->iDocid, iTarget)<0 );
+  }
+  return rc;
+}
+
 /*
 **
 ** If *pRc is not SQLITE_OK when this function is called, it is a no-op.
@@ -4540,6 +4661,8 @@ static int fts3EvalNearTrim(
   return res;
 }
 
+static void fts3EvalAndAlign(Fts3Cursor*, Fts3Expr*, int*);
+
 /*
 ** This function is a no-op if *pRc is other than SQLITE_OK when it is called.
 ** Otherwise, it advances the expression passed as the second argument to
@@ -4614,17 +4737,7 @@ static void fts3EvalNextRow(
           /* Neither the RHS or LHS are deferred. */
           fts3EvalNextRow(pCsr, pLeft, pRc);
           fts3EvalNextRow(pCsr, pRight, pRc);
-          while( !pLeft->bEof && !pRight->bEof && *pRc==SQLITE_OK ){
-            sqlite3_int64 iDiff = DOCID_CMP(pLeft->iDocid, pRight->iDocid);
-            if( iDiff==0 ) break;
-            if( iDiff<0 ){
-              fts3EvalNextRow(pCsr, pLeft, pRc);
-            }else{
-              fts3EvalNextRow(pCsr, pRight, pRc);
-            }
-          }
-          pExpr->iDocid = pLeft->iDocid;
-          pExpr->bEof = (pLeft->bEof || pRight->bEof);
+          fts3EvalAndAlign(pCsr, pExpr, pRc);
         }
         break;
       }
@@ -4691,6 +4804,75 @@ static void fts3EvalNextRow(
   }
 }
 
+/*
+** This function is a no-op if *pRc is other than SQLITE_OK when it is
+** called, or if expression pExpr is at EOF or already points to a row
+** with a docid not smaller than iTarget (not larger, if the cursor visits
+** rows in descending order).  Otherwise, it advances pExpr to the first
+** such row, exactly as if fts3EvalNextRow() were called until it got
+** there, but skipping over rows of phrase and AND/NEAR expressions
+** without visiting each of them.
+*/
+static void fts3EvalSkipTo(
+  Fts3Cursor *pCsr,               /* FTS Cursor handle */
+  Fts3Expr *pExpr,                /* Expr. to advance */
+  sqlite3_int64 iTarget,          /* Docid to advance to */
+  int *pRc                        /* IN/OUT: Error code */
+){
+  int bDescDoclist = pCsr->bDesc;         /* Used by DOCID_CMP() macro */
+  if( *pRc!=SQLITE_OK || pExpr->bEof ) return;
+  if( pExpr->bStart && DOCID_CMP(pExpr->iDocid, iTarget)>=0 ) return;
+
+  if( pExpr->eType==FTSQUERY_PHRASE ){
+    Fts3Phrase *pPhrase = pExpr->pPhrase;
+    pExpr->bStart = 1;
+    fts3EvalInvalidatePoslist(pPhrase);
+    *pRc = fts3EvalPhraseSkip(pCsr, pPhrase, iTarget, &pExpr->bEof);
+    pExpr->iDocid = pPhrase->doclist.iDocid;
+  }else if( (pExpr->eType==FTSQUERY_AND || pExpr->eType==FTSQUERY_NEAR)
+         && pExpr->bStart
+         && !pExpr->pLeft->bDeferred && !pExpr->pRight->bDeferred
+  ){
+    fts3EvalSkipTo(pCsr, pExpr->pLeft, iTarget, pRc);
+    fts3EvalSkipTo(pCsr, pExpr->pRight, iTarget, pRc);
+    fts3EvalAndAlign(pCsr, pExpr, pRc);
+  }else{
+    do{
+      fts3EvalNextRow(pCsr, pExpr, pRc);
+    }while( *pRc==SQLITE_OK && !pExpr->bEof
+         && DOCID_CMP(pExpr->iDocid, iTarget)<0
+    );
+  }
+}
+
+/*
+** pExpr is an AND or NEAR expression, neither side of which is deferred,
+** and both sides of which have just been advanced.  Leap-frog the two
+** sides forward until they point to the same docid, or one of them
+** reaches EOF, and set pExpr->iDocid and pExpr->bEof accordingly.
+*/
+static void fts3EvalAndAlign(
+  Fts3Cursor *pCsr,               /* FTS Cursor handle */
+  Fts3Expr *pExpr,                /* AND or NEAR expression */
+  int *pRc                        /* IN/OUT: Error code */
+){
+  int bDescDoclist = pCsr->bDesc;         /* Used by DOCID_CMP() macro */
+  Fts3Expr *pLeft = pExpr->pLeft;
+  Fts3Expr *pRight = pExpr->pRight;
+
+  while( !pLeft->bEof && !pRight->bEof && *pRc==SQLITE_OK ){
+    sqlite3_int64 iDiff = DOCID_CMP(pLeft->iDocid, pRight->iDocid);
+    if( iDiff==0 ) break;
+    if( iDiff<0 ){
+      fts3EvalSkipTo(pCsr, pLeft, pRight->iDocid, pRc);
+    }else{
+      fts3EvalSkipTo(pCsr, pRight, pLeft->iDocid, pRc);
+    }
+  }
+  pExpr->iDocid = pLeft->iDocid;
+  pExpr->bEof = (pLeft->bEof || pRight->bEof);
+}
+
 /*
 ** If *pRc is not SQLITE_OK, or if pExpr is not the root node of a NEAR
 ** cluster, then this function returns 1 immediately.
@@ -4945,6 +5127,7 @@ static int fts3EvalNext(Fts3Cursor *pCsr){
       pCsr->isEof = pExpr->bEof;
       pCsr->isRequireSeek = 1;
       pCsr->isMatchinfoNeeded = 1;
+      pCsr->isBm25Needed = 1;
       pCsr->iPrevId = pExpr->iDocid;
     }while( pCsr->isEof==0 && fts3EvalTestDeferredAndNear(pCsr, &rc) );
   }
@@ -5089,6 +5272,7 @@ static int fts3EvalGatherStats(
         pCsr->isEof = pRoot->bEof;
         pCsr->isRequireSeek = 1;
         pCsr->isMatchinfoNeeded = 1;
+        pCsr->isBm25Needed = 1;
         pCsr->iPrevId = pRoot->iDocid;
       }while( pCsr->isEof==0 
            && pRoot->eType==FTSQUERY_NEAR 
@@ -53,8 +53,14 @@ extern const sqlite3_api_routines *sqlite3_api;
 ** and used to create a new segment when the transaction is committed.
 ** However if this limit is reached midway through a transaction, a new 
 ** segment is created and the hash table cleared immediately.
+**
+** The limit may be changed for a single table using:
+**
+**   INSERT INTO tbl(tbl) VALUES('maxpending=N');
 */
-#define FTS3_MAX_PENDING_DATA (1*1024*1024)
+#ifndef FTS3_MAX_PENDING_DATA
+# define FTS3_MAX_PENDING_DATA (1*1024*1024)
+#endif
 
 /*
 ** Macro to return the number of elements in an array. SQLite has a
@@ -197,7 +203,7 @@ struct Fts3Table {
   sqlite3_tokenizer *pTokenizer;  /* tokenizer for inserts and queries */
   char *zContentTbl;              /* content=xxx option, or NULL */
   char *zLanguageid;              /* languageid=xxx option, or NULL */
-  u8 bAutoincrmerge;              /* True if automerge=1 */
+  u8 nAutoincrmerge;              /* automerge=N segment threshold or 0 */
   u32 nLeafAdd;                   /* Number of leaf blocks added this trans */
 
   /* Precompiled statements used by the implementation. Each of these 
@@ -242,6 +248,8 @@ struct Fts3Table {
   } *aIndex;
   int nMaxPendingData;            /* Max pending data before flush to disk */
   int nPendingData;               /* Current bytes of pending data */
+  char *aPendingArena;            /* Chunk that PendingList objects come from */
+  int nPendingArena;              /* Bytes still free in aPendingArena */
   sqlite_int64 iPrevDocid;        /* Docid of most recently inserted document */
   int iPrevLangid;                /* Langid of recently inserted document */
 
@@ -284,6 +292,9 @@ struct Fts3Cursor {
   u32 *aMatchinfo;                /* Information about most recent match */
   int nMatchinfo;                 /* Number of elements in aMatchinfo[] */
   char *zMatchinfo;               /* Matchinfo specification */
+
+  int isBm25Needed;               /* True when aBm25[] needs filling in */
+  u32 *aBm25;                     /* Matchinfo data used by bm25() */
 };
 
 #define FTS3_EVAL_FILTER    0
@@ -521,6 +532,7 @@ void sqlite3Fts3Snippet(sqlite3_context *, Fts3Cursor *, const char *,
   const char *, const char *, int, int
 );
 void sqlite3Fts3Matchinfo(sqlite3_context *, Fts3Cursor *, const char *);
+void sqlite3Fts3Bm25(sqlite3_context *, Fts3Cursor *, int, sqlite3_value **);
 
 /* fts3_expr.c */
 int sqlite3Fts3ExprParse(sqlite3_tokenizer *, int,
@@ -33,6 +33,12 @@
 */
 #define FTS3_MATCHINFO_DEFAULT   "pcx"
 
+/*
+** Parameters used by the bm25() ranking function.
+*/
+#define FTS3_BM25_K1             1.2
+#define FTS3_BM25_B              0.75
+
 
 /*
 ** Used as an fts3ExprIterate() context when loading phrase doclists to
@@ -1506,4 +1512,167 @@ void sqlite3Fts3Matchinfo(
   }
 }
 
+/*
+** Return the natural logarithm of x, which must be greater than zero.
+** This is accurate to about 12 significant digits, which is more than
+** bm25() needs, and avoids making FTS depend on the system math library.
+*/
+static double fts3Bm25Log(double x){
+  static const double ln2 = 0.69314718055994530942;
+  double y, y2, r;
+  int k = 0;
+  int i;
+  assert( x>0.0 );
+  while( x>=2.0 ){ x = x/2.0; k++; }
+  while( x<1.0 ){ x = x*2.0; k--; }
+
+  /* x is now in the range [1,2), so y is in [0,1/3) and the series
+  ** ln(x) = 2*(y + y^3/3 + y^5/5 + ...) converges quickly. */
+  y = (x-1.0)/(x+1.0);
+  y2 = y*y;
+  r = 0.0;
+  for(i=23; i>=1; i-=2){
+    r = r*y2 + 1.0/i;
+  }
+  return k*ln2 + 2.0*y*r;
+}
+
+/*
+** Populate pCsr->aBm25[] with matchinfo data in format zFormat for the
+** current row.  This works as fts3GetMatchinfo() does, but with a cache
+** of its own, so that a query that calls both matchinfo() and bm25()
+** does not discard the cached data and reload the global statistics
+** each time it switches from one format to the other.  The format is
+** the same for every call on a cursor, as it depends only on the table.
+*/
+static int fts3GetBm25Info(
+  Fts3Cursor *pCsr,               /* FTS3 Cursor object */
+  const char *zFormat             /* matchinfo() format to use */
+){
+  MatchInfo sInfo;
+  Fts3Table *pTab = (Fts3Table *)pCsr->base.pVtab;
+  int rc = SQLITE_OK;
+  int bGlobal = 0;                /* Collect 'global' stats as well as local */
+
+  memset(&sInfo, 0, sizeof(MatchInfo));
+  sInfo.pCursor = pCsr;
+  sInfo.nCol = pTab->nColumn;
+
+  if( pCsr->aBm25==0 ){
+    int nBm25 = 0;                /* Number of u32 elements in aBm25[] */
+    int i;
+    pCsr->nPhrase = fts3ExprPhraseCount(pCsr->pExpr);
+    sInfo.nPhrase = pCsr->nPhrase;
+    for(i=0; zFormat[i]; i++){
+      nBm25 += fts3MatchinfoSize(&sInfo, zFormat[i]);
+    }
+    pCsr->aBm25 = (u32 *)sqlite3_malloc(sizeof(u32)*nBm25);
+    if( !pCsr->aBm25 ) return SQLITE_NOMEM;
+    memset(pCsr->aBm25, 0, sizeof(u32)*nBm25);
+    pCsr->isBm25Needed = 1;
+    bGlobal = 1;
+  }
+
+  sInfo.aMatchinfo = pCsr->aBm25;
+  sInfo.nPhrase = pCsr->nPhrase;
+  if( pCsr->isBm25Needed ){
+    rc = fts3MatchinfoValues(pCsr, bGlobal, &sInfo, zFormat);
+    pCsr->isBm25Needed = 0;
+  }
+
+  return rc;
+}
+
+/*
+** Implementation of the bm25() function.
+**
+** The score is the Okapi BM25 score of the current row against the
+** phrases of the MATCH expression. Each column is scored separately and
+** the column scores are summed, each multiplied by the corresponding
+** weight in apWeight[] (or by 1.0 if there are fewer than nCol weights).
+** Higher scores are better matches, so a query ranks its results with:
+**
+**   ... WHERE t MATCH ? ORDER BY bm25(t) DESC LIMIT ?
+**
+** The function is computed directly from the same data the matchinfo()
+** function returns, kept in a cache of its own (see fts3GetBm25Info()),
+** so the global statistics are loaded once per query and only the
+** per-row hit counts and lengths are read for each row. If the table was
+** not created with document sizes (FTS4 with "matchinfo=fts3" or without
+** %_docsize) the length normalization is omitted. It is an error to use
+** bm25() with an FTS3 table, as the number of documents in the table is
+** not available.
+*/
+void sqlite3Fts3Bm25(
+  sqlite3_context *pContext,      /* Function call context */
+  Fts3Cursor *pCsr,               /* FTS3 table cursor */
+  int nWeight,                    /* Number of entries in apWeight[] */
+  sqlite3_value **apWeight        /* Column weights */
+){
+  Fts3Table *pTab = (Fts3Table *)pCsr->base.pVtab;
+  const char *zFormat;            /* matchinfo() format used */
+  u32 *aAvg = 0;                  /* Average length of each column */
+  u32 *aLen = 0;                  /* Length of each column in this row */
+  u32 *aHits;                     /* The 'x' data for the current row */
+  double nDoc;                    /* Number of rows in the table */
+  double rScore = 0.0;            /* Value to return */
+  int nCol = pTab->nColumn;
+  int iPhrase;
+  int iCol;
+  int rc;
+
+  if( !pTab->bFts4 ){
+    sqlite3_result_error(pContext, "bm25() requires an fts4 table", -1);
+    return;
+  }
+  if( !pCsr->pExpr ){
+    sqlite3_result_double(pContext, 0.0);
+    return;
+  }
+
+  zFormat = pTab->bHasDocsize ? "pcnalx" : "pcnx";
+  rc = fts3GetBm25Info(pCsr, zFormat);
+  sqlite3Fts3SegmentsClose(pTab);
+  if( rc!=SQLITE_OK ){
+    sqlite3_result_error_code(pContext, rc);
+    return;
+  }
+
+  nDoc = (double)pCsr->aBm25[2];
+  if( pTab->bHasDocsize ){
+    aAvg = &pCsr->aBm25[3];
+    aLen = &aAvg[nCol];
+    aHits = &aLen[nCol];
+  }else{
+    aHits = &pCsr->aBm25[3];
+  }
+
+  for(iCol=0; iCol<nCol; iCol++){
+    double rWeight = 1.0;
+    double rNorm = 1.0;           /* Length normalization for this column */
+    double rCol = 0.0;            /* Score for this column */
+
+    if( iCol<nWeight ){
+      rWeight = sqlite3_value_double(apWeight[iCol]);
+      if( rWeight==0.0 ) continue;
+    }
+    if( aLen && aAvg[iCol]>0 ){
+      rNorm = 1.0 - FTS3_BM25_B + FTS3_BM25_B*aLen[iCol]/(double)aAvg[iCol];
+    }
+
+    for(iPhrase=0; iPhrase<pCsr->nPhrase; iPhrase++){
+      u32 *aX = &aHits[3*(iPhrase*nCol + iCol)];
+      double tf = (double)aX[0];
+      if( tf>0.0 ){
+        double nHit = (double)aX[2];
+        double idf = fts3Bm25Log(1.0 + (nDoc - nHit + 0.5)/(nHit + 0.5));
+        rCol += idf * (tf*(FTS3_BM25_K1+1.0)) / (tf + FTS3_BM25_K1*rNorm);
+      }
+    }
+    rScore += rWeight * rCol;
+  }
+
+  sqlite3_result_double(pContext, rScore);
+}
+
 #endif
@@ -66,6 +66,17 @@ int test_fts3_node_chunk_threshold = (4*1024)*4;
 # define FTS3_NODE_CHUNK_THRESHOLD (FTS3_NODE_CHUNKSIZE*4)
 #endif
 
+/*
+** PendingList objects for the pending-terms hash tables are carved out of
+** chunks of FTS3_PENDING_ARENA bytes, each with room for an initial
+** doclist of FTS3_PENDING_INIT bytes. Most terms in a batch of documents
+** occur only a few times, so most doclists never outgrow this space and
+** need no allocation of their own. All chunks are freed together when the
+** pending terms are flushed or discarded.
+*/
+#define FTS3_PENDING_ARENA (16*1024)
+#define FTS3_PENDING_INIT  32
+
 /*
 ** The two values that may be meaningfully bound to the :1 parameter in
 ** statements SQL_REPLACE_STAT and SQL_SELECT_STAT.
@@ -96,10 +107,14 @@ typedef struct SegmentWriter SegmentWriter;
 /*
 ** An instance of the following data structure is used to build doclists
 ** incrementally. See function fts3PendingListAppend() for details.
+**
+** The doclist is initially stored in the space immediately following the
+** PendingList structure. If it grows too large for that space, it is moved
+** to a separate allocation, so that the PendingList itself never moves.
 */
 struct PendingList {
   int nData;
-  char *aData;
+  char *aData;                    /* &this[1], or an sqlite3_malloc() buffer */
   int nSpace;
   sqlite3_int64 iLastDocid;
   sqlite3_int64 iLastCol;
@@ -645,14 +660,18 @@ static int fts3PendingListAppendVarint(
   }
   else if( p->nData+FTS3_VARINT_MAX+1>p->nSpace ){
     int nNew = p->nSpace * 2;
-    p = sqlite3_realloc(p, sizeof(*p) + nNew);
-    if( !p ){
-      sqlite3_free(*pp);
-      *pp = 0;
+    char *aNew;
+    if( p->aData==(char *)&p[1] ){
+      aNew = (char *)sqlite3_malloc(nNew);
+      if( aNew ) memcpy(aNew, p->aData, p->nData);
+    }else{
+      aNew = (char *)sqlite3_realloc(p->aData, nNew);
+    }
+    if( !aNew ){
       return SQLITE_NOMEM;
     }
     p->nSpace = nNew;
-    p->aData = (char *)&p[1];
+    p->aData = aNew;
   }
 
   /* Append the new serialized varint to the end of the list. */
@@ -664,8 +683,8 @@ static int fts3PendingListAppendVarint(
 
 /*
 ** Add a docid/column/position entry to a PendingList structure. Non-zero
-** is returned if the structure is sqlite3_realloced as part of adding
-** the entry. Otherwise, zero.
+** is returned if the structure is allocated as part of adding the entry
+** (i.e. if *pp was NULL). Otherwise, zero.
 **
 ** If an OOM error occurs, *pRc is set to SQLITE_NOMEM before returning.
 ** Zero is always returned in this case. Otherwise, if no OOM error occurs,
@@ -679,13 +698,14 @@ static int fts3PendingListAppend(
   int *pRc                        /* OUT: Return code */
 ){
   PendingList *p = *pp;
+  int bEmpty = (p==0 || p->nData==0);
   int rc = SQLITE_OK;
 
-  assert( !p || p->iLastDocid<=iDocid );
+  assert( bEmpty || p->iLastDocid<=iDocid );
 
-  if( !p || p->iLastDocid!=iDocid ){
-    sqlite3_int64 iDelta = iDocid - (p ? p->iLastDocid : 0);
-    if( p ){
+  if( bEmpty || p->iLastDocid!=iDocid ){
+    sqlite3_int64 iDelta = iDocid - (bEmpty ? 0 : p->iLastDocid);
+    if( !bEmpty ){
       assert( p->nData<p->nSpace );
       assert( p->aData[p->nData]==0 );
       p->nData++;
@@ -727,7 +747,40 @@ static int fts3PendingListAppend(
 ** Free a PendingList object allocated by fts3PendingListAppend().
 */
 static void fts3PendingListDelete(PendingList *pList){
-  sqlite3_free(pList);
+  if( pList ){
+    if( pList->aData!=(char *)&pList[1] ) sqlite3_free(pList->aData);
+    sqlite3_free(pList);
+  }
+}
+
+/*
+** Allocate a new, empty, PendingList object from the pending-terms arena
+** of table p. NULL is returned if a malloc fails.
+**
+** The object is not freed individually. Its doclist is freed (if it has
+** been moved out of the arena) and the arena released by
+** sqlite3Fts3PendingTermsClear().
+*/
+static PendingList *fts3PendingListNew(Fts3Table *p){
+  const int nHdr = (sizeof(char *) + 7) & ~7;
+  const int nByte = (sizeof(PendingList) + FTS3_PENDING_INIT + 7) & ~7;
+  PendingList *pRet;
+
+  if( p->nPendingArena<nByte ){
+    char *aChunk = (char *)sqlite3_malloc(FTS3_PENDING_ARENA);
+    if( !aChunk ) return 0;
+    *(char **)aChunk = p->aPendingArena;
+    p->aPendingArena = aChunk;
+    p->nPendingArena = FTS3_PENDING_ARENA - nHdr;
+  }
+  pRet = (PendingList *)&p->aPendingArena[FTS3_PENDING_ARENA-p->nPendingArena];
+  p->nPendingArena -= nByte;
+
+  memset(pRet, 0, sizeof(PendingList));
+  pRet->aData = (char *)&pRet[1];
+  pRet->aData[0] = '\0';
+  pRet->nSpace = FTS3_PENDING_INIT;
+  return pRet;
 }
 
 /*
@@ -747,17 +800,20 @@ static int fts3PendingTermsAddOne(
   pList = (PendingList *)fts3HashFind(pHash, zToken, nToken);
   if( pList ){
     p->nPendingData -= (pList->nData + nToken + sizeof(Fts3HashElem));
-  }
-  if( fts3PendingListAppend(&pList, p->iPrevDocid, iCol, iPos, &rc) ){
+  }else{
+    /* The PendingList is allocated from the arena and never moves, so
+    ** once it is in the hash table there is no need to update the hash
+    ** table entry as the doclist grows.  */
+    pList = fts3PendingListNew(p);
+    if( !pList ) return SQLITE_NOMEM;
     if( pList==fts3HashInsert(pHash, zToken, nToken, pList) ){
-      /* Malloc failed while inserting the new entry. This can only 
-      ** happen if there was no previous entry for this token.
-      */
+      /* Malloc failed while inserting the new entry. The PendingList is
+      ** released along with the rest of the arena.  */
       assert( 0==fts3HashFind(pHash, zToken, nToken) );
-      sqlite3_free(pList);
-      rc = SQLITE_NOMEM;
+      return SQLITE_NOMEM;
     }
   }
+  fts3PendingListAppend(&pList, p->iPrevDocid, iCol, iPos, &rc);
   if( rc==SQLITE_OK ){
     p->nPendingData += (pList->nData + nToken + sizeof(Fts3HashElem));
   }
@@ -884,10 +940,16 @@ void sqlite3Fts3PendingTermsClear(Fts3Table *p){
     Fts3Hash *pHash = &p->aIndex[i].hPending;
     for(pElem=fts3HashFirst(pHash); pElem; pElem=fts3HashNext(pElem)){
       PendingList *pList = (PendingList *)fts3HashData(pElem);
-      fts3PendingListDelete(pList);
+      if( pList->aData!=(char *)&pList[1] ) sqlite3_free(pList->aData);
     }
     fts3HashClear(pHash);
   }
+  while( p->aPendingArena ){
+    char *aChunk = p->aPendingArena;
+    p->aPendingArena = *(char **)aChunk;
+    sqlite3_free(aChunk);
+  }
+  p->nPendingArena = 0;
   p->nPendingData = 0;
 }
 
@@ -3024,6 +3086,26 @@ static int fts3SegmentMerge(
 }
 
 
+/*
+** Map a value specified by an "automerge=N" command, or read from the
+** FTS_STAT_AUTOINCRMERGE row of the %_stat table, to the minimum number
+** of segments a level must contain before the automatic incremental
+** merge that runs at the end of each write transaction works on it.
+** 0 means automerge is off. For compatibility, 1 means the default of
+** 8. Values larger than FTS3_MERGE_COUNT are meaningless, as a level
+** with that many segments is merged by the writer before another
+** segment is added to it, so they are reduced to FTS3_MERGE_COUNT.
+**
+** Smaller values keep fewer segments on each level, and so make queries
+** cheaper, at the cost of more merge work while writing.
+*/
+static int fts3AutoincrmergeValue(int nMin){
+  if( nMin<=0 ) return 0;
+  if( nMin==1 ) return 8;
+  if( nMin>FTS3_MERGE_COUNT ) return FTS3_MERGE_COUNT;
+  return nMin;
+}
+
 /* 
 ** Flush the contents of pendingTerms to level 0 segments.
 */
@@ -3041,14 +3123,18 @@ int sqlite3Fts3PendingTermsFlush(Fts3Table *p){
   ** estimate the number of leaf blocks of content to be written
   */
   if( rc==SQLITE_OK && p->bHasStat
-   && p->bAutoincrmerge==0xff && p->nLeafAdd>0
+   && p->nAutoincrmerge==0xff && p->nLeafAdd>0
   ){
     sqlite3_stmt *pStmt = 0;
     rc = fts3SqlStmt(p, SQL_SELECT_STAT, &pStmt, 0);
     if( rc==SQLITE_OK ){
       sqlite3_bind_int(pStmt, 1, FTS_STAT_AUTOINCRMERGE);
       rc = sqlite3_step(pStmt);
-      p->bAutoincrmerge = (rc==SQLITE_ROW && sqlite3_column_int(pStmt, 0));
+      if( rc==SQLITE_ROW ){
+        p->nAutoincrmerge = fts3AutoincrmergeValue(sqlite3_column_int(pStmt,0));
+      }else{
+        p->nAutoincrmerge = 0;
+      }
       rc = sqlite3_reset(pStmt);
     }
   }
@@ -4752,8 +4838,11 @@ static int fts3DoIncrmerge(
 **
 **    INSERT INTO table(table) VALUES('automerge=X');
 **
-** where X is an integer.  X==0 means to turn automerge off.  X!=0 means
-** turn it on.  The setting is persistent.
+** where X is an integer.  X==0 means to turn automerge off.  Otherwise
+** X is the number of segments that may accumulate on a level before the
+** automerge performed at the end of each write transaction begins merging
+** them, as interpreted by fts3AutoincrmergeValue(). The setting is
+** persistent.
 */
 static int fts3DoAutoincrmerge(
   Fts3Table *p,                   /* FTS3 table handle */
@@ -4761,7 +4850,7 @@ static int fts3DoAutoincrmerge(
 ){
   int rc = SQLITE_OK;
   sqlite3_stmt *pStmt = 0;
-  p->bAutoincrmerge = fts3Getint(&zParam)!=0;
+  p->nAutoincrmerge = (u8)fts3AutoincrmergeValue(fts3Getint(&zParam));
   if( !p->bHasStat ){
     assert( p->bFts4==0 );
     sqlite3Fts3CreateStatTable(&rc, p);
@@ -4770,7 +4859,7 @@ static int fts3DoAutoincrmerge(
   rc = fts3SqlStmt(p, SQL_REPLACE_STAT, &pStmt, 0);
   if( rc ) return rc;;
   sqlite3_bind_int(pStmt, 1, FTS_STAT_AUTOINCRMERGE);
-  sqlite3_bind_int(pStmt, 2, p->bAutoincrmerge);
+  sqlite3_bind_int(pStmt, 2, p->nAutoincrmerge);
   sqlite3_step(pStmt);
   rc = sqlite3_reset(pStmt);
   return rc;
@@ -5031,13 +5120,13 @@ static int fts3SpecialInsert(Fts3Table *p, sqlite3_value *pVal){
     rc = fts3DoIncrmerge(p, &zVal[6]);
   }else if( nVal>10 && 0==sqlite3_strnicmp(zVal, "automerge=", 10) ){
     rc = fts3DoAutoincrmerge(p, &zVal[10]);
+  }else if( nVal>11 && 0==sqlite3_strnicmp(zVal, "maxpending=", 11) ){
+    p->nMaxPendingData = atoi(&zVal[11]);
+    rc = SQLITE_OK;
 #ifdef SQLITE_TEST
   }else if( nVal>9 && 0==sqlite3_strnicmp(zVal, "nodesize=", 9) ){
     p->nNodeSize = atoi(&zVal[9]);
     rc = SQLITE_OK;
-  }else if( nVal>11 && 0==sqlite3_strnicmp(zVal, "maxpending=", 9) ){
-    p->nMaxPendingData = atoi(&zVal[11]);
-    rc = SQLITE_OK;
 #endif
   }else{
     rc = SQLITE_ERROR;
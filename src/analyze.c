@@ -704,8 +704,7 @@ static void analyzeOneTable(
     sqlite3VdbeChangeP5(v, 2);
     sqlite3VdbeAddOp1(v, OP_IsNull, regTemp1);
     sqlite3VdbeAddOp3(v, OP_NotExists, iTabCur, shortJump, regTemp1);
-    sqlite3VdbeAddOp3(v, OP_Column, iTabCur, pIdx->aiColumn[0], regSample);
-    sqlite3ColumnDefault(v, pTab, pIdx->aiColumn[0], regSample);
+    sqlite3ExprCodeLoadIndexColumn(pParse, pIdx, iTabCur, 0, regSample);
     sqlite3VdbeAddOp4(v, OP_Function, 1, regAccum, regNumEq,
                       (char*)&stat3GetFuncdef, P4_FUNCDEF);
     sqlite3VdbeChangeP5(v, 3);
@@ -51,127 +51,48 @@
 
 #include "sqliteInt.h"      /*sqliteInt头文件（它定义了提供给应用使用的API和数据结构）*/
 
-/* Size of the Bitvec structure in bytes. */
-   /*Bitvec结构的字节大小 */
-#define BITVEC_SZ        512               /*定义BITVEC_SZ大小为512个字节*/
-
-/* Round the union size down to the nearest pointer boundary, since that's how 
-** it will be aligned within the Bitvec struct. 
-   使Bitvec结构总的大小，降到最近的指针的边界，来看看这样它是如何排列在bitvec结构之中的。
-*/
-#define BITVEC_USIZE     (((BITVEC_SZ-(3*sizeof(u32)))/sizeof(Bitvec*))*sizeof(Bitvec*))
-
-/* Type of the array "element" for the bitmap representation. 
-** Should be a power of 2, and ideally, evenly divide into BITVEC_USIZE. 
-** Setting this to the "natural word" size of your CPU may improve
-** performance. 
-   数组“元素”，为位图表示的类型。
-   应该是2的幂，并且理想地，均匀地分成BITVEC_USIZE。
-   将其设置为你的CPU的“自然词”大小可以提高性能。
-*/
-#define BITVEC_TELEM     u8
-
-/* Size, in bits, of the bitmap element. */
-/*以位为单位的位图元素的大小。 */
-#define BITVEC_SZELEM    8
-
-/* Number of elements in a bitmap array. */
-/*在一个位图数组元素的编号。 */
-#define BITVEC_NELEM     (BITVEC_USIZE/sizeof(BITVEC_TELEM))
-
-/* Number of bits in the bitmap array. */
-/*位图数组中的位的数目。 */
-#define BITVEC_NBIT      (BITVEC_NELEM*BITVEC_SZELEM)
-
-/* Number of u32 values in hash table. */
-/*在哈希表中U32值的数量。 */
-#define BITVEC_NINT      (BITVEC_USIZE/sizeof(u32))
-
-/* Maximum number of entries in hash table before 
-** sub-dividing and re-hashing. */
-/*在细分和二度哈希之前在哈希表中条目的最大数量。 */
-#define BITVEC_MXHASH    (BITVEC_NINT/2)
-
-/* Hashing function for the aHash representation.
-** Empirical testing showed that the *37 multiplier 
-** (an arbitrary prime)in the hash function provided 
-** no fewer collisions than the no-op *1. */
-/*哈希函数的aHash表示.实证检验表明，×37乘法器（任意素数）
-  在哈希函数中没有提供比空指令×1更少的冲突*/
-#define BITVEC_HASH(X)   (((X)*1)%BITVEC_NINT)
-
-#define BITVEC_NPTR      (BITVEC_USIZE/sizeof(Bitvec *))
+/* Number of bits in each leaf of the bitmap.  A full leaf is 4KB. */
+#define BITVEC_LEAFBITS  32768
+#define BITVEC_LEAFSHIFT 15
 
+/* Number of u64 words in a full leaf. */
+#define BITVEC_LEAFWORDS (BITVEC_LEAFBITS/64)
 
 /*
 ** A bitmap is an instance of the following structure.
-** 下面结构体的一个实例是一个位图。
-
+**
 ** This bitmap records the existance of zero or more bits
 ** with values between 1 and iSize, inclusive.
-** 这个位图记录0或更多位的存在，用在1和iSize之间的值记录，并且包含1和iSize。
-
-** There are three possible representations of the bitmap.
-** If iSize<=BITVEC_NBIT, then Bitvec.u.aBitmap[] is a straight
-** bitmap.  The least significant bit is bit 1.
-** 如果iSize<=BITVEC_NBIT，则Bitvec.u.aBitmap[]是一个直接的位图。最低有效单位是1位。
-
-** If iSize>BITVEC_NBIT and iDivisor==0 then Bitvec.u.aHash[] is
-** a hash table that will hold up to BITVEC_MXHASH distinct values.
-** 如果iSize>BITVEC_NBIT并且iDivisor==0，那么Bitvec.u.aHash[]是一个能够
-   容纳BITVEC_MXHASH的不同值的hash表。
-
-** Otherwise, the value i is redirected into one of BITVEC_NPTR
-** sub-bitmaps pointed to by Bitvec.u.apSub[].  Each subbitmap
-** handles up to iDivisor separate values of i.  apSub[0] holds
-** values between 1 and iDivisor.  apSub[1] holds values between
-** iDivisor+1 and 2*iDivisor.  apSub[N] holds values between
-** N*iDivisor+1 and (N+1)*iDivisor.  Each subbitmap is normalized
-** to hold deal with values between 1 and iDivisor.
-  否则，值i会被重新传递给由Bitvec.u.apSub[]所指的BITVEC_NPTR子位图。
-  每一个子位图句柄多不同于值i。apSub[0]的值介于1和iDivisor之间。
-  apSub[1]的值介于iDivisor+1和2*iDivisor之间。
-  apSub[N]的值介于N*iDivisor+1和(N+1)*iDivisor之间。
-  每一个子位图都很规范的处理介于1到iDivisor之间的值。
+**
+** The bitmap is flat, split into leaves of BITVEC_LEAFBITS bits each.
+** Bit i (counting from 0, so value i+1) lives in leaf
+** apLeaf[i>>BITVEC_LEAFSHIFT].  A leaf is only allocated when the first
+** bit in it is set, so a sparse bitmap of a large database stays small,
+** and a test or set is a single indexed load with no hashing.  The
+** last leaf is only as large as it needs to be, so a bitmap for a small
+** database is a single short allocation.
 */
 struct Bitvec {
-  u32 iSize;      /* Maximum bit index.  Max iSize is 4,294,967,296.
-                    最大位指数，最大的iSize是4,294,967,296.*/
-  
-  u32 nSet;       /* Number of bits that are set - only valid for aHash
-                  ** element.  Max is BITVEC_NINT.  For BITVEC_SZ of 512,
-                  ** this would be 125.
-                    被设置的位的数量仅适用于aHash元素。最大是BITVEC_NINT。
-                    因为BITVEC_SZ 的大小是512，所以这里是125.*/
-                    
-  u32 iDivisor;   /* Number of bits handled by each apSub[] entry.
-                     位的数量由每个apSub[]的记录处理。*/
-                  /* Should >=0 for apSub element.
-                     apSub元素应该>=0*/
-                  /* Max iDivisor is max(u32) / BITVEC_NPTR + 1.  
-                  最大的iDivisor是max(u32) / BITVEC_NPTR + 1.*/
-                  /* For a BITVEC_SZ of 512, this would be 34,359,739.
-                  因为BITVEC_SZ 的大小是512，所以这里是34,359,739.*/
-  union {
-    BITVEC_TELEM aBitmap[BITVEC_NELEM];    /* Bitmap representation  位图的表示*/
-    u32 aHash[BITVEC_NINT];      /* Hash table representation   哈希表的表示 */
-    Bitvec *apSub[BITVEC_NPTR];  /* Recursive representation   递归的表示*/
-  } u;      /*联合变量*/
+  u32 iSize;      /* Maximum bit index.  Max iSize is 4,294,967,296. */
+  u32 nLeaf;      /* Number of entries in apLeaf[] */
+  u64 *apLeaf[1]; /* Leaves, or NULL for leaves with no bits set */
 };
 
 /*
 ** Create a new bitmap object able to handle bits between 0 and iSize,
-** inclusive.  Return a pointer to the new object.  Return NULL if 
+** inclusive.  Return a pointer to the new object.  Return NULL if
 ** malloc fails.
    创建一个能过处理0到iSize个位(包含0和iSize)的新位图对象。返回新对象的指针。
   如果分配失败返回空。
 */
 Bitvec *sqlite3BitvecCreate(u32 iSize){
   Bitvec *p;
-  assert( sizeof(*p)==BITVEC_SZ );
-  p = sqlite3MallocZero( sizeof(*p) );
+  u32 nLeaf = (u32)(((u64)iSize + BITVEC_LEAFBITS - 1) >> BITVEC_LEAFSHIFT);
+  if( nLeaf==0 ) nLeaf = 1;
+  p = sqlite3MallocZero( sizeof(*p) + (nLeaf-1)*sizeof(p->apLeaf[0]) );
   if( p ){
     p->iSize = iSize;
+    p->nLeaf = nLeaf;
   }
   return p;
 }
@@ -184,158 +105,60 @@ Bitvec *sqlite3BitvecCreate(u32 iSize){
    如果p为空(如果位图没有被创建)或i溢出返回假。
 */
 int sqlite3BitvecTest(Bitvec *p, u32 i){
+  u64 *pLeaf;
   if( p==0 ) return 0;
   if( i>p->iSize || i==0 ) return 0;
   i--;
-  while( p->iDivisor ){
-    u32 bin = i/p->iDivisor;
-    i = i%p->iDivisor;
-    p = p->u.apSub[bin];
-    if (!p) {
-      return 0;
-    }
-  }
-  if( p->iSize<=BITVEC_NBIT ){
-    return (p->u.aBitmap[i/BITVEC_SZELEM] & (1<<(i&(BITVEC_SZELEM-1))))!=0;
-  } else{
-    u32 h = BITVEC_HASH(i++);
-    while( p->u.aHash[h] ){
-      if( p->u.aHash[h]==i ) return 1;
-      h = (h+1) % BITVEC_NINT;
-    }
-    return 0;
-  }
+  pLeaf = p->apLeaf[i>>BITVEC_LEAFSHIFT];
+  if( pLeaf==0 ) return 0;
+  return (int)((pLeaf[(i>>6)&(BITVEC_LEAFWORDS-1)] >> (i&63)) & 1);
 }
 
 /*
 ** Set the i-th bit.  Return 0 on success and an error code if
 ** anything goes wrong.
-** 分配第i个位。成功时返回0，如果出错则返回错误信息。
-
-** This routine might cause sub-bitmaps to be allocated.  Failing
-** to get the memory needed to hold the sub-bitmap is the only
+**
+** This routine might cause a leaf to be allocated.  Failing
+** to get the memory needed to hold the leaf is the only thing
 ** that can go wrong with an insert, assuming p and i are valid.
-** 这个程序可能会分配子位图。假设p和i是有效的，那么对于插入来说需要
-   存放子位图却没有获得内存是唯一可能出错的地方。
-
+**
 ** The calling function must ensure that p is a valid Bitvec object
 ** and that the value for "i" is within range of the Bitvec object.
 ** Otherwise the behavior is undefined.
-   调用函数必须确保p是有效的Bitvec对象，并且i的值没有溢出Bitvec对象的范围。
-   否则行为是无效的。
 */
 int sqlite3BitvecSet(Bitvec *p, u32 i){
-  u32 h;
+  u64 **ppLeaf;
   if( p==0 ) return SQLITE_OK;
   assert( i>0 );
   assert( i<=p->iSize );
   i--;
-  while((p->iSize > BITVEC_NBIT) && p->iDivisor) {
-    u32 bin = i/p->iDivisor;
-    i = i%p->iDivisor;
-    if( p->u.apSub[bin]==0 ){
-      p->u.apSub[bin] = sqlite3BitvecCreate( p->iDivisor );
-      if( p->u.apSub[bin]==0 ) return SQLITE_NOMEM;
-    }
-    p = p->u.apSub[bin];
-  }
-  if( p->iSize<=BITVEC_NBIT ){
-    p->u.aBitmap[i/BITVEC_SZELEM] |= 1 << (i&(BITVEC_SZELEM-1));
-    return SQLITE_OK;
+  ppLeaf = &p->apLeaf[i>>BITVEC_LEAFSHIFT];
+  if( *ppLeaf==0 ){
+    u32 nBit = p->iSize - (i & ~(u32)(BITVEC_LEAFBITS-1));
+    if( nBit>BITVEC_LEAFBITS ) nBit = BITVEC_LEAFBITS;
+    *ppLeaf = sqlite3MallocZero( ((nBit+63)/64)*sizeof(u64) );
+    if( *ppLeaf==0 ) return SQLITE_NOMEM;
   }
-  h = BITVEC_HASH(i++);
-  
-  /* if there wasn't a hash collision, and this doesn't */
-  /* completely fill the hash, then just add it without */
-  /* worring about sub-dividing and re-hashing. 
-     如果一个哈希冲突都没有，并且也没有完全填充哈希，这样只要增加
-     它就可以了，而不用担心子划分和二次哈希了。*/
-  if( !p->u.aHash[h] ){
-    if (p->nSet<(BITVEC_NINT-1)) {
-      goto bitvec_set_end;
-    } else {
-      goto bitvec_set_rehash;
-    }
-  }
-  
-  /* there was a collision, check to see if it's already */
-  /* in hash, if not, try to find a spot for it。
-     有一个冲突，检查看看是不是已经在哈希，如果没有，试着找到它的位置。 */
-  do {
-    if( p->u.aHash[h]==i ) return SQLITE_OK;
-    h++;
-    if( h>=BITVEC_NINT ) h = 0;
-  } while( p->u.aHash[h] );
-  
-  /* we didn't find it in the hash.  h points to the first */
-  /* available free spot. check to see if this is going to */
-  /* make our hash too "full". 
-     我们没有在哈希找到它。h点到第一个可用的自由点。检查看看是否这会
-     让我们的哈希太“满”。*/
-bitvec_set_rehash:
-  if( p->nSet>=BITVEC_MXHASH ){
-    unsigned int j;
-    int rc;
-    u32 *aiValues = sqlite3StackAllocRaw(0, sizeof(p->u.aHash));
-    if( aiValues==0 ){
-      return SQLITE_NOMEM;
-    }else{
-      memcpy(aiValues, p->u.aHash, sizeof(p->u.aHash));
-      memset(p->u.apSub, 0, sizeof(p->u.apSub));
-      p->iDivisor = (p->iSize + BITVEC_NPTR - 1)/BITVEC_NPTR;
-      rc = sqlite3BitvecSet(p, i);
-      for(j=0; j<BITVEC_NINT; j++){
-        if( aiValues[j] ) rc |= sqlite3BitvecSet(p, aiValues[j]);
-      }
-      sqlite3StackFree(0, aiValues);
-      return rc;
-    }
-  }
-bitvec_set_end:
-  p->nSet++;
-  p->u.aHash[h] = i;
+  (*ppLeaf)[(i>>6)&(BITVEC_LEAFWORDS-1)] |= ((u64)1)<<(i&63);
   return SQLITE_OK;
 }
 
 /*
 ** Clear the i-th bit.
-** 清除第i位。
-** pBuf must be a pointer to at least BITVEC_SZ bytes of temporary storage
-** that BitvecClear can use to rebuilt its hash table.
-   pBuf必须是一个至少为BITVEC_SZ个字节的指针指向临时存储器，通过临时存储器
-   BitvecClear可以重建hash表。
+**
+** The pBuf argument is unused.  It is kept so that callers need not
+** change, from when clearing a bit could rebuild a hash table.
 */
 void sqlite3BitvecClear(Bitvec *p, u32 i, void *pBuf){
+  u64 *pLeaf;
+  UNUSED_PARAMETER(pBuf);
   if( p==0 ) return;
   assert( i>0 );
+  if( i>p->iSize ) return;
   i--;
-  while( p->iDivisor ){
-    u32 bin = i/p->iDivisor;
-    i = i%p->iDivisor;
-    p = p->u.apSub[bin];
-    if (!p) {
-      return;
-    }
-  }
-  if( p->iSize<=BITVEC_NBIT ){
-    p->u.aBitmap[i/BITVEC_SZELEM] &= ~(1 << (i&(BITVEC_SZELEM-1)));
-  }else{
-    unsigned int j;
-    u32 *aiValues = pBuf;
-    memcpy(aiValues, p->u.aHash, sizeof(p->u.aHash));
-    memset(p->u.aHash, 0, sizeof(p->u.aHash));
-    p->nSet = 0;
-    for(j=0; j<BITVEC_NINT; j++){
-      if( aiValues[j] && aiValues[j]!=(i+1) ){
-        u32 h = BITVEC_HASH(aiValues[j]-1);
-        p->nSet++;
-        while( p->u.aHash[h] ){
-          h++;
-          if( h>=BITVEC_NINT ) h = 0;
-        }
-        p->u.aHash[h] = aiValues[j];
-      }
-    }
+  pLeaf = p->apLeaf[i>>BITVEC_LEAFSHIFT];
+  if( pLeaf ){
+    pLeaf[(i>>6)&(BITVEC_LEAFWORDS-1)] &= ~(((u64)1)<<(i&63));
   }
 }
 
@@ -344,12 +167,10 @@ void sqlite3BitvecClear(Bitvec *p, u32 i, void *pBuf){
    销毁一个位图对象。回收所有可用内存。
 */
 void sqlite3BitvecDestroy(Bitvec *p){
+  u32 i;
   if( p==0 ) return;
-  if( p->iDivisor ){
-    unsigned int i;
-    for(i=0; i<BITVEC_NPTR; i++){
-      sqlite3BitvecDestroy(p->u.apSub[i]);
-    }
+  for(i=0; i<p->nLeaf; i++){
+    sqlite3_free(p->apLeaf[i]);
   }
   sqlite3_free(p);
 }
@@ -427,7 +248,6 @@ int sqlite3BitvecBuiltinTest(int sz, int *aOp){
   unsigned char *pV = 0;
   int rc = -1;
   int i, nx, pc, op;
-  void *pTmpSpace;
 
   /* Allocate the Bitvec to be tested and a linear array of
   ** bits to act as the reference.
@@ -435,13 +255,12 @@ int sqlite3BitvecBuiltinTest(int sz, int *aOp){
   */
   pBitvec = sqlite3BitvecCreate( sz );
   pV = sqlite3MallocZero( (sz+7)/8 + 1 );
-  pTmpSpace = sqlite3_malloc(BITVEC_SZ);
-  if( pBitvec==0 || pV==0 || pTmpSpace==0  ) goto bitvec_end;
+  if( pBitvec==0 || pV==0 ) goto bitvec_end;
 
   /* NULL pBitvec tests 
      pBitvec空测试*/
   sqlite3BitvecSet(0, 1);
-  sqlite3BitvecClear(0, 1, pTmpSpace);
+  sqlite3BitvecClear(0, 1, 0);
 
   /* Run the program 
      运行程序*/
@@ -474,7 +293,7 @@ int sqlite3BitvecBuiltinTest(int sz, int *aOp){
       }
     }else{
       CLEARBIT(pV, (i+1));
-      sqlite3BitvecClear(pBitvec, i+1, pTmpSpace);
+      sqlite3BitvecClear(pBitvec, i+1, 0);
     }
   }
 
@@ -498,7 +317,6 @@ int sqlite3BitvecBuiltinTest(int sz, int *aOp){
   /* Free allocated structure 
      释放所分配的结构 */
 bitvec_end:
-  sqlite3_free(pTmpSpace);
   sqlite3_free(pV);
   sqlite3BitvecDestroy(pBitvec);
   return rc;
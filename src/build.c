@@ -189,6 +189,10 @@ void sqlite3FinishCoding(Parse *pParse){
 	  */
 	  sqlite3AutoincrementBegin(pParse);
 
+	  /* Evaluate the constants factored out of loops coded after the
+	  ** jump to this point was generated. */
+	  sqlite3ExprCodeInitConstants(pParse);
+
 	  /* Finally, jump back to the beginning of the executable code. 【最后，跳回到可执行代码的开端。】*/
 	  sqlite3VdbeAddOp2(v, OP_Goto, 0, pParse->cookieGoto);
 		}
@@ -374,6 +378,7 @@ static void freeIndex(sqlite3 *db, Index *p){
 	sqlite3DeleteIndexSamples(db, p);//删除参数范例
 #endif
 	sqlite3DbFree(db, p->zColAff);
+	sqlite3ExprListDelete(db, p->aColExpr);
 	sqlite3DbFree(db, p);//释放数据库连接
 }
 
@@ -2560,6 +2565,7 @@ Index *sqlite3CreateIndex(
   struct ExprList_item *pListItem; /* For looping over pList */                   //指向 struct ExprList_item类型数据的指针变量pListItem
   int nCol;
   int nExtra = 0;
+  int nIdxExpr = 0;    /* Number of expression columns in the index */
   char *zExtra;
 
   assert( pStart==0 || pEnd!=0 ); /* pEnd must be non-NULL if pStart is */     //pStart为0或pEnd不为0时
@@ -2712,6 +2718,55 @@ Index *sqlite3CreateIndex(
     pList->a[0].sortOrder = (u8)sortOrder;
   }
 
+  /* The column list of a CREATE INDEX statement arrives as a list of
+  ** expressions.  An item that is a bare identifier names a column of
+  ** the table, exactly as before, and is converted into the form used for
+  ** PRIMARY KEY and UNIQUE constraints: the name in zName and, if there
+  ** was a COLLATE clause, an expression holding just the collation.
+  ** Any other item is an expression column, computed from each row.
+  ** Such expressions are resolved against the table the same way as a
+  ** CHECK constraint, so their TK_COLUMN nodes have iTable==-1.
+  */
+  for(i=0; i<pList->nExpr; i++){
+    struct ExprList_item *pItem = &pList->a[i];
+    Expr *pExpr = pItem->pExpr;
+    if( pItem->zName || pExpr==0 ) continue;
+    if( pExpr->op==TK_STRING ){
+      /* For backwards compatibility, a string literal that matches the
+      ** name of a column is taken to be that column. */
+      for(j=0; j<pTab->nCol; j++){
+        if( sqlite3StrICmp(pExpr->u.zToken, pTab->aCol[j].zName)==0 ) break;
+      }
+      if( j>=pTab->nCol ) j = -1;
+    }else{
+      j = pExpr->op==TK_ID ? 0 : -1;
+    }
+    if( j>=0 ){
+      pItem->zName = sqlite3DbStrDup(db, pExpr->u.zToken);
+      if( pExpr->flags & EP_ExpCollate ){
+        pExpr->op = TK_COLUMN;
+      }else{
+        sqlite3ExprDelete(db, pExpr);
+        pItem->pExpr = 0;
+      }
+      if( pItem->zName==0 ) goto exit_create_index;
+    }else{
+      SrcList sSrc;        /* Fake SrcList holding just pTab */
+      NameContext sNC;     /* Name context for the expression */
+      memset(&sNC, 0, sizeof(sNC));
+      memset(&sSrc, 0, sizeof(sSrc));
+      sSrc.nSrc = 1;
+      sSrc.a[0].zName = pTab->zName;
+      sSrc.a[0].pTab = pTab;
+      sSrc.a[0].iCursor = -1;
+      sNC.pParse = pParse;
+      sNC.pSrcList = &sSrc;
+      sNC.ncFlags = NC_IdxExpr;
+      if( sqlite3ResolveExprNames(&sNC, pExpr) ) goto exit_create_index;
+      nIdxExpr++;
+    }
+  }
+
   /* Figure out how many bytes of space are required to store explicitly   //找出需要存储多少字节的空间，显示指定序列的名称。
   ** specified collation sequence names.
   */
@@ -2719,6 +2774,11 @@ Index *sqlite3CreateIndex(
     Expr *pExpr = pList->a[i].pExpr;
     if( pExpr ){
       CollSeq *pColl = pExpr->pColl;
+      if( pList->a[i].zName==0 ){
+        /* An expression column uses the collation of the expression */
+        pColl = sqlite3ExprCollSeq(pParse, pExpr);
+        if( pColl==0 ) continue;
+      }
       /* Either pColl!=0 or there was an OOM failure.  But if an OOM   //pColl != 0或者有一个OOM失效。
       ** failure we have quit before reaching this point. */           //如果OOM失效失效，在达到这一点时撤销这一操作。
       if( ALWAYS(pColl) ){
@@ -2786,6 +2846,27 @@ Index *sqlite3CreateIndex(
     int requestedSortOrder;
     char *zColl;                   /* Collation sequence name */                //定义排序序列的名称
 
+    if( zColName==0 ){
+      /* An expression column.  The expression itself is kept in the
+      ** same slot of Index.aColExpr, which is pList once the loop is
+      ** done. */
+      CollSeq *pColl = sqlite3ExprCollSeq(pParse, pListItem->pExpr);
+      pIndex->aiColumn[i] = XN_EXPR;
+      if( pColl ){
+        int nColl = sqlite3Strlen30(pColl->zName) + 1;
+        assert( nExtra>=nColl );
+        memcpy(zExtra, pColl->zName, nColl);
+        zColl = zExtra;
+        zExtra += nColl;
+        nExtra -= nColl;
+      }else{
+        zColl = "BINARY";
+      }
+      pIndex->azColl[i] = zColl;
+      requestedSortOrder = pListItem->sortOrder & sortOrderMask;
+      pIndex->aSortOrder[i] = (u8)requestedSortOrder;
+      continue;
+    }
     for(j=0, pTabCol=pTab->aCol; j<pTab->nCol; j++, pTabCol++){
       if( sqlite3StrICmp(zColName, pTabCol->zName)==0 ) break;
     }
@@ -2823,6 +2904,18 @@ Index *sqlite3CreateIndex(
     requestedSortOrder = pListItem->sortOrder & sortOrderMask;
     pIndex->aSortOrder[i] = (u8)requestedSortOrder;
   }
+  if( nIdxExpr ){
+    /* Hand the list over to the index.  Entries for ordinary columns
+    ** carry nothing the index needs once azColl[] is filled in. */
+    for(i=0; i<pList->nExpr; i++){
+      if( pList->a[i].zName ){
+        sqlite3ExprDelete(db, pList->a[i].pExpr);
+        pList->a[i].pExpr = 0;
+      }
+    }
+    pIndex->aColExpr = pList;
+    pList = 0;
+  }
   sqlite3DefaultRowEst(pIndex);
 
   if( pTab==pParse->pNewTable ){
@@ -3001,6 +3094,7 @@ Index *sqlite3CreateIndex(
 exit_create_index:
   if( pIndex ){
     sqlite3DbFree(db, pIndex->zColAff);
+    sqlite3ExprListDelete(db, pIndex->aColExpr);
     sqlite3DbFree(db, pIndex);
   }
   sqlite3ExprListDelete(db, pList);
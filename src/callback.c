@@ -306,8 +306,7 @@ void sqlite3FuncDefInsert(
 ){
   FuncDef *pOther;
   int nName = sqlite3Strlen30(pDef->zName);
-  u8 c1 = (u8)pDef->zName[0];
-  int h = (sqlite3UpperToLower[c1] + nName) % ArraySize(pHash->a);
+  int h = SQLITE_FUNC_HASH(pDef->zName, nName);
   pOther = functionSearch(pHash, h, pDef->zName, nName);
   if( pOther ){
     assert( pOther!=pDef && pOther->pNext!=pDef );
@@ -357,7 +356,7 @@ FuncDef *sqlite3FindFunction(
   assert( nArg>=(-2) );
   assert( nArg>=(-1) || createFlag==0 );
   assert( enc==SQLITE_UTF8 || enc==SQLITE_UTF16LE || enc==SQLITE_UTF16BE );
-  h = (sqlite3UpperToLower[(u8)zName[0]] + nName) % ArraySize(db->aFunc.a);
+  h = SQLITE_FUNC_HASH(zName, nName);
 
   /* First search for a match amongst the application-defined functions.首先搜索匹配之的应用程序定义的功能。
   */
@@ -245,6 +245,86 @@ static void computeJD(DateTime *p){
   }
 }
 
+/*
+** Return the value of the two decimal digits at z[0] and z[1], or -1
+** if either character is not a digit.
+*/
+static int twoDigits(const u8 *z){
+  if( !sqlite3Isdigit(z[0]) || !sqlite3Isdigit(z[1]) ) return -1;
+  return (z[0] - '0')*10 + z[1] - '0';
+}
+
+/*
+** Fast path for parseYyyyMmDd().  Only the fixed-width forms
+**
+**     YYYY-MM-DD HH:MM:SS.FFF
+**     YYYY-MM-DD HH:MM:SS
+**     YYYY-MM-DD HH:MM
+**     YYYY-MM-DD
+**
+** are recognized, with either a single space or a single 'T' between
+** the date and the time and nothing at all (no timezone and no trailing
+** spaces) after them.  That covers the output of the date and time
+** functions themselves, and so nearly every stored timestamp.
+**
+** Return 0 and fill in p on success.  Return 1, leaving p unchanged,
+** if zDate is in any other form.  The caller then falls back to the
+** general parser, which produces the same result for every string
+** accepted here.
+*/
+static int parseYyyyMmDdFast(const char *zDate, DateTime *p){
+  const u8 *z = (const u8*)zDate;
+  int Y, M, D, h, m, s;
+  double ms = 0.0;
+
+  if( (Y = twoDigits(z))<0 || (s = twoDigits(&z[2]))<0 || z[4]!='-' ) return 1;
+  Y = Y*100 + s;
+  M = twoDigits(&z[5]);
+  if( M<1 || M>12 || z[7]!='-' ) return 1;
+  D = twoDigits(&z[8]);
+  if( D<1 || D>31 ) return 1;
+  z += 10;
+  if( z[0]==0 ){
+    p->validHMS = 0;
+  }else{
+    if( z[0]!=' ' && z[0]!='T' ) return 1;
+    h = twoDigits(&z[1]);
+    if( h<0 || h>24 || z[3]!=':' ) return 1;
+    m = twoDigits(&z[4]);
+    if( m<0 || m>59 ) return 1;
+    z += 6;
+    s = 0;
+    if( z[0]==':' ){
+      s = twoDigits(&z[1]);
+      if( s<0 || s>59 ) return 1;
+      z += 3;
+      if( z[0]=='.' && sqlite3Isdigit(z[1]) ){
+        double rScale = 1.0;
+        z++;
+        while( sqlite3Isdigit(*z) ){
+          ms = ms*10.0 + *z - '0';
+          rScale *= 10.0;
+          z++;
+        }
+        ms /= rScale;
+      }
+    }
+    if( z[0]!=0 ) return 1;
+    p->validHMS = 1;
+    p->h = h;
+    p->m = m;
+    p->s = s + ms;
+    p->tz = 0;
+    p->validTZ = 0;
+  }
+  p->validJD = 0;
+  p->validYMD = 1;
+  p->Y = Y;
+  p->M = M;
+  p->D = D;
+  return 0;
+}
+
 /*
 ** Parse dates of the form   解析日期的形式：
 **
@@ -260,6 +340,9 @@ static void computeJD(DateTime *p){
 static int parseYyyyMmDd(const char *zDate, DateTime *p){
   int Y, M, D, neg;
 
+  if( parseYyyyMmDdFast(zDate, p)==0 ){
+    return 0;
+  }
   if( zDate[0]=='-' ){
     zDate++;
     neg = 1;
@@ -460,6 +543,48 @@ static int osLocaltime(time_t *t, struct tm *pTm){
 
 
 #ifndef SQLITE_OMIT_LOCALTIME
+/*
+** The most recent result of one localtimeOffset() call made by a
+** "localtime" or "utc" modifier.  The offset is known to hold for every
+** time value from iLo to iHi, both of which lie in the hour that begins
+** iHour*3600 seconds after 1970-01-01.
+*/
+typedef struct LocaltimeCache LocaltimeCache;
+struct LocaltimeCache {
+  sqlite3_int64 iHour;            /* Hour of the cached offset, or -1 */
+  sqlite3_int64 iOffset;          /* Localtime minus UTC in milliseconds */
+  sqlite3_int64 iLo, iHi;         /* Range of time values known to match */
+};
+
+/*
+** Set *piOffset to the difference (in milliseconds) between localtime
+** and UTC at t seconds after 1970-01-01 00:00:00 UTC.  Return non-zero
+** if the OS is unable to convert t to localtime.
+*/
+static int localtimeOffsetAt(time_t t, sqlite3_int64 *piOffset){
+  DateTime y;
+  struct tm sLocal;
+
+  /* Initialize the contents of sLocal to avoid a compiler warning. */
+  memset(&sLocal, 0, sizeof(sLocal));
+  if( osLocaltime(&t, &sLocal) ){
+    return 1;
+  }
+  y.Y = sLocal.tm_year + 1900;
+  y.M = sLocal.tm_mon + 1;
+  y.D = sLocal.tm_mday;
+  y.h = sLocal.tm_hour;
+  y.m = sLocal.tm_min;
+  y.s = sLocal.tm_sec;
+  y.validYMD = 1;
+  y.validHMS = 1;
+  y.validJD = 0;
+  y.validTZ = 0;
+  computeJD(&y);
+  *piOffset = y.iJD - ((sqlite3_int64)t*1000 + 21086676*(i64)10000000);
+  return 0;
+}
+
 /*
 ** Compute the difference (in milliseconds) between localtime and UTC
 ** (a.k.a. GMT) for the time value p where p is in UTC. If no error occurs,
@@ -467,18 +592,26 @@ static int osLocaltime(time_t *t, struct tm *pTm){
 **
 ** Or, if an error does occur, set *pRc to SQLITE_ERROR. The returned value
 ** is undefined in this case.  或者，如果出现错误，设置SQLITE_ERROR为*pRc。在这种情况下，返回值是不确定的。
+**
+** If pCache is not NULL and p lies within the range it covers, the OS
+** is not consulted at all.  On a miss in a new hour, the offset at p
+** alone is computed and remembered.  On a miss in the cached hour, the
+** offset is computed once more at the first or last second of the hour,
+** whichever is on the same side as p, and if it agrees the range is
+** widened to that end of the hour.  Timezone rules never change twice
+** within an hour, so two equal offsets in one hour hold for every time
+** between them.  Hence no miss costs more than one OS call unless the
+** hour contains a transition.
 */
 static sqlite3_int64 localtimeOffset(
   DateTime *p,                    /* Date at which to calculate offset */ 计算偏移量的日期
   sqlite3_context *pCtx,          /* Write error here if one occurs */    如果错误出现写入错误
-  int *pRc                        /* OUT: Error code. SQLITE_OK or ERROR */ 错误代码。SQLITE_OK或者错误。
+  int *pRc,                       /* OUT: Error code. SQLITE_OK or ERROR */ 错误代码。SQLITE_OK或者错误。
+  LocaltimeCache *pCache          /* Offset cache, or NULL */
 ){
-  DateTime x, y;
+  DateTime x;
   time_t t;
-  struct tm sLocal;
-
-  /* Initialize the contents of sLocal to avoid a compiler warning. */ 初始化sLocal内容以避免编译器警告。
-  memset(&sLocal, 0, sizeof(sLocal));
+  sqlite3_int64 iOffset, iEdge;
 
   x = *p;
   computeYMD_HMS(&x);
@@ -497,29 +630,76 @@ static sqlite3_int64 localtimeOffset(
   x.validJD = 0;
   computeJD(&x);
   t = (time_t)(x.iJD/1000 - 21086676*(i64)10000);
-  if( osLocaltime(&t, &sLocal) ){
+  if( pCache && pCache->iHour==t/3600 ){
+    if( t<pCache->iLo ){
+      iEdge = t - t%3600;
+      if( localtimeOffsetAt((time_t)iEdge, &iOffset)==0
+       && iOffset==pCache->iOffset
+      ){
+        pCache->iLo = iEdge;
+      }
+    }else if( t>pCache->iHi ){
+      iEdge = t - t%3600 + 3599;
+      if( localtimeOffsetAt((time_t)iEdge, &iOffset)==0
+       && iOffset==pCache->iOffset
+      ){
+        pCache->iHi = iEdge;
+      }
+    }
+    if( t>=pCache->iLo && t<=pCache->iHi ){
+      *pRc = SQLITE_OK;
+      return pCache->iOffset;
+    }
+  }
+  if( localtimeOffsetAt(t, &iOffset) ){
     sqlite3_result_error(pCtx, "local time unavailable", -1);
     *pRc = SQLITE_ERROR;
     return 0;
   }
-  y.Y = sLocal.tm_year + 1900;
-  y.M = sLocal.tm_mon + 1;
-  y.D = sLocal.tm_mday;
-  y.h = sLocal.tm_hour;
-  y.m = sLocal.tm_min;
-  y.s = sLocal.tm_sec;
-  y.validYMD = 1;
-  y.validHMS = 1;
-  y.validJD = 0;
-  y.validTZ = 0;
-  computeJD(&y);
+  if( pCache && pCache->iHour!=t/3600 ){
+    pCache->iHour = t/3600;
+    pCache->iOffset = iOffset;
+    pCache->iLo = pCache->iHi = t;
+  }
   *pRc = SQLITE_OK;
-  return y.iJD - x.iJD;
+  return iOffset;
 }
 #endif /* SQLITE_OMIT_LOCALTIME */
 
 /*
-** Process a modifier to a date-time stamp.  The modifiers are
+** Kinds of modifier recognized by compileModifier().
+*/
+#define DATE_MOD_ERROR       0   /* Unrecognized or malformed modifier */
+#define DATE_MOD_LOCALTIME   1   /* localtime */
+#define DATE_MOD_UTC         2   /* utc */
+#define DATE_MOD_UNIXEPOCH   3   /* unixepoch */
+#define DATE_MOD_WEEKDAY     4   /* weekday N */
+#define DATE_MOD_START_DAY   5   /* start of day */
+#define DATE_MOD_START_MONTH 6   /* start of month */
+#define DATE_MOD_START_YEAR  7   /* start of year */
+#define DATE_MOD_ADD         8   /* NNN days/hours/minutes/seconds, +HH:MM */
+#define DATE_MOD_MONTHS      9   /* NNN months */
+#define DATE_MOD_YEARS      10   /* NNN years */
+
+/*
+** A modifier to a date-time stamp after it has been parsed by
+** compileModifier().  A constant modifier is parsed once and the
+** result kept as auxiliary data on the function argument, so that
+** later rows of the same statement go straight to applyModifier().
+*/
+typedef struct DateModifier DateModifier;
+struct DateModifier {
+  int eType;                /* One of the DATE_MOD_* values */
+  int n;                    /* Day of the week for DATE_MOD_WEEKDAY */
+  double r;                 /* Count for DATE_MOD_MONTHS and DATE_MOD_YEARS */
+  sqlite3_int64 iDelta;     /* Milliseconds to add for DATE_MOD_ADD */
+#ifndef SQLITE_OMIT_LOCALTIME
+  LocaltimeCache aLt[2];    /* Offset caches for localtime and utc */
+#endif
+};
+
+/*
+** Parse a modifier to a date-time stamp into *pMod.  The modifiers are
 ** as follows:  对日期时间戳进行修改。修改如下：
 **
 **     NNN days             天数
@@ -537,16 +717,18 @@ static sqlite3_int64 localtimeOffset(
 **     localtime            当地时间
 **     utc                  世界时间代码
 **
-** Return 0 on success and 1 if there is any kind of error. If the error
-** is in a system call (i.e. localtime()), then an error message is written
-** to context pCtx. If the error is an unrecognized modifier, no error is
-** written to pCtx.   执行成功返回0，有错误就返回1.如果错误在一个系统调用中（即localtime()），那么一个错误信息就会写入到pCtx的文本里。如果错误是一个无法识别的修正，就不会有错误写入pCtx。
+** Anything else is compiled as DATE_MOD_ERROR.  None of the work that
+** depends on the date itself is done here; see applyModifier().
 */
-static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
-  int rc = 1;
+static void compileModifier(const char *zMod, DateModifier *pMod){
   int n;
   double r;
   char *z, zBuf[30];
+  memset(pMod, 0, sizeof(*pMod));
+#ifndef SQLITE_OMIT_LOCALTIME
+  pMod->aLt[0].iHour = -1;
+  pMod->aLt[1].iHour = -1;
+#endif
   z = zBuf;
   for(n=0; n<ArraySize(zBuf)-1 && zMod[n]; n++){
     z[n] = (char)sqlite3UpperToLower[(u8)zMod[n]];
@@ -561,9 +743,7 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
       ** show local time.     假设当前的时间值为格林尼治时间，转移到显示本地时间。
       */
       if( strcmp(z, "localtime")==0 ){
-        computeJD(p);
-        p->iJD += localtimeOffset(p, pCtx, &rc);
-        clearYMD_HMS_TZ(p);
+        pMod->eType = DATE_MOD_LOCALTIME;
       }
       break;
     }
@@ -575,21 +755,12 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
       ** Treat the current value of p->iJD as the number of
       ** seconds since 1970.  Convert to a real julian day number.  把p->iJD的当前时间值看做自1970以来的秒数。转换到一个真正的朱利安日数。
       */
-      if( strcmp(z, "unixepoch")==0 && p->validJD ){
-        p->iJD = (p->iJD + 43200)/86400 + 21086676*(i64)10000000;
-        clearYMD_HMS_TZ(p);
-        rc = 0;
+      if( strcmp(z, "unixepoch")==0 ){
+        pMod->eType = DATE_MOD_UNIXEPOCH;
       }
 #ifndef SQLITE_OMIT_LOCALTIME
       else if( strcmp(z, "utc")==0 ){
-        sqlite3_int64 c1;
-        computeJD(p);
-        c1 = localtimeOffset(p, pCtx, &rc);
-        if( rc==SQLITE_OK ){
-          p->iJD -= c1;
-          clearYMD_HMS_TZ(p);
-          p->iJD += c1 - localtimeOffset(p, pCtx, &rc);
-        }
+        pMod->eType = DATE_MOD_UTC;
       }
 #endif
       break;
@@ -605,16 +776,8 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
       if( strncmp(z, "weekday ", 8)==0
                && sqlite3AtoF(&z[8], &r, sqlite3Strlen30(&z[8]), SQLITE_UTF8)
                && (n=(int)r)==r && n>=0 && r<7 ){
-        sqlite3_int64 Z;
-        computeYMD_HMS(p);
-        p->validTZ = 0;
-        p->validJD = 0;
-        computeJD(p);
-        Z = ((p->iJD + 129600000)/86400000) % 7;
-        if( Z>n ) Z -= 7;
-        p->iJD += (n - Z)*86400000;
-        clearYMD_HMS_TZ(p);
-        rc = 0;
+        pMod->eType = DATE_MOD_WEEKDAY;
+        pMod->n = n;
       }
       break;
     }
@@ -627,22 +790,12 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
       */
       if( strncmp(z, "start of ", 9)!=0 ) break;
       z += 9;
-      computeYMD(p);
-      p->validHMS = 1;
-      p->h = p->m = 0;
-      p->s = 0.0;
-      p->validTZ = 0;
-      p->validJD = 0;
       if( strcmp(z,"month")==0 ){
-        p->D = 1;
-        rc = 0;
+        pMod->eType = DATE_MOD_START_MONTH;
       }else if( strcmp(z,"year")==0 ){
-        computeYMD(p);
-        p->M = 1;
-        p->D = 1;
-        rc = 0;
+        pMod->eType = DATE_MOD_START_YEAR;
       }else if( strcmp(z,"day")==0 ){
-        rc = 0;
+        pMod->eType = DATE_MOD_START_DAY;
       }
       break;
     }
@@ -661,7 +814,6 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
       double rRounder;
       for(n=1; z[n] && z[n]!=':' && !sqlite3Isspace(z[n]); n++){}
       if( !sqlite3AtoF(z, &r, n, SQLITE_UTF8) ){
-        rc = 1;
         break;
       }
       if( z[n]==':' ){
@@ -681,10 +833,8 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
         day = tx.iJD/86400000;
         tx.iJD -= day*86400000;
         if( z[0]=='-' ) tx.iJD = -tx.iJD;
-        computeJD(p);
-        clearYMD_HMS_TZ(p);
-        p->iJD += tx.iJD;
-        rc = 0;
+        pMod->eType = DATE_MOD_ADD;
+        pMod->iDelta = tx.iJD;
         break;
       }
       z += n;
@@ -692,46 +842,148 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
       n = sqlite3Strlen30(z);
       if( n>10 || n<3 ) break;
       if( z[n-1]=='s' ){ z[n-1] = 0; n--; }
-      computeJD(p);
-      rc = 0;
       rRounder = r<0 ? -0.5 : +0.5;
+      pMod->eType = DATE_MOD_ADD;
+      pMod->r = r;
       if( n==3 && strcmp(z,"day")==0 ){
-        p->iJD += (sqlite3_int64)(r*86400000.0 + rRounder);
+        pMod->iDelta = (sqlite3_int64)(r*86400000.0 + rRounder);
       }else if( n==4 && strcmp(z,"hour")==0 ){
-        p->iJD += (sqlite3_int64)(r*(86400000.0/24.0) + rRounder);
+        pMod->iDelta = (sqlite3_int64)(r*(86400000.0/24.0) + rRounder);
       }else if( n==6 && strcmp(z,"minute")==0 ){
-        p->iJD += (sqlite3_int64)(r*(86400000.0/(24.0*60.0)) + rRounder);
+        pMod->iDelta = (sqlite3_int64)(r*(86400000.0/(24.0*60.0)) + rRounder);
       }else if( n==6 && strcmp(z,"second")==0 ){
-        p->iJD += (sqlite3_int64)(r*(86400000.0/(24.0*60.0*60.0)) + rRounder);
+        pMod->iDelta =
+            (sqlite3_int64)(r*(86400000.0/(24.0*60.0*60.0)) + rRounder);
       }else if( n==5 && strcmp(z,"month")==0 ){
-        int x, y;
-        computeYMD_HMS(p);
-        p->M += (int)r;
-        x = p->M>0 ? (p->M-1)/12 : (p->M-12)/12;
-        p->Y += x;
-        p->M -= x*12;
-        p->validJD = 0;
-        computeJD(p);
-        y = (int)r;
-        if( y!=r ){
-          p->iJD += (sqlite3_int64)((r - y)*30.0*86400000.0 + rRounder);
-        }
+        pMod->eType = DATE_MOD_MONTHS;
       }else if( n==4 && strcmp(z,"year")==0 ){
-        int y = (int)r;
-        computeYMD_HMS(p);
-        p->Y += y;
-        p->validJD = 0;
-        computeJD(p);
-        if( y!=r ){
-          p->iJD += (sqlite3_int64)((r - y)*365.0*86400000.0 + rRounder);
-        }
+        pMod->eType = DATE_MOD_YEARS;
       }else{
-        rc = 1;
+        pMod->eType = DATE_MOD_ERROR;
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+/*
+** Apply a modifier previously parsed by compileModifier() to the
+** date-time stamp p.
+**
+** Return 0 on success and 1 if there is any kind of error. If the error
+** is in a system call (i.e. localtime()), then an error message is written
+** to context pCtx. If the error is an unrecognized modifier, no error is
+** written to pCtx.   执行成功返回0，有错误就返回1.如果错误在一个系统调用中（即localtime()），那么一个错误信息就会写入到pCtx的文本里。如果错误是一个无法识别的修正，就不会有错误写入pCtx。
+*/
+static int applyModifier(
+  sqlite3_context *pCtx,
+  DateModifier *pMod,
+  DateTime *p
+){
+  int rc = 0;
+  switch( pMod->eType ){
+#ifndef SQLITE_OMIT_LOCALTIME
+    case DATE_MOD_LOCALTIME: {
+      computeJD(p);
+      p->iJD += localtimeOffset(p, pCtx, &rc, &pMod->aLt[0]);
+      clearYMD_HMS_TZ(p);
+      break;
+    }
+    case DATE_MOD_UTC: {
+      sqlite3_int64 c1;
+      computeJD(p);
+      /* The two offsets are for different instants (the second is taken
+      ** at the UTC time estimated by the first), so each has its own cache
+      ** entry.  Otherwise they would evict each other on every row. */
+      c1 = localtimeOffset(p, pCtx, &rc, &pMod->aLt[0]);
+      if( rc==SQLITE_OK ){
+        p->iJD -= c1;
+        clearYMD_HMS_TZ(p);
+        p->iJD += c1 - localtimeOffset(p, pCtx, &rc, &pMod->aLt[1]);
+      }
+      break;
+    }
+#endif
+    case DATE_MOD_UNIXEPOCH: {
+      if( !p->validJD ) return 1;
+      p->iJD = (p->iJD + 43200)/86400 + 21086676*(i64)10000000;
+      clearYMD_HMS_TZ(p);
+      break;
+    }
+    case DATE_MOD_WEEKDAY: {
+      sqlite3_int64 Z;
+      computeYMD_HMS(p);
+      p->validTZ = 0;
+      p->validJD = 0;
+      computeJD(p);
+      Z = ((p->iJD + 129600000)/86400000) % 7;
+      if( Z>pMod->n ) Z -= 7;
+      p->iJD += (pMod->n - Z)*86400000;
+      clearYMD_HMS_TZ(p);
+      break;
+    }
+    case DATE_MOD_START_DAY:
+    case DATE_MOD_START_MONTH:
+    case DATE_MOD_START_YEAR: {
+      computeYMD(p);
+      p->validHMS = 1;
+      p->h = p->m = 0;
+      p->s = 0.0;
+      p->validTZ = 0;
+      p->validJD = 0;
+      if( pMod->eType==DATE_MOD_START_YEAR ){
+        p->M = 1;
+      }
+      if( pMod->eType!=DATE_MOD_START_DAY ){
+        p->D = 1;
+      }
+      break;
+    }
+    case DATE_MOD_ADD: {
+      computeJD(p);
+      p->iJD += pMod->iDelta;
+      clearYMD_HMS_TZ(p);
+      break;
+    }
+    case DATE_MOD_MONTHS: {
+      double r = pMod->r;
+      double rRounder = r<0 ? -0.5 : +0.5;
+      int x, y;
+      computeJD(p);
+      computeYMD_HMS(p);
+      p->M += (int)r;
+      x = p->M>0 ? (p->M-1)/12 : (p->M-12)/12;
+      p->Y += x;
+      p->M -= x*12;
+      p->validJD = 0;
+      computeJD(p);
+      y = (int)r;
+      if( y!=r ){
+        p->iJD += (sqlite3_int64)((r - y)*30.0*86400000.0 + rRounder);
+      }
+      clearYMD_HMS_TZ(p);
+      break;
+    }
+    case DATE_MOD_YEARS: {
+      double r = pMod->r;
+      double rRounder = r<0 ? -0.5 : +0.5;
+      int y = (int)r;
+      computeJD(p);
+      computeYMD_HMS(p);
+      p->Y += y;
+      p->validJD = 0;
+      computeJD(p);
+      if( y!=r ){
+        p->iJD += (sqlite3_int64)((r - y)*365.0*86400000.0 + rRounder);
       }
       clearYMD_HMS_TZ(p);
       break;
     }
     default: {
+      rc = 1;
       break;
     }
   }
@@ -744,6 +996,10 @@ static int parseModifier(sqlite3_context *pCtx, const char *zMod, DateTime *p){
 ** the resulting time into the DateTime structure p.  Return 0
 ** on success and 1 if there are any errors.  处理时间函数的参数。参数[0]是一个日期时间戳。参数[1]和下面的是修改。分析全部并在日期时间结构体p中写入结果时间。成功返回0，有错误返回1.
 **
+** argv[0] is argument iArg0 of the SQL function.  It is needed to
+** locate the parsed modifiers attached to constant arguments by an
+** earlier call within the same statement.
+**
 ** If there are zero parameters (if even argv[0] is undefined)
 ** then assume a default value of "now" for argv[0].  如果有零参数（即使是未定义的参数[0]），就为参数[0]假设一个暂时的默认值。
 */
@@ -751,6 +1007,7 @@ static int isDate(
   sqlite3_context *context, 
   int argc, 
   sqlite3_value **argv, 
+  int iArg0,
   DateTime *p
 ){
   int i;
@@ -771,8 +1028,32 @@ static int isDate(
     }
   }
   for(i=1; i<argc; i++){
-    z = sqlite3_value_text(argv[i]);
-    if( z==0 || parseModifier(context, (char*)z, p) ) return 1;
+    DateModifier *pMod;
+    int rc;
+    pMod = (DateModifier*)sqlite3_get_auxdata(context, iArg0+i);
+    if( pMod ){
+      rc = applyModifier(context, pMod, p);
+    }else if( !sqlite3VdbeArgIsConstant(context, iArg0+i) ){
+      /* The modifier may differ on the next row, so there is no point
+      ** in keeping the parsed form.  Parse it onto the stack instead. */
+      DateModifier sMod;
+      z = sqlite3_value_text(argv[i]);
+      if( z==0 ) return 1;
+      compileModifier((char*)z, &sMod);
+      rc = applyModifier(context, &sMod, p);
+    }else{
+      z = sqlite3_value_text(argv[i]);
+      if( z==0 ) return 1;
+      pMod = (DateModifier*)sqlite3_malloc(sizeof(*pMod));
+      if( pMod==0 ){
+        sqlite3_result_error_nomem(context);
+        return 1;
+      }
+      compileModifier((char*)z, pMod);
+      rc = applyModifier(context, pMod, p);
+      sqlite3_set_auxdata(context, iArg0+i, pMod, sqlite3_free);
+    }
+    if( rc ) return 1;
   }
   return 0;
 }
@@ -794,7 +1075,7 @@ static void juliandayFunc(
   sqlite3_value **argv
 ){
   DateTime x;
-  if( isDate(context, argc, argv, &x)==0 ){
+  if( isDate(context, argc, argv, 0, &x)==0 ){
     computeJD(&x);
     sqlite3_result_double(context, x.iJD/86400000.0);
   }
@@ -811,7 +1092,7 @@ static void datetimeFunc(
   sqlite3_value **argv
 ){
   DateTime x;
-  if( isDate(context, argc, argv, &x)==0 ){
+  if( isDate(context, argc, argv, 0, &x)==0 ){
     char zBuf[100];
     computeYMD_HMS(&x);
     sqlite3_snprintf(sizeof(zBuf), zBuf, "%04d-%02d-%02d %02d:%02d:%02d",
@@ -831,7 +1112,7 @@ static void timeFunc(
   sqlite3_value **argv
 ){
   DateTime x;
-  if( isDate(context, argc, argv, &x)==0 ){
+  if( isDate(context, argc, argv, 0, &x)==0 ){
     char zBuf[100];
     computeHMS(&x);
     sqlite3_snprintf(sizeof(zBuf), zBuf, "%02d:%02d:%02d", x.h, x.m, (int)x.s);
@@ -850,7 +1131,7 @@ static void dateFunc(
   sqlite3_value **argv
 ){
   DateTime x;
-  if( isDate(context, argc, argv, &x)==0 ){
+  if( isDate(context, argc, argv, 0, &x)==0 ){
     char zBuf[100];
     computeYMD(&x);
     sqlite3_snprintf(sizeof(zBuf), zBuf, "%04d-%02d-%02d", x.Y, x.M, x.D);
@@ -889,7 +1170,7 @@ static void strftimeFunc(
   sqlite3 *db;
   const char *zFmt = (const char*)sqlite3_value_text(argv[0]);
   char zBuf[100];
-  if( zFmt==0 || isDate(context, argc-1, argv+1, &x) ) return;
+  if( zFmt==0 || isDate(context, argc-1, argv+1, 1, &x) ) return;
   db = sqlite3_context_db_handle(context);
   for(i=0, n=1; zFmt[i]; i++, n++){
     if( zFmt[i]=='%' ){
@@ -1101,18 +1382,22 @@ static void currentTimeFunc(
 ** This function registered all of the above C functions as SQL
 ** functions.  This should be the only routine in this file with
 ** external linkage.   这个函数注册以上所有的C函数为SQL函数。这应该是与外部联系的唯一程序。
+**
+** The functions are registered with VFUNCTION() because a 'now' argument
+** or modifier reads the clock, so two calls with the same arguments may
+** return different values.
 */
 void sqlite3RegisterDateTimeFunctions(void){
   static SQLITE_WSD FuncDef aDateTimeFuncs[] = {
 #ifndef SQLITE_OMIT_DATETIME_FUNCS
-    FUNCTION(julianday,        -1, 0, 0, juliandayFunc ),
-    FUNCTION(date,             -1, 0, 0, dateFunc      ),
-    FUNCTION(time,             -1, 0, 0, timeFunc      ),
-    FUNCTION(datetime,         -1, 0, 0, datetimeFunc  ),
-    FUNCTION(strftime,         -1, 0, 0, strftimeFunc  ),
-    FUNCTION(current_time,      0, 0, 0, ctimeFunc     ),
-    FUNCTION(current_timestamp, 0, 0, 0, ctimestampFunc),
-    FUNCTION(current_date,      0, 0, 0, cdateFunc     ),
+    VFUNCTION(julianday,       -1, 0, 0, juliandayFunc ),
+    VFUNCTION(date,            -1, 0, 0, dateFunc      ),
+    VFUNCTION(time,            -1, 0, 0, timeFunc      ),
+    VFUNCTION(datetime,        -1, 0, 0, datetimeFunc  ),
+    VFUNCTION(strftime,        -1, 0, 0, strftimeFunc  ),
+    VFUNCTION(current_time,     0, 0, 0, ctimeFunc     ),
+    VFUNCTION(current_timestamp,0, 0, 0, ctimestampFunc),
+    VFUNCTION(current_date,     0, 0, 0, cdateFunc     ),
 #else
     STR_FUNCTION(current_time,      0, "%H:%M:%S",          0, currentTimeFunc),
     STR_FUNCTION(current_date,      0, "%Y-%m-%d",          0, currentTimeFunc),
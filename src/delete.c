@@ -561,6 +561,10 @@ void sqlite3GenerateRowDelete(
     	//在此寻找要删除行的游标，这可能是BEFORE 触发器代码已经移除了要删除的行，不要尝试去第二次删除该行，不要解除AFTER 触发器*/
     sqlite3VdbeAddOp3(v, OP_NotExists, iCur, iLabel, iRowid);
 
+    /* The triggers may also have modified the row, so anything cached
+    ** about it (see sqlite3ExprCodeLoadIndexColumn()) is stale. */
+    sqlite3ExprCacheClear(pParse);
+
     /* Do FK processing. This call checks that any FK constraints that
     ** refer to this table (i.e. constraints attached to other tables) 
     ** are not violated by deleting this row. 
@@ -666,6 +670,8 @@ int sqlite3GenerateIndexKey(
     int idx = pIdx->aiColumn[j];
     if( idx==pTab->iPKey ){
       sqlite3VdbeAddOp2(v, OP_SCopy, regBase+nCol, regBase+j);
+    }else if( idx==XN_EXPR ){
+      sqlite3ExprCodeLoadIndexColumn(pParse, pIdx, iCur, j, regBase+j);
     }else{
       sqlite3VdbeAddOp3(v, OP_Column, iCur, idx, regBase+j);
       sqlite3ColumnDefault(v, pTab, idx, -1);
@@ -1138,6 +1138,19 @@ void sqlite3ExprListDelete(sqlite3 *db, ExprList *pList){
   sqlite3DbFree(db, pList);
 }
 
+/*
+** Return true if pExpr is a TK_FUNCTION that calls a function with all
+** of the properties in mFlags2, as recorded by the name resolver.
+** EP2_Constant means that it always returns the same value for the same
+** arguments, and EP2_NoError that it may be evaluated before it is
+** needed.  A reduced Expr has no flags2 field, so it never qualifies.
+*/
+static int exprFuncIsConstant(Expr *pExpr, u8 mFlags2){
+  assert( pExpr->op==TK_FUNCTION );
+  if( ExprHasAnyProperty(pExpr, EP_TokenOnly|EP_Reduced) ) return 0;
+  return (pExpr->flags2 & mFlags2)==mFlags2;
+}
+
 /*
 ** These routines are Walker callbacks.  Walker.u.pi is a pointer
 ** to an integer.  These routines are checking an expression to see
@@ -1149,23 +1162,32 @@ void sqlite3ExprListDelete(sqlite3 *db, ExprList *pList){
 **     sqlite3ExprIsConstant()
 **     sqlite3ExprIsConstantNotJoin()
 **     sqlite3ExprIsConstantOrFunction()
+**     isAppropriateForFactoring()
 **
 */
 static int exprNodeIsConstant(Walker *pWalker, Expr *pExpr){
 
-  /* If pWalker->u.i is 3 then any term of the expression that comes from
-  ** the ON or USING clauses of a join disqualifies the expression
+  /* If pWalker->u.i is 3 or 4 then any term of the expression that comes
+  ** from the ON or USING clauses of a join disqualifies the expression
   ** from being considered constant. */
-  if( pWalker->u.i==3 && ExprHasAnyProperty(pExpr, EP_FromJoin) ){
+  if( pWalker->u.i>=3 && ExprHasAnyProperty(pExpr, EP_FromJoin) ){
     pWalker->u.i = 0;
     return WRC_Abort;
   }
 
   switch( pExpr->op ){
     /* Consider functions to be constant if all their arguments are constant
-    ** and pWalker->u.i==2 */
+    ** and pWalker->u.i==2, or if pWalker->u.i==4 and the function is one
+    ** that always returns the same result for the same arguments and
+    ** cannot raise an error, so that it is safe to evaluate it before
+    ** (or even if) the point where it is used is reached. */
     case TK_FUNCTION:
       if( pWalker->u.i==2 ) return 0;
+      if( pWalker->u.i==4
+       && exprFuncIsConstant(pExpr, EP2_Constant|EP2_NoError)
+      ){
+        return WRC_Continue;
+      }
       /* Fall through */
     case TK_ID:
     case TK_COLUMN:
@@ -1177,6 +1199,14 @@ static int exprNodeIsConstant(Walker *pWalker, Expr *pExpr){
       testcase( pExpr->op==TK_AGG_COLUMN );
       pWalker->u.i = 0;
       return WRC_Abort;
+    case TK_REGISTER:
+      /* When pWalker->u.i==4 the expression may be evaluated by the init
+      ** code, before whatever loads the register has run. */
+      if( pWalker->u.i==4 ){
+        pWalker->u.i = 0;
+        return WRC_Abort;
+      }
+      return WRC_Continue;
     default:
       testcase( pExpr->op==TK_SELECT ); /* selectNodeIsConstant will disallow */
       testcase( pExpr->op==TK_EXISTS ); /* selectNodeIsConstant will disallow */
@@ -1188,9 +1218,10 @@ static int selectNodeIsConstant(Walker *pWalker, Select *NotUsed){
   pWalker->u.i = 0;
   return WRC_Abort;
 }
-static int exprIsConst(Expr *p, int initFlag){
+static int exprIsConst(Parse *pParse, Expr *p, int initFlag){
   Walker w;
   w.u.i = initFlag;
+  w.pParse = pParse;
   w.xExprCallback = exprNodeIsConstant;
   w.xSelectCallback = selectNodeIsConstant;
   sqlite3WalkExpr(&w, p);
@@ -1206,7 +1237,7 @@ static int exprIsConst(Expr *p, int initFlag){
 ** a constant.
 */
 int sqlite3ExprIsConstant(Expr *p){
-  return exprIsConst(p, 1);
+  return exprIsConst(0, p, 1);
 }
 
 /*
@@ -1216,7 +1247,7 @@ int sqlite3ExprIsConstant(Expr *p){
 ** an ON or USING clause.
 */
 int sqlite3ExprIsConstantNotJoin(Expr *p){
-  return exprIsConst(p, 3);
+  return exprIsConst(0, p, 3);
 }
 
 /*
@@ -1229,7 +1260,7 @@ int sqlite3ExprIsConstantNotJoin(Expr *p){
 ** a constant.
 */
 int sqlite3ExprIsConstantOrFunction(Expr *p){
-  return exprIsConst(p, 2);
+  return exprIsConst(0, p, 2);
 }
 
 /*
@@ -1824,6 +1855,87 @@ int sqlite3CodeSubselect(
 #endif /* SQLITE_OMIT_SUBQUERY */
 
 #ifndef SQLITE_OMIT_SUBQUERY
+/*
+** If expression p is an integer constant, write its value into *piVal
+** and return true.  Otherwise return false.  Unlike
+** sqlite3ExprIsInteger(), this accepts literals that need 64 bits.
+*/
+static int exprIsInt64(Expr *p, i64 *piVal){
+  int iVal;
+  if( sqlite3ExprIsInteger(p, &iVal) ){
+    *piVal = iVal;
+    return 1;
+  }
+  if( p->op==TK_INTEGER && !ExprHasProperty(p, EP_IntValue) ){
+    const char *z = p->u.zToken;
+    return sqlite3Atoi64(z, piVal, sqlite3Strlen30(z), SQLITE_UTF8)==0;
+  }
+  return 0;
+}
+
+/*
+** Restore the heap property of a[i..n-1], given that it holds everywhere
+** below element i.
+*/
+static void siftDownInt64(i64 *a, int i, int n){
+  int j;
+  i64 t;
+  while( (j = 2*i+1)<n ){
+    if( j+1<n && a[j+1]>a[j] ) j++;
+    if( a[i]>=a[j] ) break;
+    t = a[i]; a[i] = a[j]; a[j] = t;
+    i = j;
+  }
+}
+
+/*
+** Sort the n integers in a[] into ascending order using a heapsort.
+*/
+static void sortInt64(i64 *a, int n){
+  int i;
+  i64 t;
+  for(i=n/2-1; i>=0; i--){
+    siftDownInt64(a, i, n);
+  }
+  while( n>1 ){
+    n--;
+    t = a[0]; a[0] = a[n]; a[n] = t;
+    siftDownInt64(a, 0, n);
+  }
+}
+
+/*
+** If the RHS of IN expression pExpr is a list of integer constants,
+** return an array holding the distinct values of the list in ascending
+** order, preceded by the number of values.  The array is obtained from
+** sqlite3DbMallocRaw() and is suitable for use as a P4_INT64ARRAY operand
+** of OP_NotInIntList.  Return NULL if the RHS is anything else.
+*/
+static i64 *exprIntegerList(Parse *pParse, Expr *pExpr){
+  sqlite3 *db = pParse->db;
+  ExprList *pList;
+  i64 *aVal;
+  int i, n;
+
+  if( ExprHasProperty(pExpr, EP_xIsSelect) ) return 0;
+  pList = pExpr->x.pList;
+  if( pList==0 || pList->nExpr==0 ) return 0;
+  aVal = sqlite3DbMallocRaw(db, (pList->nExpr+1)*sizeof(i64));
+  if( aVal==0 ) return 0;
+  for(i=0; i<pList->nExpr; i++){
+    if( !exprIsInt64(pList->a[i].pExpr, &aVal[i+1]) ){
+      sqlite3DbFree(db, aVal);
+      return 0;
+    }
+  }
+  sortInt64(&aVal[1], pList->nExpr);
+  for(i=n=1; i<=pList->nExpr; i++){
+    if( n==1 || aVal[i]!=aVal[n-1] ) aVal[n++] = aVal[i];
+  }
+  aVal[0] = n-1;
+  return aVal;
+}
+
 /*
 ** Generate code for an IN expression.
 **
@@ -1852,20 +1964,33 @@ static void sqlite3ExprCodeIN(
   int eType;            /* Type of the RHS */
   int r1;               /* Temporary use register */
   Vdbe *v;              /* Statement under construction */
+  i64 *aiList = 0;      /* Sorted RHS values, if all are integer constants */
+
+  /* Figure out the affinity to use to create a key from the results
+  ** of the expression. affinityStr stores a static string suitable for
+  ** P4 of OP_MakeRecord.
+  */
+  affinity = comparisonAffinity(pExpr);
 
   /* Compute the RHS.   After this step, the table with cursor
   ** pExpr->iTable will contains the values that make up the RHS.
+  **
+  ** If the RHS is a list of integer constants, it is instead stored in
+  ** the statement as a sorted array and probed with a binary search by
+  ** OP_NotInIntList.  This is not done for TEXT affinity, which would
+  ** turn the integers into strings.
   */
   v = pParse->pVdbe;
   assert( v!=0 );       /* OOM detected prior to this routine */
   VdbeNoopComment((v, "begin IN expr"));
-  eType = sqlite3FindInIndex(pParse, pExpr, &rRhsHasNull);
-
-  /* Figure out the affinity to use to create a key from the results
-  ** of the expression. affinityStr stores a static string suitable for
-  ** P4 of OP_MakeRecord.
-  */
-  affinity = comparisonAffinity(pExpr);
+  if( affinity!=SQLITE_AFF_TEXT ){
+    aiList = exprIntegerList(pParse, pExpr);
+  }
+  if( aiList ){
+    eType = 0;
+  }else{
+    eType = sqlite3FindInIndex(pParse, pExpr, &rRhsHasNull);
+  }
 
   /* Code the LHS, the <expr> from "<expr> IN (...)".
   */
@@ -1876,9 +2001,9 @@ static void sqlite3ExprCodeIN(
   /* If the LHS is NULL, then the result is either false or NULL depending
   ** on whether the RHS is empty or not, respectively.
   */
-  if( destIfNull==destIfFalse ){
+  if( destIfNull==destIfFalse || aiList ){
     /* Shortcut for the common case where the false and NULL outcomes are
-    ** the same. */
+    ** the same, or where the RHS is known not to be empty. */
     sqlite3VdbeAddOp2(v, OP_IsNull, r1, destIfNull);
   }else{
     int addr1 = sqlite3VdbeAddOp1(v, OP_NotNull, r1);
@@ -1887,7 +2012,14 @@ static void sqlite3ExprCodeIN(
     sqlite3VdbeJumpHere(v, addr1);
   }
 
-  if( eType==IN_INDEX_ROWID ){
+  if( aiList ){
+    /* In this case, the RHS is an array of integers that cannot contain
+    ** a NULL.
+    */
+    sqlite3VdbeAddOp4(v, OP_Affinity, r1, 1, 0, &affinity, 1);
+    sqlite3VdbeAddOp4(v, OP_NotInIntList, r1, destIfFalse, 0,
+                      (char*)aiList, P4_INT64ARRAY);
+  }else if( eType==IN_INDEX_ROWID ){
     /* In this case, the RHS is the ROWID of table b-tree
     */
     sqlite3VdbeAddOp2(v, OP_MustBeInt, r1, destIfFalse);
@@ -2035,17 +2167,50 @@ static void cacheEntryClear(Parse *pParse, struct yColCache *p){
     }
     p->tempReg = 0;
   }
+  if( p->pExpr ){
+    sqlite3ExprDelete(pParse->db, p->pExpr);
+    p->pExpr = 0;
+  }
 }
 
+/*
+** Return the column cache slot to use for a new entry.  This is an
+** empty slot if there is one and otherwise the least recently used
+** entry, which is discarded.  All fields of the slot other than iTable,
+** iColumn, iReg and pExpr are initialized.
+*/
+static struct yColCache *cacheEntryAlloc(Parse *pParse){
+  int i;
+  int minLru = 0x7fffffff;
+  int idxLru = 0;
+  struct yColCache *p;
+
+  for(i=0, p=pParse->aColCache; i<SQLITE_N_COLCACHE; i++, p++){
+    if( p->iReg==0 ){
+      idxLru = i;
+      break;
+    }
+    if( p->lru<minLru ){
+      idxLru = i;
+      minLru = p->lru;
+    }
+  }
+  p = &pParse->aColCache[idxLru];
+  if( p->pExpr ){
+    sqlite3ExprDelete(pParse->db, p->pExpr);
+    p->pExpr = 0;
+  }
+  p->iLevel = pParse->iCacheLevel;
+  p->tempReg = 0;
+  p->lru = pParse->iCacheCnt++;
+  return p;
+}
 
 /*
 ** Record in the column cache that a particular column from a
 ** particular table is stored in a particular register.
 */
 void sqlite3ExprCacheStore(Parse *pParse, int iTab, int iCol, int iReg){
-  int i;
-  int minLru;
-  int idxLru;
   struct yColCache *p;
 
   assert( iReg>0 );  /* Register numbers are always positive */
@@ -2063,43 +2228,90 @@ void sqlite3ExprCacheStore(Parse *pParse, int iTab, int iCol, int iReg){
   ** that the object will never already be in cache.  Verify this guarantee.
   */
 #ifndef NDEBUG
-  for(i=0, p=pParse->aColCache; i<SQLITE_N_COLCACHE; i++, p++){
-    assert( p->iReg==0 || p->iTable!=iTab || p->iColumn!=iCol );
+  {
+    int i;
+    for(i=0, p=pParse->aColCache; i<SQLITE_N_COLCACHE; i++, p++){
+      assert( p->iReg==0 || p->pExpr || p->iTable!=iTab || p->iColumn!=iCol );
+    }
   }
 #endif
 
-  /* Find an empty slot and replace it */
-  for(i=0, p=pParse->aColCache; i<SQLITE_N_COLCACHE; i++, p++){
-    if( p->iReg==0 ){
-      p->iLevel = pParse->iCacheLevel;
-      p->iTable = iTab;
-      p->iColumn = iCol;
-      p->iReg = iReg;
-      p->tempReg = 0;
-      p->lru = pParse->iCacheCnt++;
-      return;
-    }
-  }
+  p = cacheEntryAlloc(pParse);
+  p->iTable = iTab;
+  p->iColumn = iCol;
+  p->iReg = iReg;
+}
 
-  /* Replace the last recently used */
-  minLru = 0x7fffffff;
-  idxLru = -1;
-  for(i=0, p=pParse->aColCache; i<SQLITE_N_COLCACHE; i++, p++){
-    if( p->lru<minLru ){
-      idxLru = i;
-      minLru = p->lru;
-    }
+/*
+** Walker callback for exprIsCacheable().  Clear Walker.u.i and abort if
+** pExpr might give a different value on two evaluations against the same
+** row.  Set Walker.u.i to 2 when a table column is seen.
+*/
+static int exprNodeIsCacheable(Walker *pWalker, Expr *pExpr){
+  if( ExprHasAnyProperty(pExpr, EP_TokenOnly|EP_Reduced) ){
+    pWalker->u.i = 0;
+    return WRC_Abort;
   }
-  if( ALWAYS(idxLru>=0) ){
-    p = &pParse->aColCache[idxLru];
-    p->iLevel = pParse->iCacheLevel;
-    p->iTable = iTab;
-    p->iColumn = iCol;
-    p->iReg = iReg;
-    p->tempReg = 0;
-    p->lru = pParse->iCacheCnt++;
-    return;
+  switch( pExpr->op ){
+    case TK_FUNCTION:
+      if( exprFuncIsConstant(pExpr, EP2_Constant) ){
+        return WRC_Continue;
+      }
+      break;
+    case TK_COLUMN:
+      if( pExpr->iTable>=0 && pExpr->pTab && !IsVirtual(pExpr->pTab) ){
+        pWalker->u.i = 2;
+        return WRC_Continue;
+      }
+      break;
+    case TK_ID:
+    case TK_AGG_FUNCTION:
+    case TK_AGG_COLUMN:
+    case TK_REGISTER:
+    case TK_TRIGGER:
+    case TK_RAISE:
+      break;
+    default:
+      return WRC_Continue;
   }
+  pWalker->u.i = 0;
+  return WRC_Abort;
+}
+
+/*
+** Return true if the value of pExpr, once computed, may be reused for
+** as long as the column cache would reuse the columns it reads.  That is
+** the case if pExpr reads at least one table column and otherwise uses
+** only constants and SQLITE_FUNC_CONSTANT functions.  Expressions that
+** read no columns at all are left to constant factoring.
+*/
+static int exprIsCacheable(Parse *pParse, Expr *pExpr){
+  Walker w;
+  w.u.i = 1;
+  w.pParse = pParse;
+  w.xExprCallback = exprNodeIsCacheable;
+  w.xSelectCallback = selectNodeIsConstant;
+  sqlite3WalkExpr(&w, pExpr);
+  return w.u.i==2;
+}
+
+/*
+** Record in the column cache that the value of function call pExpr
+** for the current row is stored in register iReg.
+*/
+static void exprCacheStore(Parse *pParse, Expr *pExpr, int iReg){
+  struct yColCache *p;
+  Expr *pDup;
+
+  assert( iReg>0 );
+  if( pParse->db->flags & SQLITE_ColumnCache ) return;
+  pDup = sqlite3ExprDup(pParse->db, pExpr, 0);
+  if( pDup==0 ) return;
+  p = cacheEntryAlloc(pParse);
+  p->iTable = -1;
+  p->iColumn = -1;
+  p->pExpr = pDup;
+  p->iReg = iReg;
 }
 
 /*
@@ -2163,6 +2375,24 @@ static void sqlite3ExprCachePinRegister(Parse *pParse, int iReg){
   }
 }
 
+/*
+** If the value of function call pExpr for the current row is in the
+** column cache, return the register that holds it.  Otherwise return 0.
+*/
+static int exprCacheLookup(Parse *pParse, Expr *pExpr){
+  int i;
+  struct yColCache *p;
+
+  for(i=0, p=pParse->aColCache; i<SQLITE_N_COLCACHE; i++, p++){
+    if( p->iReg>0 && p->pExpr && sqlite3ExprCompare(p->pExpr, pExpr)==0 ){
+      p->lru = pParse->iCacheCnt++;
+      sqlite3ExprCachePinRegister(pParse, p->iReg);
+      return p->iReg;
+    }
+  }
+  return 0;
+}
+
 /*
 ** Generate code to extract the value of the iCol-th column of a table.
 */
@@ -2184,6 +2414,63 @@ void sqlite3ExprCodeGetColumnOfTable(
   }
 }
 
+/*
+** Walker callback for sqlite3ExprCodeLoadIndexColumn().  Point every
+** TK_COLUMN node that refers to the row of a CHECK-style expression
+** (iTable<0) at the cursor in pWalker->u.i.
+*/
+static int exprNodeSetCursor(Walker *pWalker, Expr *pExpr){
+  if( pExpr->op==TK_COLUMN && pExpr->iTable<0 ){
+    pExpr->iTable = pWalker->u.i;
+  }
+  return WRC_Continue;
+}
+
+/*
+** Generate code to load the value of the iIdxCol-th column of index pIdx
+** into register regOut.  Ordinary columns are read from the table row
+** that cursor iTabCur points to.  An expression column (XN_EXPR) is
+** computed from that same row.  If iTabCur is negative, an expression
+** column is instead computed from the registers of a row under
+** construction starting at pParse->ckBase, as for a CHECK constraint.
+*/
+void sqlite3ExprCodeLoadIndexColumn(
+  Parse *pParse,  /* The parsing context */
+  Index *pIdx,    /* The index whose column is to be loaded */
+  int iTabCur,    /* Cursor pointing to a table row, or -1 */
+  int iIdxCol,    /* The column of the index to be loaded */
+  int regOut      /* Store the index column value in this register */
+){
+  int iTabCol = pIdx->aiColumn[iIdxCol];
+  if( iTabCol==XN_EXPR ){
+    Expr *pExpr;
+    assert( pIdx->aColExpr && pIdx->aColExpr->nExpr>iIdxCol );
+    pExpr = pIdx->aColExpr->a[iIdxCol].pExpr;
+    sqlite3ExprCachePush(pParse);
+    if( iTabCur<0 ){
+      assert( pParse->ckBase>0 );
+      sqlite3ExprCode(pParse, pExpr, regOut);
+    }else{
+      /* The expression in the schema is shared, so work on a copy */
+      pExpr = sqlite3ExprDup(pParse->db, pExpr, 0);
+      if( pExpr ){
+        Walker w;
+        memset(&w, 0, sizeof(w));
+        w.xExprCallback = exprNodeSetCursor;
+        w.u.i = iTabCur;
+        sqlite3WalkExpr(&w, pExpr);
+        sqlite3ExprCode(pParse, pExpr, regOut);
+        sqlite3ExprDelete(pParse->db, pExpr);
+      }
+    }
+    sqlite3ExprCachePop(pParse, 1);
+  }else{
+    assert( iTabCur>=0 );
+    sqlite3ExprCodeGetColumnOfTable(pParse->pVdbe, pIdx->pTable, iTabCur,
+                                    iTabCol, regOut);
+  }
+}
+
 /*
 ** Generate code that will extract the iColumn-th column from
 ** table pTab and store the column value in a register.  An effort
@@ -2206,7 +2493,7 @@ int sqlite3ExprCodeGetColumn(
   struct yColCache *p;
 
   for(i=0, p=pParse->aColCache; i<SQLITE_N_COLCACHE; i++, p++){
-    if( p->iReg>0 && p->iTable==iTable && p->iColumn==iColumn ){
+    if( p->iReg>0 && p->pExpr==0 && p->iTable==iTable && p->iColumn==iColumn ){
       p->lru = pParse->iCacheCnt++;
       sqlite3ExprCachePinRegister(pParse, p->iReg);
       return p->iReg;
@@ -2293,6 +2580,26 @@ static int usedAsColumnCache(Parse *pParse, int iFrom, int iTo){
 }
 #endif /* SQLITE_DEBUG || SQLITE_COVERAGE_TEST */
 
+/*
+** If pExpr is an expression column of an index that an enclosing WHERE
+** loop is scanning, generate an OP_Column that reads its value from the
+** index cursor into register target and return target.  Return 0 if
+** pExpr is not on the Parse.pIdxExpr list.
+*/
+static int exprCodeIndexedExpr(Parse *pParse, Expr *pExpr, int target){
+  IndexedExpr *p;
+  if( ExprHasAnyProperty(pExpr, EP_TokenOnly|EP_Reduced) ) return 0;
+  for(p=pParse->pIdxExpr; p; p=p->pIENext){
+    if( sqlite3ExprCompareIndexExpr(pExpr, p->pExpr, p->iDataCur) ){
+      sqlite3VdbeAddOp3(pParse->pVdbe, OP_Column, p->iIdxCur, p->iIdxCol,
+                        target);
+      VdbeComment((pParse->pVdbe, "indexed expression"));
+      return target;
+    }
+  }
+  return 0;
+}
+
 /*
 ** Generate code into the current Vdbe to evaluate the given
 ** expression.  Attempt to store the results in register "target".
@@ -2324,6 +2631,11 @@ int sqlite3ExprCodeTarget(Parse *pParse, Expr *pExpr, int target){
   }else{
     op = pExpr->op;
   }
+  if( pParse->pIdxExpr && op!=TK_COLUMN && op!=TK_NULL ){
+    inReg = exprCodeIndexedExpr(pParse, pExpr, target);
+    if( inReg ) return inReg;
+    inReg = target;
+  }
   switch( op ){
     case TK_AGG_COLUMN: {
       AggInfo *pAggInfo = pExpr->pAggInfo;
@@ -2583,6 +2895,7 @@ int sqlite3ExprCodeTarget(Parse *pParse, Expr *pExpr, int target){
       int i;                 /* Loop counter */
       u8 enc = ENC(db);      /* The text encoding used by this database */
       CollSeq *pColl = 0;    /* A collating sequence */
+      int bCache = 0;        /* True to record the result in the cache */
 
       assert( !ExprHasProperty(pExpr, EP_xIsSelect) );
       testcase( op==TK_CONST_FUNC );
@@ -2621,6 +2934,20 @@ int sqlite3ExprCodeTarget(Parse *pParse, Expr *pExpr, int target){
         break;
       }
 
+      /* A function that always gives the same result for the same arguments
+      ** need only be called once per row.  If this call has already been
+      ** made for the current row, reuse the register that holds its result.
+      */
+      if( op==TK_FUNCTION && (pDef->flags & SQLITE_FUNC_CONSTANT)!=0
+       && exprIsCacheable(pParse, pExpr)
+      ){
+        int iCached = exprCacheLookup(pParse, pExpr);
+        if( iCached ){
+          inReg = iCached;
+          break;
+        }
+        bCache = 1;
+      }
 
       if( pFarg ){
         r1 = sqlite3GetTempRange(pParse, nFarg);
@@ -2638,8 +2965,9 @@ int sqlite3ExprCodeTarget(Parse *pParse, Expr *pExpr, int target){
           if( exprOp==TK_COLUMN || exprOp==TK_AGG_COLUMN ){
             assert( SQLITE_FUNC_LENGTH==OPFLAG_LENGTHARG );
             assert( SQLITE_FUNC_TYPEOF==OPFLAG_TYPEOFARG );
-            testcase( pDef->flags==SQLITE_FUNC_LENGTH );
-            pFarg->a[0].pExpr->op2 = pDef->flags;
+            testcase( (pDef->flags & SQLITE_FUNC_LENGTH)!=0 );
+            pFarg->a[0].pExpr->op2 =
+                (u8)(pDef->flags & (SQLITE_FUNC_LENGTH|SQLITE_FUNC_TYPEOF));
           }
         }
 
@@ -2686,6 +3014,9 @@ int sqlite3ExprCodeTarget(Parse *pParse, Expr *pExpr, int target){
       if( nFarg ){
         sqlite3ReleaseTempRange(pParse, r1, nFarg);
       }
+      if( bCache && (pDef->flags & SQLITE_FUNC_CONSTANT)!=0 ){
+        exprCacheStore(pParse, pExpr, target);
+      }
       break;
     }
 #ifndef SQLITE_OMIT_SUBQUERY
@@ -3277,8 +3608,8 @@ void sqlite3ExplainExprList(Vdbe *pOut, ExprList *pList){
 ** later.  We might as well just use the original instruction and
 ** avoid the OP_SCopy.
 */
-static int isAppropriateForFactoring(Expr *p){
-  if( !sqlite3ExprIsConstantNotJoin(p) ){
+static int isAppropriateForFactoring(Parse *pParse, Expr *p){
+  if( !exprIsConst(pParse, p, 4) ){
     return 0;  /* Only constant expressions are appropriate for factoring */
   }
   if( (p->flags & EP_FixedDest)==0 ){
@@ -3319,11 +3650,57 @@ static int isAppropriateForFactoring(Expr *p){
   return 1;
 }
 
+/*
+** Arrange for the constant expression pExpr to be evaluated once by the
+** init code that sqlite3FinishCoding() places after the OP_Halt, and
+** return the register that will hold its value.  Return 0 if pExpr cannot
+** be copied or if a malloc fails.
+**
+** Each constant gets a register of its own, even if an identical constant
+** has been seen before, since some consumers (OP_MustBeInt and OP_Affinity
+** in where.c, for example) modify the register they are given in place.
+*/
+static int codeConstantAtInit(Parse *pParse, Expr *pExpr){
+  sqlite3 *db = pParse->db;
+  struct ParseConst *p;
+
+  if( ExprHasAnyProperty(pExpr, EP_TokenOnly|EP_Reduced) ) return 0;
+  p = sqlite3DbRealloc(db, pParse->aConstExpr,
+                       sizeof(pParse->aConstExpr[0])*(pParse->nConstExpr+1));
+  if( p==0 ) return 0;
+  pParse->aConstExpr = p;
+  p = &p[pParse->nConstExpr];
+  p->pExpr = sqlite3ExprDup(db, pExpr, 0);
+  if( p->pExpr==0 ) return 0;
+  p->iReg = ++pParse->nMem;
+  pParse->nConstExpr++;
+  return p->iReg;
+}
+
+/*
+** Generate code for the constants registered by codeConstantAtInit().
+** This is called by sqlite3FinishCoding() while it is generating the
+** code that runs once before the body of the statement.
+*/
+void sqlite3ExprCodeInitConstants(Parse *pParse){
+  int i;
+  struct ParseConst *p;
+  sqlite3ExprCacheClear(pParse);
+  for(i=0, p=pParse->aConstExpr; i<pParse->nConstExpr; i++, p++){
+    sqlite3ExprCode(pParse, p->pExpr, p->iReg);
+  }
+}
+
 /*
 ** If pExpr is a constant expression that is appropriate for
 ** factoring out of a loop, then evaluate the expression
 ** into a register and convert the expression into a TK_REGISTER
 ** expression.
+**
+** Once the jump to the cookie-check code has been coded, the value is
+** computed by the init code at the end of the program instead of in-line,
+** so that constants are still factored out of statements (UPDATE, DELETE,
+** later subqueries) whose loops are coded after that point.
 */
 static int evalConstExpr(Walker *pWalker, Expr *pExpr){
   Parse *pParse = pWalker->pParse;
@@ -3351,11 +3728,16 @@ static int evalConstExpr(Walker *pWalker, Expr *pExpr){
       break;
     }
   }
-  if( isAppropriateForFactoring(pExpr) ){
-    int r1 = ++pParse->nMem;
+  if( isAppropriateForFactoring(pParse, pExpr) ){
     int r2;
-    r2 = sqlite3ExprCodeTarget(pParse, pExpr, r1);
-    if( NEVER(r1!=r2) ) sqlite3ReleaseTempReg(pParse, r1);
+    if( pParse->cookieGoto ){
+      r2 = codeConstantAtInit(pParse, pExpr);
+      if( r2==0 ) return WRC_Continue;
+    }else{
+      int r1 = ++pParse->nMem;
+      r2 = sqlite3ExprCodeTarget(pParse, pExpr, r1);
+      if( NEVER(r1!=r2) ) sqlite3ReleaseTempReg(pParse, r1);
+    }
     pExpr->op2 = pExpr->op;
     pExpr->op = TK_REGISTER;
     pExpr->iTable = r2;
@@ -3369,10 +3751,11 @@ static int evalConstExpr(Walker *pWalker, Expr *pExpr){
 ** results in registers.  Modify pExpr so that the constant subexpresions
 ** are TK_REGISTER opcodes that refer to the precomputed values.
 **
-** This routine is a no-op if the jump to the cookie-check code has
-** already occur.  Since the cookie-check jump is generated prior to
-** any other serious processing, this check ensures that there is no
-** way to accidently bypass the constant initializations.
+** If the jump to the cookie-check code has already been coded, the
+** constants are evaluated by the init code that follows it instead (see
+** evalConstExpr()).  Since the cookie-check jump is generated prior to
+** any other serious processing, either way there is no way to
+** accidently bypass the constant initializations.
 **
 ** This routine is also a no-op if the SQLITE_FactorOutConst optimization
 ** is disabled via the sqlite3_test_control(SQLITE_TESTCTRL_OPTIMIZATIONS)
@@ -3382,7 +3765,6 @@ static int evalConstExpr(Walker *pWalker, Expr *pExpr){
 */
 void sqlite3ExprCodeConstants(Parse *pParse, Expr *pExpr){
   Walker w;
-  if( pParse->cookieGoto ) return;
   if( (pParse->db->flags & SQLITE_FactorOutConst)!=0 ) return;
   w.xExprCallback = evalConstExpr;
   w.xSelectCallback = 0;
@@ -3390,6 +3772,29 @@ void sqlite3ExprCodeConstants(Parse *pParse, Expr *pExpr){
   sqlite3WalkExpr(&w, pExpr);
 }
 
+/*
+** Preevaluate the constant subexpressions of every term of pList, as
+** sqlite3ExprCodeConstants() does for a single expression.  A term that
+** is itself a single-instruction constant is left in-line, since it can
+** be coded directly into its destination register.  EP_FixedDest is set
+** on each term only for the duration of the walk, so that later coding
+** of the same tree is not affected.
+*/
+void sqlite3ExprListCodeConstants(Parse *pParse, ExprList *pList){
+  int i;
+  struct ExprList_item *pItem;
+  if( pList==0 ) return;
+  for(i=pList->nExpr, pItem=pList->a; i>0; i--, pItem++){
+    Expr *pExpr = pItem->pExpr;
+    if( ALWAYS(pExpr) ){
+      u16 fixedDest = pExpr->flags & EP_FixedDest;
+      pExpr->flags |= EP_FixedDest;
+      sqlite3ExprCodeConstants(pParse, pExpr);
+      pExpr->flags = (pExpr->flags & ~EP_FixedDest) | fixedDest;
+    }
+  }
+}
+
 
 /*
 ** Generate code that pushes the value of every element of the given
@@ -3761,8 +4166,13 @@ void sqlite3ExprIfFalse(Parse *pParse, Expr *pExpr, int dest, int jumpIfNull){
 ** this routine is used, it does not hurt to get an extra 2 - that
 ** just might result in some slightly slower code.  But returning
 ** an incorrect 0 or 1 could lead to a malfunction.
+**
+** If iTab is non-negative, a TK_COLUMN in pB with an iTable of -1 (as in
+** a CHECK constraint or an index expression) matches the same column of
+** pA when pA reads it from cursor iTab.
 */
-int sqlite3ExprCompare(Expr *pA, Expr *pB){
+static int exprListCompareTab(ExprList*, ExprList*, int);
+static int exprCompareTab(Expr *pA, Expr *pB, int iTab){
   if( pA==0||pB==0 ){
     return pB==pA ? 0 : 2;
   }
@@ -3773,10 +4183,15 @@ int sqlite3ExprCompare(Expr *pA, Expr *pB){
   }
   if( (pA->flags & EP_Distinct)!=(pB->flags & EP_Distinct) ) return 2;
   if( pA->op!=pB->op ) return 2;
-  if( sqlite3ExprCompare(pA->pLeft, pB->pLeft) ) return 2;
-  if( sqlite3ExprCompare(pA->pRight, pB->pRight) ) return 2;
-  if( sqlite3ExprListCompare(pA->x.pList, pB->x.pList) ) return 2;
-  if( pA->iTable!=pB->iTable || pA->iColumn!=pB->iColumn ) return 2;
+  if( exprCompareTab(pA->pLeft, pB->pLeft, iTab) ) return 2;
+  if( exprCompareTab(pA->pRight, pB->pRight, iTab) ) return 2;
+  if( exprListCompareTab(pA->x.pList, pB->x.pList, iTab) ) return 2;
+  if( pA->iColumn!=pB->iColumn ) return 2;
+  if( pA->op==TK_COLUMN && iTab>=0 && pB->iTable<0 ){
+    if( pA->iTable!=iTab ) return 2;
+  }else if( pA->iTable!=pB->iTable ){
+    return 2;
+  }
   if( ExprHasProperty(pA, EP_IntValue) ){
     if( !ExprHasProperty(pB, EP_IntValue) || pA->u.iValue!=pB->u.iValue ){
       return 2;
@@ -3791,6 +4206,19 @@ int sqlite3ExprCompare(Expr *pA, Expr *pB){
   if( (pA->flags & EP_ExpCollate)!=0 && pA->pColl!=pB->pColl ) return 2;
   return 0;
 }
+int sqlite3ExprCompare(Expr *pA, Expr *pB){
+  return exprCompareTab(pA, pB, -1);
+}
+
+/*
+** Return true if expression pExpr, which reads table columns through
+** cursor iTab, computes the same value as the index expression pIdxExpr.
+** A difference only in a top-level COLLATE is ignored here, since the
+** caller checks the collating sequence against Index.azColl[] itself.
+*/
+int sqlite3ExprCompareIndexExpr(Expr *pExpr, Expr *pIdxExpr, int iTab){
+  return exprCompareTab(pExpr, pIdxExpr, iTab)<2;
+}
 
 /*
 ** Compare two ExprList objects.  Return 0 if they are identical and 
@@ -3804,7 +4232,7 @@ int sqlite3ExprCompare(Expr *pA, Expr *pB){
 ** Two NULL pointers are considered to be the same.  But a NULL pointer
 ** always differs from a non-NULL pointer.
 */
-int sqlite3ExprListCompare(ExprList *pA, ExprList *pB){
+static int exprListCompareTab(ExprList *pA, ExprList *pB, int iTab){
   int i;
   if( pA==0 && pB==0 ) return 0;
   if( pA==0 || pB==0 ) return 1;
@@ -3813,10 +4241,13 @@ int sqlite3ExprListCompare(ExprList *pA, ExprList *pB){
     Expr *pExprA = pA->a[i].pExpr;
     Expr *pExprB = pB->a[i].pExpr;
     if( pA->a[i].sortOrder!=pB->a[i].sortOrder ) return 1;
-    if( sqlite3ExprCompare(pExprA, pExprB) ) return 1;
+    if( exprCompareTab(pExprA, pExprB, iTab) ) return 1;
   }
   return 0;
 }
+int sqlite3ExprListCompare(ExprList *pA, ExprList *pB){
+  return exprListCompareTab(pA, pB, -1);
+}
 
 /*
 ** An instance of the following structure is used by the tree walker
@@ -250,6 +250,9 @@ static int locateFkeyIndex(
           char *zDfltColl;                  /* Def. collation for column */
           char *zIdxCol;                    /* Name of indexed column */
 
+          /* An index on an expression never matches a parent key */
+          if( iCol==XN_EXPR ) break;
+
           /* If the index uses a collation sequence that is different from
           ** the default collation sequence for the column, this index is
           ** unusable. Bail out early in this case.  */
@@ -115,11 +115,7 @@ static void lengthFunc(
     case SQLITE_TEXT: {					//文本
       const unsigned char *z = sqlite3_value_text(argv[0]);
       if( z==0 ) return;				//长度为0，返回0
-      len = 0;
-      while( *z ){
-        len++;
-        SQLITE_SKIP_UTF8(z);
-      }
+      len = sqlite3Utf8CharLen((const char*)z, sqlite3_value_bytes(argv[0]));
       sqlite3_result_int(context, len);	//返回长度
       break;
     }
@@ -203,6 +199,7 @@ static void substrFunc(
   const unsigned char *z;
   const unsigned char *z2;
   int len;
+  int nByte = 0;
   int p0type;
   i64 p1, p2;
   int negP2 = 0;
@@ -223,11 +220,10 @@ static void substrFunc(
   }else{//若z是文本			
     z = sqlite3_value_text(argv[0]);
     if( z==0 ) return;
+    nByte = sqlite3_value_bytes(argv[0]);
     len = 0;
     if( p1<0 ){	//若p1为负
-      for(z2=z; *z2; len++){
-        SQLITE_SKIP_UTF8(z2);														
-      }
+      len = sqlite3Utf8CharLen((const char*)z, nByte);
     }
   }
   if( argc==3 ){
@@ -260,13 +256,9 @@ static void substrFunc(
   }
   assert( p1>=0 && p2>=0 );
   if( p0type!=SQLITE_BLOB ){
-    while( *z && p1 ){
-      SQLITE_SKIP_UTF8(z);
-      p1--;
-    }
-    for(z2=z; *z2 && p2; p2--){
-      SQLITE_SKIP_UTF8(z2);
-    }
+    const unsigned char *zTerm = &z[nByte];
+    z = sqlite3Utf8Skip(z, nByte, p1);
+    z2 = sqlite3Utf8Skip(z, (int)(zTerm - z), p2);
     sqlite3_result_text(context, (char*)z, (int)(z2-z), SQLITE_TRANSIENT);
   }else{
     if( p1+p2>len ){
@@ -355,7 +347,7 @@ static void *contextMalloc(sqlite3_context *context, i64 nByte){//该函数分
 static void upperFunc(sqlite3_context *context, int argc, sqlite3_value **argv){//返回将小写字符数据转换为大写的字符表达式。
   char *z1;
   const char *z2;
-  int i, n;
+  int n;
   UNUSED_PARAMETER(argc);
   z2 = (char*)sqlite3_value_text(argv[0]);
   n = sqlite3_value_bytes(argv[0]);
@@ -365,9 +357,7 @@ static void upperFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   if( z2 ){
     z1 = contextMalloc(context, ((i64)n)+1);
     if( z1 ){
-      for(i=0; i<n; i++){
-        z1[i] = (char)sqlite3Toupper(z2[i]);//将小写字母转化为大写字母
-      }
+      sqlite3Utf8ChangeCase((u8*)z1, (const u8*)z2, n, 1);//将小写字母转化为大写字母
       sqlite3_result_text(context, z1, n, sqlite3_free);
     }
   }
@@ -375,7 +365,7 @@ static void upperFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
 static void lowerFunc(sqlite3_context *context, int argc, sqlite3_value **argv){ //将大写字符数据转换为小写字符数据后返回字符表达式。
   char *z1;
   const char *z2;
-  int i, n;
+  int n;
   UNUSED_PARAMETER(argc);
   z2 = (char*)sqlite3_value_text(argv[0]);
   n = sqlite3_value_bytes(argv[0]);
@@ -385,9 +375,7 @@ static void lowerFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   if( z2 ){
     z1 = contextMalloc(context, ((i64)n)+1);
     if( z1 ){
-      for(i=0; i<n; i++){
-        z1[i] = sqlite3Tolower(z2[i]);	//将大写字母转化为大写字母
-      }
+      sqlite3Utf8ChangeCase((u8*)z1, (const u8*)z2, n, 0);	//将大写字母转化为大写字母
       sqlite3_result_text(context, z1, n, sqlite3_free);
     }
   }
@@ -725,6 +713,149 @@ static int patternCompare(
   return *zString==0;
 }
 
+/*
+** A LIKE or GLOB pattern is analyzed once per statement and the result
+** is saved as auxiliary data on the pattern argument.  Many patterns seen
+** in practice consist of a single run of literal text with an optional
+** matchAll wildcard at either end.  Those are matched by scanning the
+** string directly (using memchr() and memcmp(), which the C library
+** usually implements with vector instructions) rather than by
+** interpreting the pattern one character at a time in patternCompare().
+**
+** The literal text is restricted to ASCII.  An ASCII byte in a UTF-8
+** string always decodes as itself in sqlite3Utf8Read() and is never
+** part of a multi-byte character, so a byte-wise search gives the same
+** answer as patternCompare().  Anything else uses patternCompare().
+*/
+#define LIKE_SHAPE_GENERIC   0   /* Use patternCompare() */
+#define LIKE_SHAPE_EXACT     1   /* 'abc' */
+#define LIKE_SHAPE_PREFIX    2   /* 'abc%' */
+#define LIKE_SHAPE_SUFFIX    3   /* '%abc' */
+#define LIKE_SHAPE_CONTAINS  4   /* '%abc%'.  Also '%' with nLit==0 */
+
+typedef struct LikeMatcher LikeMatcher;
+struct LikeMatcher {
+  u8 eShape;               /* One of the LIKE_SHAPE_* values */
+  u8 noCase;               /* True to ignore the case of ASCII letters */
+  u32 esc;                 /* Escape character the pattern was compiled for */
+  int nLit;                /* Number of bytes in zLit[] */
+  char zLit[1];            /* Literal text. Folded to lower case if noCase */
+};
+
+/*
+** Analyze pattern zPattern and return a new LikeMatcher object that
+** describes it, or NULL if a malloc fails.
+*/
+static LikeMatcher *likeCompile(
+  const u8 *zPattern,              /* The LIKE or GLOB pattern */
+  const struct compareInfo *pInfo, /* Information about how to do the compare */
+  u32 esc                          /* The escape character */
+){
+  int nPattern = sqlite3Strlen30((const char*)zPattern);
+  const u8 *z = zPattern;
+  int bLead = 0;                   /* True if pattern starts with matchAll */
+  int bTrail = 0;                  /* True if pattern ends with matchAll */
+  LikeMatcher *p;
+
+  p = sqlite3_malloc( sizeof(LikeMatcher) + nPattern );
+  if( p==0 ) return 0;
+  p->eShape = LIKE_SHAPE_GENERIC;
+  p->noCase = pInfo->noCase;
+  p->esc = esc;
+  p->nLit = 0;
+  p->zLit[0] = 0;
+#ifndef SQLITE_EBCDIC
+  if( esc>=0x80 ) return p;
+  while( *z==pInfo->matchAll ){ z++; bLead = 1; }
+  while( *z ){
+    u8 c = *z;
+    if( c==pInfo->matchAll ){
+      while( *z==pInfo->matchAll ){ z++; }
+      if( *z ) return p;
+      bTrail = 1;
+      break;
+    }
+    if( c==pInfo->matchOne || c==pInfo->matchSet || c>=0x80 ) return p;
+    if( esc && c==esc ){
+      c = *(++z);
+      if( c==0 || c>=0x80 ) return p;
+    }
+    if( p->noCase ) c = sqlite3UpperToLower[c];
+    p->zLit[p->nLit++] = (char)c;
+    z++;
+  }
+  p->zLit[p->nLit] = 0;
+  if( bLead ){
+    p->eShape = (bTrail || p->nLit==0) ? LIKE_SHAPE_CONTAINS : LIKE_SHAPE_SUFFIX;
+  }else{
+    p->eShape = bTrail ? LIKE_SHAPE_PREFIX : LIKE_SHAPE_EXACT;
+  }
+#else
+  UNUSED_PARAMETER2(z, bLead);
+  UNUSED_PARAMETER(bTrail);
+#endif
+  return p;
+}
+
+/*
+** Return true if the n bytes at z match the literal text of p,
+** ignoring the case of ASCII letters if p->noCase is set.
+*/
+static int likeLiteralEq(const LikeMatcher *p, const u8 *z){
+  int i;
+  if( !p->noCase ) return memcmp(z, p->zLit, p->nLit)==0;
+  for(i=0; i<p->nLit; i++){
+    if( sqlite3UpperToLower[z[i]]!=(u8)p->zLit[i] ) return 0;
+  }
+  return 1;
+}
+
+/*
+** Return true if the literal text of p occurs anywhere within the
+** first n bytes of z.
+*/
+static int likeContains(const LikeMatcher *p, const u8 *z, int n){
+  const u8 *zEnd;                  /* Last position where a match may start */
+  u8 c1, c2;
+  if( p->nLit==0 ) return 1;
+  if( n<p->nLit ) return 0;
+  zEnd = &z[n - p->nLit];
+  c1 = (u8)p->zLit[0];
+  c2 = p->noCase ? (u8)sqlite3Toupper(c1) : c1;
+  while( z<=zEnd ){
+    if( c1==c2 ){
+      z = memchr(z, c1, zEnd - z + 1);
+      if( z==0 ) return 0;
+    }else{
+      while( *z!=c1 && *z!=c2 ){
+        if( ++z>zEnd ) return 0;
+      }
+    }
+    if( likeLiteralEq(p, z) ) return 1;
+    z++;
+  }
+  return 0;
+}
+
+/*
+** Match the nul-terminated string zString against the pattern
+** described by p.  The caller has already ruled out LIKE_SHAPE_GENERIC.
+*/
+static int likeMatch(const LikeMatcher *p, const u8 *zString){
+  int n = sqlite3Strlen30((const char*)zString);
+  switch( p->eShape ){
+    case LIKE_SHAPE_EXACT:
+      return n==p->nLit && likeLiteralEq(p, zString);
+    case LIKE_SHAPE_PREFIX:
+      return n>=p->nLit && likeLiteralEq(p, zString);
+    case LIKE_SHAPE_SUFFIX:
+      return n>=p->nLit && likeLiteralEq(p, &zString[n - p->nLit]);
+    default:
+      assert( p->eShape==LIKE_SHAPE_CONTAINS );
+      return likeContains(p, zString, n);
+  }
+}
+
 /*
 ** Count the number of times that the LIKE operator (or GLOB which is
 ** just a variation of LIKE) gets called.  This is used for testing
@@ -796,11 +927,31 @@ static void likeFunc(//确定给定的字符串是否与指定的模式匹配。
   }
   if( zA && zB ){
     struct compareInfo *pInfo = sqlite3_user_data(context);
+    LikeMatcher *pMatcher = 0;
+    int bNew = 0;
 #ifdef SQLITE_TEST
     sqlite3_like_count++;//LIKE 操作符的次数加1
 #endif
-    
-    sqlite3_result_int(context, patternCompare(zB, zA, pInfo, escape));
+
+    /* A matcher is only worth compiling when the pattern is a constant,
+    ** since it is then reused for every row.  The compiled matcher stays
+    ** attached to argv[0].  The escape character need not be a constant,
+    ** so check that it has not changed. */
+    if( sqlite3VdbeArgIsConstant(context, 0) ){
+      pMatcher = (LikeMatcher*)sqlite3_get_auxdata(context, 0);
+      if( pMatcher==0 || pMatcher->esc!=escape ){
+        pMatcher = likeCompile(zB, pInfo, escape);
+        bNew = 1;
+      }
+    }
+    if( pMatcher && pMatcher->eShape!=LIKE_SHAPE_GENERIC ){
+      sqlite3_result_int(context, likeMatch(pMatcher, zA));
+    }else{
+      sqlite3_result_int(context, patternCompare(zB, zA, pInfo, escape));
+    }
+    if( bNew && pMatcher ){
+      sqlite3_set_auxdata(context, 0, pMatcher, sqlite3_free);
+    }
   }
 }
 
@@ -1689,7 +1840,7 @@ void sqlite3RegisterGlobalFunctions(void){
     FUNCTION2(length,            1, 0, 0, lengthFunc,  SQLITE_FUNC_LENGTH),
     FUNCTION(substr,             2, 0, 0, substrFunc       ),
     FUNCTION(substr,             3, 0, 0, substrFunc       ),
-    FUNCTION(abs,                1, 0, 0, absFunc          ),
+    EFUNCTION(abs,               1, 0, 0, absFunc          ),
 #ifndef SQLITE_OMIT_FLOATING_POINT
     FUNCTION(round,              1, 0, 0, roundFunc        ),
     FUNCTION(round,              2, 0, 0, roundFunc        ),
@@ -1699,30 +1850,30 @@ void sqlite3RegisterGlobalFunctions(void){
     FUNCTION(coalesce,           1, 0, 0, 0                ),
     FUNCTION(coalesce,           0, 0, 0, 0                ),
     FUNCTION2(coalesce,         -1, 0, 0, ifnullFunc,  SQLITE_FUNC_COALESCE),
-    FUNCTION(hex,                1, 0, 0, hexFunc          ),
+    EFUNCTION(hex,               1, 0, 0, hexFunc          ),
     FUNCTION2(ifnull,            2, 0, 0, ifnullFunc,  SQLITE_FUNC_COALESCE),
-    FUNCTION(random,             0, 0, 0, randomFunc       ),
-    FUNCTION(randomblob,         1, 0, 0, randomBlob       ),
+    VFUNCTION(random,            0, 0, 0, randomFunc       ),
+    VFUNCTION(randomblob,        1, 0, 0, randomBlob       ),
     FUNCTION(nullif,             2, 0, 1, nullifFunc       ),
     FUNCTION(sqlite_version,     0, 0, 0, versionFunc      ),
     FUNCTION(sqlite_source_id,   0, 0, 0, sourceidFunc     ),
-    FUNCTION(sqlite_log,         2, 0, 0, errlogFunc       ),
+    VFUNCTION(sqlite_log,        2, 0, 0, errlogFunc       ),
 #ifndef SQLITE_OMIT_COMPILEOPTION_DIAGS
     FUNCTION(sqlite_compileoption_used,1, 0, 0, compileoptionusedFunc  ),
     FUNCTION(sqlite_compileoption_get, 1, 0, 0, compileoptiongetFunc  ),
 #endif /* SQLITE_OMIT_COMPILEOPTION_DIAGS */
-    FUNCTION(quote,              1, 0, 0, quoteFunc        ),
-    FUNCTION(last_insert_rowid,  0, 0, 0, last_insert_rowid),
-    FUNCTION(changes,            0, 0, 0, changes          ),
-    FUNCTION(total_changes,      0, 0, 0, total_changes    ),
-    FUNCTION(replace,            3, 0, 0, replaceFunc      ),
-    FUNCTION(zeroblob,           1, 0, 0, zeroblobFunc     ),
+    EFUNCTION(quote,             1, 0, 0, quoteFunc        ),
+    VFUNCTION(last_insert_rowid, 0, 0, 0, last_insert_rowid),
+    VFUNCTION(changes,           0, 0, 0, changes          ),
+    VFUNCTION(total_changes,     0, 0, 0, total_changes    ),
+    EFUNCTION(replace,           3, 0, 0, replaceFunc      ),
+    EFUNCTION(zeroblob,          1, 0, 0, zeroblobFunc     ),
   #ifdef SQLITE_SOUNDEX
     FUNCTION(soundex,            1, 0, 0, soundexFunc      ),
   #endif
   #ifndef SQLITE_OMIT_LOAD_EXTENSION
-    FUNCTION(load_extension,     1, 0, 0, loadExt          ),
-    FUNCTION(load_extension,     2, 0, 0, loadExt          ),
+    VFUNCTION(load_extension,    1, 0, 0, loadExt          ),
+    VFUNCTION(load_extension,    2, 0, 0, loadExt          ),
   #endif
     AGGREGATE(sum,               1, 0, 0, sumStep,         sumFinalize    ),
     AGGREGATE(total,             1, 0, 0, sumStep,         totalFinalize    ),
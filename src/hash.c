@@ -33,6 +33,7 @@ void sqlite3HashInit(Hash *pNew){/*hash_table initliaze *///Elaine debug
   pNew->first = 0;/*initialize the pointer of pNew *///Elaine debug
   pNew->count = 0;
   pNew->htsize = 0;
+  pNew->nDeleted = 0;
   pNew->ht = 0;
 }
 
@@ -54,6 +55,7 @@ void sqlite3HashClear(Hash *pH){
   sqlite3_free(pH->ht);/*释放HASH函数的ht*/
   pH->ht = 0;//使哈希表的ht为0
   pH->htsize = 0;/*htsize is unsigned int,*///Elaine debug
+  pH->nDeleted = 0;
   while( elem ){//判断elem是否还存在，如果存在继续做释放的动作
     HashElem *next_elem = elem->next;
     sqlite3_free(elem);//释放elem
@@ -63,56 +65,121 @@ void sqlite3HashClear(Hash *pH){
 }
 
 /*
-** The hashing function.
+** The hashing function.  This is FNV-1a over the keys folded to lower
+** case, followed by a final mix so that both the low bits (which select
+** the group) and the high bits (which make the tag) depend on every
+** byte of the key.
 */
 /*散列函数*/
-static unsigned int strHash(const char *z, int nKey){
-  int h = 0;
+unsigned int sqlite3StrIHash(const char *z, int nKey){
+  unsigned int h = 2166136261u;
   assert( nKey>=0 );//如果nKey不大于0，则程序终止，如果大于0，则程序继续执行.
   while( nKey > 0  ){//循环nKey的值，当等于0时，跳出循环.
-    h = (h<<3) ^ h ^ sqlite3UpperToLower[(unsigned char)*z++];
+    h = (h ^ sqlite3UpperToLower[(unsigned char)*z++]) * 16777619u;
     nKey--;//nKEY=nKey-1
   }
+  h ^= h>>16;
+  h *= 0x85ebca6bu;
+  h ^= h>>13;
   return h;//返回h的数值
 }
 
+/*
+** Slot tags.  An occupied slot is tagged with hashTag() of the hash of
+** its key, which always has the 0x80 bit set.
+*/
+#define HASH_EMPTY    0
+#define HASH_DELETED  1
+#define hashTag(h)    ((u8)(0x80|((h)>>25)))
+
+/*
+** Return a non-zero value if any of the HASH_GROUP tags of group pG
+** equal T.  All of the tags are compared at once, as the bytes of a
+** single 64-bit word.  The result may be a false positive for some
+** tags that follow a match, which does not matter as the caller checks
+** each tag that might match.
+*/
+#define HASH_ONES  ((((u64)0x01010101)<<32)|0x01010101)
+#define HASH_HIGHS ((((u64)0x80808080)<<32)|0x80808080)
+static u64 hashGroupHas(const struct _ht *pG, u8 T){
+  u64 w;
+  memcpy(&w, pG->aTag, sizeof(w));
+  w ^= HASH_ONES*T;
+  return (w - HASH_ONES) & ~w & HASH_HIGHS;
+}
+
+/*
+** Add element pNew to the index Hash.ht.  The key of pNew must not
+** already be in the index.
+*/
+static void hashIndexInsert(Hash *pH, HashElem *pNew){
+  unsigned int mask = pH->htsize-1;
+  unsigned int iGroup = pNew->h & mask;
+  assert( pH->ht!=0 );
+  for(;;){
+    struct _ht *pG = &pH->ht[iGroup];
+    int i;
+    for(i=0; i<HASH_GROUP; i++){
+      if( pG->aTag[i]<=HASH_DELETED ){
+        if( pG->aTag[i]==HASH_DELETED ) pH->nDeleted--;
+        pG->aTag[i] = hashTag(pNew->h);
+        pG->apElem[i] = pNew;
+        return;
+      }
+    }
+    iGroup = (iGroup+1) & mask;
+  }
+}
+
+/*
+** Remove element elem from the index Hash.ht.  Its slot becomes empty
+** if no probe sequence passes through its group, or deleted otherwise.
+*/
+static void hashIndexRemove(Hash *pH, HashElem *elem){
+  unsigned int mask = pH->htsize-1;
+  unsigned int iGroup = elem->h & mask;
+  assert( pH->ht!=0 );
+  for(;;){
+    struct _ht *pG = &pH->ht[iGroup];
+    int i;
+    for(i=0; i<HASH_GROUP; i++){
+      if( pG->apElem[i]==elem && pG->aTag[i]>HASH_DELETED ){
+        if( hashGroupHas(pG, HASH_EMPTY) ){
+          pG->aTag[i] = HASH_EMPTY;
+        }else{
+          pG->aTag[i] = HASH_DELETED;
+          pH->nDeleted++;
+        }
+        return;
+      }
+    }
+    assert( !hashGroupHas(pG, HASH_EMPTY) );
+    iGroup = (iGroup+1) & mask;
+  }
+}
 
-/* Link pNew element into the hash table pH.  If pEntry!=0 then also
-** insert pNew into the pEntry hash bucket.
+/* Link pNew element into the hash table pH.
 */
 
 /*
- 把pNew连接到哈希表pH上，如果pEntry不等于0 则插入语pNew到结构体
+ 把pNew连接到哈希表pH上
 */
 static void insertElement(
   Hash *pH,              /* The complete hash table *///完整的哈希表
-  struct _ht *pEntry,    /* The entry into which pNew is inserted */
   HashElem *pNew         /* The element to be inserted *///被插入的元素
 ){
-  HashElem *pHead;       /* First element already in pEntry */
-  if( pEntry ){/*determine the pEntry is empty,*///Elaine debug
-    pHead = pEntry->count ? pEntry->chain : 0;/*如果pEntry不空，则为pEntry结构赋值*/
-    pEntry->count++;
-    pEntry->chain = pNew;
-  }else{
-    pHead = 0;//如果pEntry为0，则pHead为0
-  }
-  if( pHead ){//判断pHead的值
-    pNew->next = pHead;//pNew的next指向pHead
-    pNew->prev = pHead->prev;//pNew的prev指向pHead的prev
-    if( pHead->prev ){ pHead->prev->next = pNew; }//pHead的prev的next指向pNew
-    else             { pH->first = pNew; }
-    pHead->prev = pNew;
-  }else{
-    pNew->next = pH->first;//如果pHead为0，则pNew的下一个指向pH的first
-    if( pH->first ){ pH->first->prev = pNew; }//pH的first的prev指向pNew  
-    pNew->prev = 0;
-    pH->first = pNew;
+  pNew->next = pH->first;
+  if( pH->first ){ pH->first->prev = pNew; }
+  pNew->prev = 0;
+  pH->first = pNew;
+  if( pH->ht ){
+    hashIndexInsert(pH, pNew);
   }
 }
 
 
-/* Resize the hash table so that it cantains "new_size" buckets.
+/* Resize the hash table so that it cantains "new_size" groups of
+** slots.  new_size must be a power of two.
 **
 ** The hash table might fail to resize if sqlite3_malloc() fails or
 ** if the new size is the same as the prior size.
@@ -126,43 +193,28 @@ static void insertElement(
 */
 static int rehash(Hash *pH, unsigned int new_size){
   struct _ht *new_ht;            /* The new hash table */
-  HashElem *elem, *next_elem;    /* For looping over existing elements */
+  HashElem *elem;                /* For looping over existing elements */
 
-#if SQLITE_MALLOC_SOFT_LIMIT>0 //如果定义的SQLITE_MALLOC_SOFT_LIMIT大于0，则执行下面的if语句，否则不执行
-  if( new_size*sizeof(struct _ht)>SQLITE_MALLOC_SOFT_LIMIT ){
-    new_size = SQLITE_MALLOC_SOFT_LIMIT/sizeof(struct _ht);
-  }
-  if( new_size==pH->htsize ) return 0;
-#endif
+  assert( new_size>0 && (new_size & (new_size-1))==0 );
+  assert( pH->count<new_size*HASH_GROUP );
 
   /* The inability to allocates space for a larger hash table is
   ** a performance hit but it is not a fatal error.  So mark the
-  ** allocation as a benign. Use sqlite3Malloc()/memset(0) instead of 
-  ** sqlite3MallocZero() to make the allocation, as sqlite3MallocZero()
-  ** only zeroes the requested number of bytes whereas this module will
-  ** use the actual amount of space allocated for the hash table (which
-  ** may be larger than the requested amount).
+  ** allocation as a benign.  SQLITE_MALLOC_SOFT_LIMIT is not applied
+  ** here, as an open-addressing table cannot hold more entries than it
+  ** has slots.
   */
-  
-   /*
-  无法分配一个较大的哈希表空间是一个性能损失，但这不是一个致命的错误。所以标记分配作为一种有利的。
-  使用sqlite3Malloc()/memset(0)而不是sqlite3malloczero()进行分配，sqlite3malloczero()是零请
-  求的字节数，这个模块将实际使用量的空间分配哈希表（可大于所要求的数量）。   
-  */
-  
   sqlite3BeginBenignMalloc();//在src/fault中有这个函数的函数体，必须与sqlite3EndBenignMalloc()配合使用
-  new_ht = (struct _ht *)sqlite3Malloc( new_size*sizeof(struct _ht) );//申请新的大小
+  new_ht = (struct _ht *)sqlite3MallocZero( new_size*sizeof(struct _ht) );
   sqlite3EndBenignMalloc();
 
   if( new_ht==0 ) return 0;
   sqlite3_free(pH->ht);
   pH->ht = new_ht;
-  pH->htsize = new_size = sqlite3MallocSize(new_ht)/sizeof(struct _ht);/*htsize的大小等于申请空间大小/ht结构体所占字节大小*/
-  memset(new_ht, 0, new_size*sizeof(struct _ht));/*将新开辟空间new_ht设置为0*/
-  for(elem=pH->first, pH->first=0; elem; elem = next_elem){
-    unsigned int h = strHash(elem->pKey, elem->nKey) % new_size;
-    next_elem = elem->next;
-    insertElement(pH, &new_ht[h], elem);/*把elem连接到PH的哈希表的后面*/
+  pH->htsize = new_size;
+  pH->nDeleted = 0;
+  for(elem=pH->first; elem; elem=elem->next){
+    hashIndexInsert(pH, elem);
   }
   return 1;
 }
@@ -182,38 +234,53 @@ static HashElem *findElementGivenHash(
   unsigned int h      /* The hash for this key. */
 ){
   HashElem *elem;                /* Used to loop thru the element list */
-  int count;                     /* Number of elements left to test */
 
   if( pH->ht ){
-    struct _ht *pEntry = &pH->ht[h];
-    elem = pEntry->chain;
-    count = pEntry->count;
-  }else{
-    elem = pH->first;
-    count = pH->count;
+    unsigned int mask = pH->htsize-1;
+    unsigned int iGroup = h & mask;
+    u8 tag = hashTag(h);
+    unsigned int nProbe;
+    /* Visit each group at most once, in case no group has an empty slot */
+    for(nProbe=0; nProbe<pH->htsize; nProbe++){
+      const struct _ht *pG = &pH->ht[iGroup];
+      if( hashGroupHas(pG, tag) ){
+        int i;
+        for(i=0; i<HASH_GROUP; i++){
+          if( pG->aTag[i]!=tag ) continue;
+          elem = pG->apElem[i];
+          if( elem->h==h && elem->nKey==nKey
+           && sqlite3StrNICmp(elem->pKey,pKey,nKey)==0
+          ){
+            return elem;
+          }
+        }
+      }
+      if( hashGroupHas(pG, HASH_EMPTY) ) return 0;
+      iGroup = (iGroup+1) & mask;
+    }
+    return 0;
   }
-  while( count-- && ALWAYS(elem) ){
-    if( elem->nKey==nKey && sqlite3StrNICmp(elem->pKey,pKey,nKey)==0 ){ 
+  for(elem=pH->first; elem; elem=elem->next){
+    if( elem->h==h && elem->nKey==nKey
+     && sqlite3StrNICmp(elem->pKey,pKey,nKey)==0
+    ){
       return elem;
     }
-    elem = elem->next;
   }
   return 0;
 }
 
 /* Remove a single entry from the hash table given a pointer to that
-** element and a hash on the element's key.
+** element.
 */
 
 /*按照给定的指针和哈希表的元素值删除一个条目*/
-static void removeElementGivenHash(
+static void removeElement(
   Hash *pH,         /* The pH containing "elem" */
-  HashElem* elem,   /* The element to be removed from the pH */
-  unsigned int h    /* Hash value for the element */
+  HashElem* elem    /* The element to be removed from the pH */
 ){
-  struct _ht *pEntry;
   if( elem->prev ){
-    elem->prev->next = elem->next; 
+    elem->prev->next = elem->next;
   }else{
     pH->first = elem->next;
   }
@@ -221,17 +288,12 @@ static void removeElementGivenHash(
     elem->next->prev = elem->prev;
   }
   if( pH->ht ){
-    pEntry = &pH->ht[h];
-    if( pEntry->chain==elem ){
-      pEntry->chain = elem->next;
-    }
-    pEntry->count--;
-    assert( pEntry->count>=0 );
+    hashIndexRemove(pH, elem);
   }
   sqlite3_free( elem );
   pH->count--;
   if( pH->count<=0 ){
-    assert( pH->first==0 );/*pH->first为真，继续执行，否则推出执行*/ 
+    assert( pH->first==0 );/*pH->first为真，继续执行，否则推出执行*/
     assert( pH->count==0 );/*pH->count为真，继续执行，否则推出执行*/
     sqlite3HashClear(pH);/*清空PH哈希表中的值*/
   }
@@ -249,17 +311,12 @@ static void removeElementGivenHash(
 
 void *sqlite3HashFind(const Hash *pH, const char *pKey, int nKey){
   HashElem *elem;    /* The element that matches key *//*匹配的元素*/
-  unsigned int h;    /* A hash on key */
 
   assert( pH!=0 );/*pH!=0为真，继续执行，否则推出执行*/
   assert( pKey!=0 );/*pKey!=0为真，继续执行，否则推出执行*/
   assert( nKey>=0 );/*nKey!=0为真，继续执行，否则推出执行*/
-  if( pH->ht ){
-    h = strHash(pKey, nKey) % pH->htsize;
-  }else{
-    h = 0;
-  }
-  elem = findElementGivenHash(pH, pKey, nKey, h);
+  if( pH->count==0 ) return 0;
+  elem = findElementGivenHash(pH, pKey, nKey, sqlite3StrIHash(pKey, nKey));
   return elem ? elem->data : 0;
 }
 
@@ -288,23 +345,19 @@ void *sqlite3HashFind(const Hash *pH, const char *pKey, int nKey){
 */
 
 void *sqlite3HashInsert(Hash *pH, const char *pKey, int nKey, void *data){
-  unsigned int h;       /* the hash of the key modulo hash table size */
+  unsigned int h;       /* the hash of the key */
   HashElem *elem;       /* Used to loop thru the element list */
   HashElem *new_elem;   /* New element added to the pH */
 
-  assert( pH!=0 );/*pH!=0为真，继续执行，否则推出执行*/ 
-  assert( pKey!=0 );/*pKey!=0为真，继续执行，否则推出执行*/ 
-  assert( nKey>=0 );/*nKey!=0为真，继续执行，否则推出执行*/ 
-  if( pH->htsize ){
-    h = strHash(pKey, nKey) % pH->htsize;/*如果pH的htsize成员变量不为0,即使用哈希表存放数据项那么使用 strHash 函数计算桶号h*/
-  }else{
-    h = 0;/*如果pH的htsize成员变量为0,那么h=0*/
-  }
+  assert( pH!=0 );/*pH!=0为真，继续执行，否则推出执行*/
+  assert( pKey!=0 );/*pKey!=0为真，继续执行，否则推出执行*/
+  assert( nKey>=0 );/*nKey!=0为真，继续执行，否则推出执行*/
+  h = sqlite3StrIHash(pKey, nKey);
   elem = findElementGivenHash(pH,pKey,nKey,h);
   if( elem ){
     void *old_data = elem->data;
     if( data==0 ){
-      removeElementGivenHash(pH,elem,h);
+      removeElement(pH,elem);
     }else{
       elem->data = data;
       elem->pKey = pKey;
@@ -318,17 +371,29 @@ void *sqlite3HashInsert(Hash *pH, const char *pKey, int nKey, void *data){
   new_elem->pKey = pKey;
   new_elem->nKey = nKey;
   new_elem->data = data;
+  new_elem->h = h;
   pH->count++;
-  if( pH->count>=10 && pH->count > 2*pH->htsize ){
-    if( rehash(pH, pH->count*2) ){
-      assert( pH->htsize>0 );
-      h = strHash(pKey, nKey) % pH->htsize;
+
+  /* Keep the index at most 7/8 full, counting deleted slots, so that
+  ** every probe sequence reaches an empty slot.  This is checked for as
+  ** long as the index exists, even once the table has shrunk below the
+  ** size at which the index is first built, as deletes leave deleted
+  ** slots behind.  Rebuilding the index, at the same size if need be,
+  ** clears them.  If it cannot be rebuilt, drop it and fall back to a
+  ** linear search of the list.
+  */
+  if( (pH->count>=10 || pH->ht!=0)
+   && (pH->count+pH->nDeleted)*8 > pH->htsize*HASH_GROUP*7
+  ){
+    unsigned int new_size = 1;
+    while( new_size*HASH_GROUP < pH->count*2 ) new_size *= 2;
+    if( !rehash(pH, new_size) && pH->count+pH->nDeleted>=pH->htsize*HASH_GROUP ){
+      sqlite3_free(pH->ht);
+      pH->ht = 0;
+      pH->htsize = 0;
+      pH->nDeleted = 0;
     }
   }
-  if( pH->ht ){
-    insertElement(pH, &pH->ht[h], new_elem);
-  }else{
-    insertElement(pH, 0, new_elem);
-  }
+  insertElement(pH, new_elem);
   return 0;
 }
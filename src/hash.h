@@ -37,9 +37,15 @@ typedef struct HashElem HashElem;
 ** All elements of the hash table are on a single doubly-linked list.
 ** Hash.first points to the head of this list.
 **
-** There are Hash.htsize buckets.  Each bucket points to a spot in
-** the global doubly-linked list.  The contents of the bucket are the
-** element pointed to plus the next _ht.count-1 elements in the list.
+** Hash.ht is an open-addressing index over the elements, made of
+** Hash.htsize groups of HASH_GROUP slots, where Hash.htsize is a power
+** of two.  Each slot has a one-byte tag: 0 if the slot is empty, 1 if
+** its element was deleted, or else 0x80 plus the top 7 bits of the hash
+** of the element's key.  A lookup starts at the group selected by the
+** low bits of the hash and compares all the tags of a group at once,
+** moving on to the next group only if the group is full.  Keys are
+** only compared for slots whose tag matches, and the full hash is kept
+** in HashElem.h so that most false tag matches cost no string compare.
 **
 ** Hash.htsize and Hash.ht may be zero.  In that case lookup is done
 ** by a linear search of the global list.  For small tables, the 
@@ -63,13 +69,15 @@ hash.htsize和hash.ht可能是零。在这种情况下查找由全局线性搜
 如果表中有几个元素为0，表的的hash.ht就不会分配。线性搜索比管理表的速度要快
 
 */
+#define HASH_GROUP 8
 struct Hash {
-  unsigned int htsize;      /* Number of buckets in the hash table *///无符号短整型，当使用哈希表存储时，哈希表中桶的数量
+  unsigned int htsize;      /* Number of slot groups in the hash table *///无符号短整型，当使用哈希表存储时，哈希表中桶的数量
   unsigned int count;       /* Number of entries in this table *///无符号短整型，哈希表中入口项的个数(记录的个数)
+  unsigned int nDeleted;    /* Number of slots with a deleted tag */
   HashElem *first;          /* The first element of the array *///HashElem 类型，哈希元素指针，指向入口项双向链表的表头
   struct _ht {              /* the hash table */
-    int count;                 /* Number of entries with this hash *//*其中 count成员变量记录本桶中记录的数量*/
-    HashElem *chain;           /* Pointer to first entry with this hash *//* chain指向桶内记录链表的表头，哈希表使用的冲突消解策略是链表*/
+    unsigned char aTag[HASH_GROUP];  /* Tag of each slot */
+    HashElem *apElem[HASH_GROUP];    /* Element in each slot */
   } *ht; /*_ht 结构指针,哈希表存储结构，当使用哈希表存储时，将表现为一个桶的数组,含有两个成员变量*/
 };
 
@@ -89,6 +97,7 @@ struct HashElem {
   HashElem *next, *prev;       /* Next and previous elements in the table *//*指向哈希表的下一个和前一个元素*/
   void *data;                  /* Data associated with this element *//*和元素相关的数据*/
   const char *pKey; int nKey;  /* Key associated with this element *//*元素的键值和长度*/
+  unsigned int h;              /* sqlite3StrIHash() of the key */
 };
 
 /*
@@ -99,6 +108,7 @@ void *sqlite3HashInsert(Hash*, const char *pKey, int nKey, void *pData);/*向哈
 void *sqlite3HashFind(const Hash*, const char *pKey, int nKey);/*查找哈希表中的元素*/
 void sqlite3HashClear(Hash*);/*将哈希表中所有的入口项删除，就是将 ht 的内存释放，将 first 
 链表中所有的元素释放；将各个成员变量置 0 */
+unsigned int sqlite3StrIHash(const char *z, int nKey);
 
 /*
 ** Macros for looping over all elements of a hash table.  The idiom is
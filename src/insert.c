@@ -65,7 +65,9 @@ const char *sqlite3IndexAffinityStr(Vdbe *v, Index *pIdx)
     }
     for(n=0; n < pIdx->nColumn; n++)
     {
-      pIdx->zColAff[n] = pTab->aCol[pIdx->aiColumn[n]].affinity;
+      int iCol = pIdx->aiColumn[n];
+      /* 表达式列的值保持其计算结果的类型 */
+      pIdx->zColAff[n] = iCol==XN_EXPR ? SQLITE_AFF_NONE : pTab->aCol[iCol].affinity;
     }
     pIdx->zColAff[n++] = SQLITE_AFF_INTEGER;
     pIdx->zColAff[n] = 0;
@@ -293,6 +295,78 @@ void sqlite3AutoincrementEnd(Parse *pParse)
 #endif
 
 
+/*
+** Return true if pExpr is a literal that sqlite3ValueRecordsFromExpr() can
+** encode: a number, string, blob or NULL, or a negated number.
+*/
+//判断表达式是否为可以直接求值的常量：数字、字符串、blob、NULL或负数
+static int isValuesLiteral(Expr *pExpr)
+{
+  if( pExpr->op==TK_UMINUS )
+  {
+    pExpr = pExpr->pLeft;
+    return pExpr->op==TK_INTEGER || pExpr->op==TK_FLOAT;
+  }
+  return pExpr->op==TK_INTEGER || pExpr->op==TK_FLOAT
+      || pExpr->op==TK_STRING || pExpr->op==TK_BLOB || pExpr->op==TK_NULL;
+}
+
+/*
+** pSelect is the source of rows for an INSERT.  If it is the compound
+** SELECT that the parser builds for a multi-row VALUES clause, and every
+** value in it is a literal, return a blob holding one record for each
+** row, for use as the P4 operand of OP_ValuesRow.  Otherwise, or if a
+** malloc fails, return NULL.  NULL is also returned if the compound has
+** more terms than SQLITE_LIMIT_COMPOUND_SELECT allows, so that
+** sqlite3Select() reports the error as it would for any other compound.
+**
+** This lets the rows be loaded by a single loop whose size does not
+** depend on the number of rows, instead of the code generated by
+** sqlite3Select() for each term of the compound.
+*/
+//若pSelect是多行VALUES子句且所有值都是常量，则把所有行编码为一个记录blob
+static sqlite3_value *valuesToRecords(Parse *pParse, Select *pSelect)
+{
+  sqlite3 *db = pParse->db;
+  ExprList **apRow;         //每一行的表达式列表，按行的顺序
+  sqlite3_value *pRows = 0; //返回值
+  Select *p;
+  int nRow = 0;
+  int nCol;
+  int i;
+
+  if( pSelect->pPrior==0 || pSelect->pEList==0 ) return 0;
+  nCol = pSelect->pEList->nExpr;
+  for(p=pSelect; p; p=p->pPrior)
+  {
+    if( (p->selFlags & SF_Values)==0 || (p->pPrior && p->op!=TK_ALL)
+     || p->pEList==0 || p->pEList->nExpr!=nCol )
+    {
+      return 0;
+    }
+    for(i=0; i<nCol; i++)
+    {
+      if( !isValuesLiteral(p->pEList->a[i].pExpr) ) return 0;
+    }
+    nRow++;
+  }
+  //项数超过SQLITE_LIMIT_COMPOUND_SELECT时交给sqlite3Select()报错
+  if( db->aLimit[SQLITE_LIMIT_COMPOUND_SELECT]
+   && nRow>db->aLimit[SQLITE_LIMIT_COMPOUND_SELECT] )
+  {
+    return 0;
+  }
+  apRow = sqlite3DbMallocRaw(db, nRow*sizeof(apRow[0]));
+  if( apRow==0 ) return 0;
+  for(p=pSelect, i=nRow; p; p=p->pPrior)
+  {
+    apRow[--i] = p->pEList;
+  }
+  sqlite3ValueRecordsFromExpr(db, apRow, nRow, ENC(db), &pRows);
+  sqlite3DbFree(db, apRow);
+  return pRows;
+}
+
 // 9、xferOptimization（）函数的前置声明
 //传入参数依次为：解析器环境，要插入的表，SELECT语句数据源，处理约束的错误，Pdest数据库
 static int xferOptimization(Parse *pParse, Table *pDest, Select *pSelect, int onError, int iDbDest );
@@ -511,6 +585,7 @@ void sqlite3Insert(Parse *pParse, SrcList *pTabList, ExprList *pList, Select *pS
     //在协同程序的每一次调用中，它把查询结果单独的一行放入到registers dest.iMem...dest.iMem+dest.nMem-1中
     //（sqlite3Select()分配寄存器）。当查询完成的时候，把EOF标志存储在refEof中。
     int rc, j1;
+    sqlite3_value *pRows; //多行常量VALUES子句的记录blob
 
     regEof = ++pParse->nMem;
     sqlite3VdbeAddOp2(v, OP_Integer, 0, regEof);      /* EOF <- 0 */
@@ -521,12 +596,37 @@ void sqlite3Insert(Parse *pParse, SrcList *pTabList, ExprList *pList, Select *pS
     j1 = sqlite3VdbeAddOp2(v, OP_Goto, 0, 0);
     VdbeComment((v, "Jump over SELECT coroutine"));
 
-    //解析在查询语句中的表达式然后执行它。
-    rc = sqlite3Select(pParse, pSelect, &dest);
-    assert( pParse->nErr==0 || rc );
-    if( rc || NEVER(pParse->nErr) || db->mallocFailed )
+    pRows = valuesToRecords(pParse, pSelect);
+    if( pRows )
     {
-      goto insert_cleanup;
+      //多行VALUES子句只包含常量：协同程序用一个循环从P4的记录blob中逐行取出数据。
+      /*         R <- 0
+      **      L: load row R into registers, or goto M
+      **         yield X
+      **         goto L
+      **      M: ...
+      */
+      int regRow = ++pParse->nMem;  //下一行在blob中的偏移量
+      int addrLoop;                 //标签“L”
+      dest.iSdst = pParse->nMem+1;
+      dest.nSdst = pSelect->pEList->nExpr;
+      pParse->nMem += dest.nSdst;
+      sqlite3VdbeAddOp2(v, OP_Integer, 0, regRow);
+      addrLoop = sqlite3VdbeAddOp4(v, OP_ValuesRow, regRow, 0, dest.iSdst,
+                                   (const char*)pRows, P4_MEM);
+      sqlite3VdbeAddOp1(v, OP_Yield, dest.iSDParm);
+      sqlite3VdbeAddOp2(v, OP_Goto, 0, addrLoop);
+      sqlite3VdbeJumpHere(v, addrLoop);
+    }
+    else
+    {
+      //解析在查询语句中的表达式然后执行它。
+      rc = sqlite3Select(pParse, pSelect, &dest);
+      assert( pParse->nErr==0 || rc );
+      if( rc || NEVER(pParse->nErr) || db->mallocFailed )
+      {
+        goto insert_cleanup;
+      }
     }
     sqlite3VdbeAddOp2(v, OP_Integer, 1, regEof);         /* EOF <- 1 */
     sqlite3VdbeAddOp1(v, OP_Yield, dest.iSDParm);   /* yield X */
@@ -1094,6 +1194,7 @@ void sqlite3GenerateConstraintChecks(
   Index *pIdx;         //指针的一个指示   
   sqlite3 *db;         //数据库连接
   int seenReplace = 0;//如果代替被使用解决INT主键冲突则设为真值
+  int affDone = 0;    //如果已经对数据寄存器应用了表的列关联则为真
   int regOldRowid = (rowidChng && isUpdate) ? rowidChng : regRowid;
 
   db = pParse->db;
@@ -1270,6 +1371,17 @@ void sqlite3GenerateConstraintChecks(
       int idx = pIdx->aiColumn[i];
       if( idx==pTab->iPKey ){
         sqlite3VdbeAddOp2(v, OP_SCopy, regRowid, regIdx+i);
+      }else if( idx==XN_EXPR ){
+        /* 表达式列必须看到与表中存储的值相同的值，因此先应用列关联，
+        ** 然后像CHECK约束一样从数据寄存器计算表达式 */
+        if( !affDone ){
+          sqlite3VdbeAddOp2(v, OP_Affinity, regData, pTab->nCol);
+          sqlite3TableAffinityStr(v, pTab);
+          sqlite3ExprCacheAffinityChange(pParse, regData, pTab->nCol);
+          affDone = 1;
+        }
+        pParse->ckBase = regData;
+        sqlite3ExprCodeLoadIndexColumn(pParse, pIdx, -1, i, regIdx+i);
       }else{
         sqlite3VdbeAddOp2(v, OP_SCopy, regData+idx, regIdx+i);
       }
@@ -1319,7 +1431,8 @@ void sqlite3GenerateConstraintChecks(
         errMsg.db = db;
         zSep = pIdx->nColumn>1 ? "columns " : "column ";
         for(j=0; j<pIdx->nColumn; j++){
-          char *zCol = pTab->aCol[pIdx->aiColumn[j]].zName;
+          int iCol = pIdx->aiColumn[j];
+          const char *zCol = iCol==XN_EXPR ? "<expr>" : pTab->aCol[iCol].zName;
           sqlite3StrAccumAppend(&errMsg, zSep, -1);  //构造错误信息
           zSep = ", ";
           sqlite3StrAccumAppend(&errMsg, zCol, -1);
@@ -1508,6 +1621,11 @@ static int xferCompatibleIndex(Index *pDest, Index *pSrc){
     if( pSrc->aiColumn[i]!=pDest->aiColumn[i] ){
       return 0;   //不同的列索引
     }
+    if( pSrc->aiColumn[i]==XN_EXPR
+     && sqlite3ExprCompare(pSrc->aColExpr->a[i].pExpr,
+                           pDest->aColExpr->a[i].pExpr)!=0 ){
+      return 0;   //不同的索引表达式
+    }
     if( pSrc->aSortOrder[i]!=pDest->aSortOrder[i] ){
       return 0;   //不同的排序
     }
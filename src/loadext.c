@@ -384,6 +384,8 @@ static const sqlite3_api_routines sqlite3Apis = {
   sqlite3_blob_reopen,
   sqlite3_vtab_config,
   sqlite3_vtab_on_conflict,
+  sqlite3_step_batch,
+  sqlite3_execute_batch,
 };
 
 /*
@@ -518,6 +518,14 @@ int sqlite3_config(int op, ...){
     }
 #endif
 
+#ifdef SQLITE_ENABLE_MEMSYS6
+    case SQLITE_CONFIG_MALLOC_CACHED: {
+      /* Install the size-class allocator from mem6.c */
+      sqlite3GlobalConfig.m = *sqlite3MemGetMemsys6();
+      break;
+    }
+#endif
+
     case SQLITE_CONFIG_LOOKASIDE: {
       sqlite3GlobalConfig.szLookaside = va_arg(ap, int);
       sqlite3GlobalConfig.nLookaside = va_arg(ap, int);
@@ -565,10 +573,22 @@ int sqlite3_config(int op, ...){
 ** space for the lookaside memory is obtained from sqlite3_malloc().
 ** If pStart is not NULL then it is sz*cnt bytes of memory to use for
 ** the lookaside memory.
+**
+** The memory is cut into chunks of sz bytes, each holding one slot of
+** size sz or several slots of one of the smaller sizes in
+** aLookasideSize[].  A few bytes per chunk record its size, so a buffer
+** supplied by the caller holds slightly fewer than cnt chunks.  Memory
+** obtained from sqlite3_malloc() may later grow to SQLITE_LOOKASIDE_GROWTH
+** times its original size.
 */
 //设置一个后贝缓冲区为了数据的连接、成功了返回SQLITE_OK
+#ifndef SQLITE_LOOKASIDE_GROWTH
+# define SQLITE_LOOKASIDE_GROWTH 4
+#endif
+static const u16 aLookasideSize[] = { 64, 128, 512 };
 static int setupLookaside(sqlite3 *db, void *pBuf, int sz, int cnt){
   void *pStart;
+  int nByte = 0;
   if( db->lookaside.nOut ){
     return SQLITE_BUSY;
   }
@@ -593,30 +613,40 @@ static int setupLookaside(sqlite3 *db, void *pBuf, int sz, int cnt){
     pStart = 0;
   }else if( pBuf==0 ){
     sqlite3BeginBenignMalloc();
-    pStart = sqlite3Malloc( sz*cnt );  /* IMP: R-61949-35727 */
+    pStart = sqlite3Malloc( (sz+(int)sizeof(LookasideChunk))*cnt );  /* IMP: R-61949-35727 */
     sqlite3EndBenignMalloc();
-    if( pStart ) cnt = sqlite3MallocSize(pStart)/sz;
+    if( pStart ) nByte = sqlite3MallocSize(pStart);
   }else{
     pStart = pBuf;
+    nByte = sz*cnt;
   }
   db->lookaside.pStart = pStart;
-  db->lookaside.pFree = 0;
   db->lookaside.sz = (u16)sz;
   if( pStart ){
-    int i;
-    LookasideSlot *p;
+    i64 mxByte = (i64)nByte*SQLITE_LOOKASIDE_GROWTH;
+    int i, n = 0;
     assert( sz > (int)sizeof(LookasideSlot*) );
-    p = (LookasideSlot*)pStart;
-    for(i=cnt-1; i>=0; i--){
-      p->pNext = db->lookaside.pFree;
-      db->lookaside.pFree = p;
-      p = (LookasideSlot*)&((u8*)p)[sz];
+    for(i=0; i<ArraySize(aLookasideSize) && aLookasideSize[i]<sz; i++){
+      db->lookaside.aClass[n++].sz = aLookasideSize[i];
+    }
+    db->lookaside.aClass[n++].sz = (u16)sz;
+    for(i=0; i<n; i++) db->lookaside.aClass[i].nReq = 0;
+    db->lookaside.nClass = (u8)n;
+    db->lookaside.nByte = nByte;
+    if( pBuf || mxByte>0x7fff0000 ){
+      db->lookaside.mxByte = pBuf ? nByte : 0x7fff0000;
+    }else{
+      db->lookaside.mxByte = (int)mxByte;
     }
-    db->lookaside.pEnd = p;
+    sqlite3LookasideInit(db);
     db->lookaside.bEnabled = 1;
     db->lookaside.bMalloced = pBuf==0 ?1:0;
   }else{
     db->lookaside.pEnd = 0;
+    db->lookaside.nClass = 0;
+    db->lookaside.nByte = 0;
+    db->lookaside.nChunk = 0;
+    db->lookaside.bGrow = 0;
     db->lookaside.bEnabled = 0;
     db->lookaside.bMalloced = 0;
   }
@@ -1312,8 +1342,11 @@ int sqlite3CreateFunc(													  /*一个SQlite内部函数*/
 ){
   FuncDef *p;
   int nName;
+  int extraFlags;
 
   assert( sqlite3_mutex_held(db->mutex) );
+  extraFlags = enc & SQLITE_DETERMINISTIC;
+  enc &= ~SQLITE_DETERMINISTIC;
   if( zFunctionName==0 ||
       (xFunc && (xFinal || xStep)) || 
       (!xFunc && (xFinal && !xStep)) ||
@@ -1335,11 +1368,12 @@ int sqlite3CreateFunc(													  /*一个SQlite内部函数*/
     enc = SQLITE_UTF16NATIVE;
   }else if( enc==SQLITE_ANY ){											  /*如果编码格式为SQLITE_ANY*/
     int rc;
-    rc = sqlite3CreateFunc(db, zFunctionName, nArg, SQLITE_UTF8,
+    rc = sqlite3CreateFunc(db, zFunctionName, nArg, SQLITE_UTF8|extraFlags,
          pUserData, xFunc, xStep, xFinal, pDestructor);
     if( rc==SQLITE_OK ){
-      rc = sqlite3CreateFunc(db, zFunctionName, nArg, SQLITE_UTF16LE,
-          pUserData, xFunc, xStep, xFinal, pDestructor);
+      rc = sqlite3CreateFunc(db, zFunctionName, nArg,
+          SQLITE_UTF16LE|extraFlags, pUserData, xFunc, xStep, xFinal,
+          pDestructor);
     }
     if( rc!=SQLITE_OK ){
       return rc;
@@ -1381,7 +1415,7 @@ int sqlite3CreateFunc(													  /*一个SQlite内部函数*/
     pDestructor->nRef++;
   }
   p->pDestructor = pDestructor;
-  p->flags = 0;
+  p->flags = extraFlags ? SQLITE_FUNC_CONSTANT : 0;
   p->xFunc = xFunc;
   p->xStep = xStep;
   p->xFinalize = xFinal;
@@ -340,9 +340,24 @@ void *sqlite3Malloc(int n){
     /*内存分配满了就用sqlite3_malloc*/
     p = 0;
   }else if( sqlite3GlobalConfig.bMemstat ){//允许分配
-    sqlite3_mutex_enter(mem0.mutex);
-    mallocWithAlarm(n, &p);
-    sqlite3_mutex_leave(mem0.mutex);
+#if SQLITE_STATUS_LOCKFREE
+    if( mem0.alarmCallback==0 ){
+      /* With no alarm to check, only the counters need updating, and
+      ** they do not need mem0.mutex. */
+      int nFull = sqlite3GlobalConfig.m.xRoundup(n);
+      sqlite3StatusSet(SQLITE_STATUS_MALLOC_SIZE, n);
+      p = sqlite3GlobalConfig.m.xMalloc(nFull);
+      if( p ){
+        sqlite3StatusAdd(SQLITE_STATUS_MEMORY_USED, sqlite3MallocSize(p));
+        sqlite3StatusAdd(SQLITE_STATUS_MALLOC_COUNT, 1);
+      }
+    }else
+#endif
+    {
+      sqlite3_mutex_enter(mem0.mutex);
+      mallocWithAlarm(n, &p);
+      sqlite3_mutex_leave(mem0.mutex);
+    }
   }else{
     p = sqlite3GlobalConfig.m.xMalloc(n);//重新分配
   }
@@ -484,6 +499,203 @@ static int isLookaside(sqlite3 *db, void *p){
 #define isLookaside(A,B) 0
 #endif
 
+/*
+** Return the chunk and size class of lookaside allocation p.
+*/
+static LookasideChunk *lookasideChunk(sqlite3 *db, void *p){
+  assert( isLookaside(db, p) );
+  return &db->lookaside.aChunk[((u8*)p - (u8*)db->lookaside.pStart)
+                                 / db->lookaside.sz];
+}
+static LookasideClass *lookasideClass(sqlite3 *db, void *p){
+  LookasideChunk *pChunk = lookasideChunk(db, p);
+  assert( pChunk->iClass<db->lookaside.nClass );
+  return &db->lookaside.aClass[pChunk->iClass];
+}
+
+/*
+** Give each size class of db the number of chunks that recent demand
+** calls for, as far as chunks with no buffers checked out allow.  A
+** quarter of the chunks are shared out evenly and the rest in proportion
+** to the bytes requested from each class since the last layout.
+**
+** Only the free lists change.  Chunks that are moved are first taken
+** out of the free list of their old class, while the links stored in
+** their buffers are still intact, and then cut into buffers of the new
+** class.
+*/
+static void lookasideLayout(Lookaside *pLa){
+  i64 aWant[LOOKASIDE_NCLASS];
+  int aExcess[LOOKASIDE_NCLASS];
+  i64 nWant = 0;
+  int nEven = pLa->nChunk/4/pLa->nClass;
+  int nRest = pLa->nChunk - nEven*pLa->nClass;
+  int nTarget = 0;
+  int nMove = 0;
+  int i, j;
+
+  assert( pLa->nClass>0 && pLa->nClass<=LOOKASIDE_NCLASS );
+  for(i=0; i<pLa->nClass; i++){
+    aWant[i] = (i64)pLa->aClass[i].nReq * pLa->aClass[i].sz;
+    nWant += aWant[i];
+  }
+  while( nWant>0x7fffffff ){
+    nWant = 0;
+    for(i=0; i<pLa->nClass; i++){
+      aWant[i] >>= 1;
+      nWant += aWant[i];
+    }
+  }
+  for(i=0; i<pLa->nClass; i++){
+    LookasideClass *pCls = &pLa->aClass[i];
+    int nShare;
+    if( i==pLa->nClass-1 ){
+      nShare = pLa->nChunk - nTarget;
+    }else if( nWant>0 ){
+      nShare = nEven + (int)(nRest*aWant[i]/nWant);
+    }else{
+      nShare = nEven + nRest/pLa->nClass;
+    }
+    nTarget += nShare;
+    aExcess[i] = pCls->nChunk - nShare;
+    pCls->nReq = 0;
+  }
+
+  /* Count the free buffers in each chunk */
+  for(j=0; j<pLa->nChunk; j++) pLa->aChunk[j].nFree = 0;
+  for(i=0; i<pLa->nClass; i++){
+    LookasideSlot *p;
+    for(p=pLa->aClass[i].pFree; p; p=p->pNext){
+      pLa->aChunk[((u8*)p - (u8*)pLa->pStart)/pLa->sz].nFree++;
+    }
+  }
+
+  /* Choose the chunks to move.  A chunk is moved only if it is unused,
+  ** its class has more chunks than it should and another class fewer. */
+  i = 0;
+  for(j=0; j<pLa->nChunk; j++){
+    LookasideChunk *pChunk = &pLa->aChunk[j];
+    int iOld = pChunk->iClass;
+    if( iOld<pLa->nClass ){
+      if( aExcess[iOld]<=0 || pChunk->nFree<pLa->aClass[iOld].nPer ) continue;
+    }
+    while( i<pLa->nClass && aExcess[i]>=0 ) i++;
+    if( i==pLa->nClass ) break;
+    if( iOld<pLa->nClass ){
+      aExcess[iOld]--;
+      pLa->aClass[iOld].nChunk--;
+    }
+    aExcess[i]++;
+    pLa->aClass[i].nChunk++;
+    pChunk->iClass = (u8)i;
+    pChunk->bMoved = 1;
+    nMove++;
+  }
+  if( nMove==0 ) return;
+
+  /* Drop the buffers of moved chunks from their old free lists */
+  for(i=0; i<pLa->nClass; i++){
+    LookasideSlot **pp = &pLa->aClass[i].pFree;
+    while( *pp ){
+      LookasideChunk *pChunk = &pLa->aChunk[((u8*)*pp - (u8*)pLa->pStart)
+                                            / pLa->sz];
+      if( pChunk->iClass!=i ){
+        *pp = (*pp)->pNext;
+      }else{
+        pp = &(*pp)->pNext;
+      }
+    }
+  }
+
+  /* Cut the moved chunks into buffers of their new class */
+  for(j=0; j<pLa->nChunk; j++){
+    LookasideChunk *pChunk = &pLa->aChunk[j];
+    if( pChunk->bMoved ){
+      LookasideClass *pCls = &pLa->aClass[pChunk->iClass];
+      u8 *p = &((u8*)pLa->pStart)[j*pLa->sz];
+      int k;
+      for(k=0; k<pCls->nPer; k++){
+        LookasideSlot *pSlot = (LookasideSlot*)&p[k*pCls->sz];
+        pSlot->pNext = pCls->pFree;
+        pCls->pFree = pSlot;
+      }
+      pChunk->bMoved = 0;
+    }
+  }
+}
+
+/*
+** Cut the Lookaside.nByte bytes of memory at Lookaside.pStart into
+** chunks and divide them between the size classes.  No lookaside
+** buffers may be checked out.
+*/
+void sqlite3LookasideInit(sqlite3 *db){
+  Lookaside *pLa = &db->lookaside;
+  int i;
+
+  assert( pLa->nOut==0 );
+  pLa->nChunk = pLa->nByte/(pLa->sz + (int)sizeof(LookasideChunk));
+  pLa->pEnd = (void*)&((u8*)pLa->pStart)[pLa->nChunk*pLa->sz];
+  pLa->aChunk = (LookasideChunk*)pLa->pEnd;
+  for(i=0; i<pLa->nChunk; i++){
+    pLa->aChunk[i].iClass = LOOKASIDE_NCLASS;
+    pLa->aChunk[i].bMoved = 0;
+  }
+  for(i=0; i<pLa->nClass; i++){
+    pLa->aClass[i].nPer = pLa->sz/pLa->aClass[i].sz;
+    pLa->aClass[i].nChunk = 0;
+    pLa->aClass[i].pFree = 0;
+  }
+  pLa->nMiss = 0;
+  pLa->bGrow = 0;
+  lookasideLayout(pLa);
+}
+
+/*
+** Double the lookaside memory of db, subject to Lookaside.mxByte, and
+** lay it out again.  No lookaside buffers may be checked out.
+*/
+static void lookasideGrow(sqlite3 *db){
+  Lookaside *pLa = &db->lookaside;
+  int nNew = pLa->nByte<pLa->mxByte/2 ? pLa->nByte*2 : pLa->mxByte;
+  void *pNew;
+  assert( pLa->nOut==0 && pLa->bMalloced );
+  sqlite3BeginBenignMalloc();
+  pNew = sqlite3Malloc(nNew);
+  sqlite3EndBenignMalloc();
+  if( pNew ){
+    sqlite3_free(pLa->pStart);
+    pLa->pStart = pNew;
+    pLa->nByte = sqlite3MallocSize(pNew);
+    sqlite3LookasideInit(db);
+  }
+  pLa->bGrow = 0;
+}
+
+/*
+** Adapt the lookaside memory of db to recent demand.  This is called
+** when a statement is reset, once SQLITE_LOOKASIDE_ADAPT full misses
+** have been seen, and works even while buffers are checked out.  If
+** more than one request in eight missed, the memory is also marked to
+** be doubled the next time no buffers are checked out.
+*/
+void sqlite3LookasideAdapt(sqlite3 *db){
+  Lookaside *pLa = &db->lookaside;
+  if( pLa->nClass==0 ) return;
+  if( pLa->bMalloced && pLa->nByte<pLa->mxByte ){
+    u32 nReq = 0;
+    int i;
+    for(i=0; i<pLa->nClass; i++) nReq += pLa->aClass[i].nReq;
+    if( (u32)pLa->nMiss > nReq/8 ) pLa->bGrow = 1;
+  }
+  pLa->nMiss = 0;
+  if( pLa->bGrow && pLa->nOut==0 ){
+    lookasideGrow(db);
+  }else{
+    lookasideLayout(pLa);
+  }
+}
+
 /*
 ** Return the size of a memory allocation previously obtained from
 ** sqlite3Malloc() or sqlite3_malloc().
@@ -497,7 +709,7 @@ int sqlite3MallocSize(void *p){
 int sqlite3DbMallocSize(sqlite3 *db, void *p){
   assert( db==0 || sqlite3_mutex_held(db->mutex) );
   if( db && isLookaside(db, p) ){
-    return db->lookaside.sz;
+    return lookasideClass(db, p)->sz;
   }else{
     assert( sqlite3MemdebugHasType(p, MEMTYPE_DB) );
     assert( sqlite3MemdebugHasType(p, MEMTYPE_LOOKASIDE|MEMTYPE_HEAP) );
@@ -515,11 +727,17 @@ void sqlite3_free(void *p){
   assert( sqlite3MemdebugNoType(p, MEMTYPE_DB) );
   assert( sqlite3MemdebugHasType(p, MEMTYPE_HEAP) );
   if( sqlite3GlobalConfig.bMemstat ){
+#if SQLITE_STATUS_LOCKFREE
+    sqlite3StatusAdd(SQLITE_STATUS_MEMORY_USED, -sqlite3MallocSize(p));
+    sqlite3StatusAdd(SQLITE_STATUS_MALLOC_COUNT, -1);
+    sqlite3GlobalConfig.m.xFree(p);
+#else
     sqlite3_mutex_enter(mem0.mutex);
     sqlite3StatusAdd(SQLITE_STATUS_MEMORY_USED, -sqlite3MallocSize(p));
     sqlite3StatusAdd(SQLITE_STATUS_MALLOC_COUNT, -1);
     sqlite3GlobalConfig.m.xFree(p);
     sqlite3_mutex_leave(mem0.mutex);
+#endif
   }else{
     sqlite3GlobalConfig.m.xFree(p);
   }
@@ -539,13 +757,16 @@ void sqlite3DbFree(sqlite3 *db, void *p){
     }
     if( isLookaside(db, p) ){
       LookasideSlot *pBuf = (LookasideSlot*)p;
+      LookasideClass *pCls = lookasideClass(db, p);
 #if SQLITE_DEBUG
       /* Trash all content in the buffer being freed */
-      memset(p, 0xaa, db->lookaside.sz);
+      memset(p, 0xaa, pCls->sz);
 #endif
-      pBuf->pNext = db->lookaside.pFree;
-      db->lookaside.pFree = pBuf;
-      db->lookaside.nOut--;
+      pBuf->pNext = pCls->pFree;
+      pCls->pFree = pBuf;
+      if( --db->lookaside.nOut==0 && db->lookaside.bGrow ){
+        lookasideGrow(db);
+      }
       return;
     }
   }
@@ -581,6 +802,17 @@ void *sqlite3Realloc(void *pOld, int nBytes){
   nNew = sqlite3GlobalConfig.m.xRoundup(nBytes);//四舍五入给nNew
   if( nOld==nNew ){//新的等于旧的
     pNew = pOld;//新指针指向pOld
+#if SQLITE_STATUS_LOCKFREE
+  }else if( sqlite3GlobalConfig.bMemstat && mem0.alarmCallback==0 ){
+    sqlite3StatusSet(SQLITE_STATUS_MALLOC_SIZE, nBytes);
+    assert( sqlite3MemdebugHasType(pOld, MEMTYPE_HEAP) );
+    assert( sqlite3MemdebugNoType(pOld, ~MEMTYPE_HEAP) );
+    pNew = sqlite3GlobalConfig.m.xRealloc(pOld, nNew);
+    if( pNew ){
+      nNew = sqlite3MallocSize(pNew);
+      sqlite3StatusAdd(SQLITE_STATUS_MEMORY_USED, nNew-nOld);
+    }
+#endif
   }else if( sqlite3GlobalConfig.bMemstat ){
     sqlite3_mutex_enter(mem0.mutex);
     sqlite3StatusSet(SQLITE_STATUS_MALLOC_SIZE, nBytes);
@@ -681,16 +913,25 @@ void *sqlite3DbMallocRaw(sqlite3 *db, int n){
     if( db->lookaside.bEnabled ){//禁用后备内存
       if( n>db->lookaside.sz ){//如果给的n大于每个缓冲区大小
         db->lookaside.anStat[1]++;
-      }else if( (pBuf = db->lookaside.pFree)==0 ){
-        db->lookaside.anStat[2]++;
       }else{
-        db->lookaside.pFree = pBuf->pNext;
-        db->lookaside.nOut++;
-        db->lookaside.anStat[0]++;//命中
-        if( db->lookaside.nOut>db->lookaside.mxOut ){//最大值
-          db->lookaside.mxOut = db->lookaside.nOut;
+        LookasideClass *pCls = db->lookaside.aClass;
+        LookasideClass *pLast = &pCls[db->lookaside.nClass];
+        while( n>pCls->sz ) pCls++;
+        pCls->nReq++;
+        /* Use the best fitting class, or the next larger one with room */
+        for(; pCls<pLast; pCls++){
+          if( (pBuf = pCls->pFree)!=0 ){
+            pCls->pFree = pBuf->pNext;
+            db->lookaside.nOut++;
+            db->lookaside.anStat[0]++;//命中
+            if( db->lookaside.nOut>db->lookaside.mxOut ){//最大值
+              db->lookaside.mxOut = db->lookaside.nOut;
+            }
+            return (void*)pBuf;
+          }
         }
-        return (void*)pBuf;
+        db->lookaside.anStat[2]++;
+        db->lookaside.nMiss++;
       }
     }
   }
@@ -724,12 +965,13 @@ void *sqlite3DbRealloc(sqlite3 *db, void *p, int n){
       return sqlite3DbMallocRaw(db, n);
     }
     if( isLookaside(db, p) ){//后备内存
-      if( n<=db->lookaside.sz ){//小于每一个块的大小
+      int sz = lookasideClass(db, p)->sz;
+      if( n<=sz ){//小于每一个块的大小
         return p;
       }
       pNew = sqlite3DbMallocRaw(db, n);//pNew指向新的地址空间
       if( pNew ){
-        memcpy(pNew, p, db->lookaside.sz);//拷贝p的内存到pNew中
+        memcpy(pNew, p, sz);//拷贝p的内存到pNew中
         sqlite3DbFree(db, p);//释放p
       }
     }else{
@@ -227,12 +227,18 @@ static int sqlite3MemSize(void *p){
 static int sqlite3MemInit(void *NotUsed){
   UNUSED_PARAMETER(NotUsed);
   assert( (sizeof(struct MemBlockHdr)&7) == 0 );
+#if SQLITE_STATUS_LOCKFREE
+  /* The malloc.c wrapper does not hold any mutex when the routines here
+  ** are invoked, so use a mutex of our own. */
+  mem.mutex = sqlite3MutexAlloc(SQLITE_MUTEX_FAST);
+#else
   if( !sqlite3GlobalConfig.bMemstat ){
     /* If memory status is enabled, then the malloc.c wrapper will already
     ** hold the STATIC_MEM mutex when the routines here are invoked. */
     /*如果内存状态被激活，那么这里的例程被调用时，malloc.c包装将已持有的STATIC_MEM互斥。*/
     mem.mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MEM);
   }
+#endif
   return SQLITE_OK;
 }
 
@@ -241,8 +247,14 @@ static int sqlite3MemInit(void *NotUsed){
 */
 /*取消初始化内存分配子系统*/
 static void sqlite3MemShutdown(void *NotUsed){
+#if SQLITE_STATUS_LOCKFREE
+  sqlite3_mutex *pMutex = mem.mutex;
+#endif
   UNUSED_PARAMETER(NotUsed);
   mem.mutex = 0;
+#if SQLITE_STATUS_LOCKFREE
+  sqlite3_mutex_free(pMutex);
+#endif
 }
 
 /*
@@ -351,8 +363,10 @@ static void sqlite3MemFree(void *pPrior){
   struct MemBlockHdr *pHdr;
   void **pBt;
   char *z;
+  /* With lock-free status counters, mem.mutex is 0 only while it is
+  ** itself being freed by sqlite3MemShutdown(). */
   assert( sqlite3GlobalConfig.bMemstat || sqlite3GlobalConfig.bCoreMutex==0 
-       || mem.mutex!=0 );
+       || mem.mutex!=0 || SQLITE_STATUS_LOCKFREE );
   pHdr = sqlite3MemsysGetHeader(pPrior);
   pBt = (void**)pHdr;
   pBt -= pHdr->nBacktraceSlots;
@@ -571,6 +571,12 @@ static int memsys3Init(void *NotUsed){
   mem3.aPool[mem3.nPool].u.hdr.prevSize = mem3.nPool;
   mem3.aPool[mem3.nPool].u.hdr.size4x = 1;
 
+#if SQLITE_STATUS_LOCKFREE
+  /* malloc.c does not hold the STATIC_MEM mutex on our behalf when
+  ** status counters are lock-free, so use a mutex of our own.  It is
+  ** allocated from the pool that was just set up. */
+  mem3.mutex = sqlite3MutexAlloc(SQLITE_MUTEX_FAST);
+#endif
   return SQLITE_OK;
 }
 
@@ -578,8 +584,14 @@ static int memsys3Init(void *NotUsed){
 ** Deinitialize this module.  //取消该模块的初始化设置
 */
 static void memsys3Shutdown(void *NotUsed){
+#if SQLITE_STATUS_LOCKFREE
+  sqlite3_mutex *pMutex = mem3.mutex;
+#endif
   UNUSED_PARAMETER(NotUsed);
   mem3.mutex = 0;
+#if SQLITE_STATUS_LOCKFREE
+  sqlite3_mutex_free(pMutex);
+#endif
   return;
 }
 
@@ -574,11 +574,17 @@ static int memsys5Init(void *NotUsed){
     assert((iOffset+nAlloc)>mem5.nBlock);
   }
 
-  /* If a mutex is required for normal operation, allocate one */
+  /* If a mutex is required for normal operation, allocate one.  When
+  ** status counters are lock-free, malloc.c does not hold STATIC_MEM on
+  ** our behalf, so allocate a mutex of our own from the new pool. */
   /*如果程序正常运行需要互斥,则分配一个互斥锁 */
+#if SQLITE_STATUS_LOCKFREE
+  mem5.mutex = sqlite3MutexAlloc(SQLITE_MUTEX_FAST);
+#else
   if( sqlite3GlobalConfig.bMemstat==0 ){
     mem5.mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MEM);
   }
+#endif
 
   return SQLITE_OK;
 }
@@ -587,8 +593,14 @@ static int memsys5Init(void *NotUsed){
 ** Deinitialize this module.取消初始化这个模块。
 */
 static void memsys5Shutdown(void *NotUsed){
+#if SQLITE_STATUS_LOCKFREE
+  sqlite3_mutex *pMutex = mem5.mutex;
+#endif
   UNUSED_PARAMETER(NotUsed);
   mem5.mutex = 0;
+#if SQLITE_STATUS_LOCKFREE
+  sqlite3_mutex_free(pMutex);
+#endif
   return;
 }
 
@@ -0,0 +1,428 @@
+/*
+** 2012 October 3
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+** This file contains a memory allocation subsystem for use by SQLite
+** in heavily multi-threaded applications.  It is a caching layer on
+** top of the system malloc():
+**
+**   1.  Requests up to MEM6_MAX_SIZE bytes are rounded up to one of a
+**       fixed set of size classes.  The classes are chosen to fit what
+**       SQLite allocates most often: Mem buffers and Expr nodes at the
+**       small end, VdbeOp arrays and btree cells in the middle, and
+**       page cache entries (a page plus its PgHdr1 and extra bytes) for
+**       the common page sizes at the top.
+**
+**   2.  Freed blocks are kept on a per-class free list and handed out
+**       again by later requests of the same class, up to a limit of
+**       SQLITE_MEMSYS6_CACHE bytes per class.  Blocks beyond the limit,
+**       and requests larger than MEM6_MAX_SIZE, go to malloc()/free().
+**
+**   3.  The free lists are split into SQLITE_MEMSYS6_SHARDS shards,
+**       each with its own mutex.  A thread always uses the same shard,
+**       so threads seldom wait on each other.  Where the compiler
+**       supports thread-local variables, each new thread is given the
+**       next shard in turn.  Otherwise the shard is chosen from the
+**       address of the thread's stack.
+**
+** Usage counters are kept in the shards too and are only added up
+** when somebody asks for them.
+**
+** This version of the memory allocation subsystem is included
+** in the build only if SQLITE_ENABLE_MEMSYS6 is defined.  It is
+** installed by sqlite3_config(SQLITE_CONFIG_MALLOC_CACHED).
+*/
+#include "sqliteInt.h"
+
+#ifdef SQLITE_ENABLE_MEMSYS6
+
+/*
+** Number of free-list shards.  Must be a power of two.
+*/
+#ifndef SQLITE_MEMSYS6_SHARDS
+# define SQLITE_MEMSYS6_SHARDS 16
+#endif
+
+/*
+** Maximum number of bytes held on the free list of one size class
+** in one shard.
+*/
+#ifndef SQLITE_MEMSYS6_CACHE
+# define SQLITE_MEMSYS6_CACHE 32768
+#endif
+
+/*
+** Thread-local storage, if the compiler provides it.
+*/
+#if SQLITE_THREADSAFE && defined(__GNUC__)
+# define MEM6_THREAD_LOCAL __thread
+#elif SQLITE_THREADSAFE && defined(_MSC_VER)
+# define MEM6_THREAD_LOCAL __declspec(thread)
+#endif
+
+/*
+** Usable sizes of the size classes.  Each is a multiple of 16.
+*/
+static const int aMem6Class[] = {
+     16,    32,    48,    64,    80,    96,   112,   128,
+    160,   192,   224,   256,   320,   384,   448,   512,
+    640,   768,   896,  1024,  1280,  1536,  1792,  2048,
+   2560,  3072,  3584,  4096,  4608,  5120,  6144,  7168,
+   8192,  8704, 10240, 12288, 16384, 16896
+};
+#define MEM6_NCLASS   ((int)(sizeof(aMem6Class)/sizeof(aMem6Class[0])))
+#define MEM6_MAX_SIZE 16896
+
+/*
+** Value of Mem6Hdr.iClass for an allocation that does not belong to
+** any size class.
+*/
+#define MEM6_LARGE    0xffff
+
+/*
+** Every allocation is preceded by one of these.  It is 8 bytes in
+** size so that the memory returned to the caller stays 8-byte aligned.
+*/
+typedef struct Mem6Hdr Mem6Hdr;
+struct Mem6Hdr {
+  u32 iClass;         /* Index into aMem6Class[], or MEM6_LARGE */
+  u32 nByte;          /* Usable size of the allocation */
+};
+
+/*
+** A free block, as seen from its user area.
+*/
+typedef struct Mem6Free Mem6Free;
+struct Mem6Free {
+  Mem6Free *pNext;    /* Next free block of the same class */
+};
+
+/*
+** One shard of the allocator.
+*/
+typedef struct Mem6Shard Mem6Shard;
+struct Mem6Shard {
+  sqlite3_mutex *mutex;           /* Mutex protecting this shard */
+  Mem6Free *apFree[MEM6_NCLASS];  /* Free blocks, by size class */
+  int anFree[MEM6_NCLASS];        /* Number of blocks on each apFree[] */
+  sqlite3_int64 nAlloc;           /* Allocations made through this shard */
+  sqlite3_int64 nHit;             /* Allocations satisfied from apFree[] */
+  sqlite3_int64 nCached;          /* Bytes held on apFree[] lists */
+  char aPad[64];                  /* Keep shards on separate cache lines */
+};
+
+/*
+** All of the static variables used by this module are collected
+** into a single structure named "mem6".
+*/
+static SQLITE_WSD struct Mem6Global {
+  int isInit;                     /* True between xInit and xShutdown */
+  int iNextShard;                 /* Shard for the next new thread */
+  int anMaxFree[MEM6_NCLASS];     /* Free-list length limit per class */
+  u8 aSizeToClass[MEM6_MAX_SIZE/16+1];  /* Map (nByte+15)/16 to a class */
+  Mem6Shard aShard[SQLITE_MEMSYS6_SHARDS];
+} mem6 = { 0, 0, };
+
+#define mem6 GLOBAL(struct Mem6Global, mem6)
+
+/*
+** Return the shard used by the calling thread.
+*/
+static Mem6Shard *memsys6Shard(void){
+#ifdef MEM6_THREAD_LOCAL
+  static MEM6_THREAD_LOCAL int iShard = -1;
+  if( iShard<0 ){
+    /* A race on iNextShard only affects how evenly threads are spread */
+    iShard = (mem6.iNextShard++) & (SQLITE_MEMSYS6_SHARDS-1);
+  }
+  return &mem6.aShard[iShard];
+#else
+  /* Thread stacks are at least 64KiB apart */
+  int x;
+  u32 h = ((u32)SQLITE_PTR_TO_INT(&x))>>16;
+  h *= 0x9e3779b1;
+  return &mem6.aShard[(h>>16) & (SQLITE_MEMSYS6_SHARDS-1)];
+#endif
+}
+
+/*
+** Return the size class for a request of nByte bytes.  nByte must be
+** between 1 and MEM6_MAX_SIZE.
+*/
+static int memsys6Class(int nByte){
+  assert( nByte>0 && nByte<=MEM6_MAX_SIZE );
+  return mem6.aSizeToClass[(nByte+15)>>4];
+}
+
+/*
+** Allocate nByte bytes straight from the system, outside of any class.
+*/
+static void *memsys6MallocLarge(int nByte){
+  Mem6Hdr *p;
+  nByte = ROUND8(nByte);
+  p = (Mem6Hdr*)malloc(nByte+sizeof(Mem6Hdr));
+  if( p==0 ){
+    testcase( sqlite3GlobalConfig.xLog!=0 );
+    sqlite3_log(SQLITE_NOMEM, "failed to allocate %u bytes of memory", nByte);
+    return 0;
+  }
+  p->iClass = MEM6_LARGE;
+  p->nByte = nByte;
+  return (void*)&p[1];
+}
+
+/*
+** Allocate nByte bytes of memory.
+*/
+static void *memsys6Malloc(int nByte){
+  Mem6Shard *pShard;
+  Mem6Hdr *p;
+  Mem6Free *pFree;
+  int iClass;
+
+  if( nByte>MEM6_MAX_SIZE || !mem6.isInit ){
+    return memsys6MallocLarge(nByte);
+  }
+  iClass = memsys6Class(nByte);
+  pShard = memsys6Shard();
+  sqlite3_mutex_enter(pShard->mutex);
+  pShard->nAlloc++;
+  pFree = pShard->apFree[iClass];
+  if( pFree ){
+    pShard->apFree[iClass] = pFree->pNext;
+    pShard->anFree[iClass]--;
+    pShard->nCached -= aMem6Class[iClass];
+    pShard->nHit++;
+    sqlite3_mutex_leave(pShard->mutex);
+    return (void*)pFree;
+  }
+  sqlite3_mutex_leave(pShard->mutex);
+
+  p = (Mem6Hdr*)malloc(aMem6Class[iClass]+sizeof(Mem6Hdr));
+  if( p==0 ){
+    testcase( sqlite3GlobalConfig.xLog!=0 );
+    sqlite3_log(SQLITE_NOMEM, "failed to allocate %u bytes of memory", nByte);
+    return 0;
+  }
+  p->iClass = iClass;
+  p->nByte = aMem6Class[iClass];
+  return (void*)&p[1];
+}
+
+/*
+** Free memory obtained from memsys6Malloc().  The block goes onto the
+** free list of the calling thread's shard, which need not be the shard
+** it was allocated from.
+*/
+static void memsys6Free(void *pPrior){
+  Mem6Hdr *p;
+  Mem6Shard *pShard;
+  int iClass;
+
+  assert( pPrior!=0 );
+  p = &((Mem6Hdr*)pPrior)[-1];
+  iClass = p->iClass;
+  if( iClass!=MEM6_LARGE && mem6.isInit ){
+    Mem6Free *pFree = (Mem6Free*)pPrior;
+    assert( iClass<MEM6_NCLASS );
+    pShard = memsys6Shard();
+    sqlite3_mutex_enter(pShard->mutex);
+    if( pShard->anFree[iClass]<mem6.anMaxFree[iClass] ){
+      pFree->pNext = pShard->apFree[iClass];
+      pShard->apFree[iClass] = pFree;
+      pShard->anFree[iClass]++;
+      pShard->nCached += aMem6Class[iClass];
+      sqlite3_mutex_leave(pShard->mutex);
+      return;
+    }
+    sqlite3_mutex_leave(pShard->mutex);
+  }
+  free(p);
+}
+
+/*
+** Return the usable size of an allocation.
+*/
+static int memsys6Size(void *pPrior){
+  if( pPrior==0 ) return 0;
+  return (int)((Mem6Hdr*)pPrior)[-1].nByte;
+}
+
+/*
+** Change the size of an existing memory allocation.  The allocation
+** is left where it is if it is shrinking by less than half.
+**
+** The outer layer memory allocator prevents this routine from
+** being called with pPrior==0.
+*/
+static void *memsys6Realloc(void *pPrior, int nByte){
+  void *pNew;
+  int nOld;
+
+  assert( pPrior!=0 && nByte>0 );
+  nOld = memsys6Size(pPrior);
+  if( nByte<=nOld && nByte>nOld/2 ){
+    return pPrior;
+  }
+  pNew = memsys6Malloc(nByte);
+  if( pNew ){
+    memcpy(pNew, pPrior, nOld<nByte ? nOld : nByte);
+    memsys6Free(pPrior);
+  }
+  return pNew;
+}
+
+/*
+** Round up a request size to the next valid allocation size.
+*/
+static int memsys6Roundup(int n){
+  if( n<=0 ) return 0;
+  if( n>MEM6_MAX_SIZE ) return ROUND8(n);
+  return aMem6Class[memsys6Class(n)];
+}
+
+/*
+** Return every cached block of every shard to the system.
+*/
+static void memsys6Drain(void){
+  int i, j;
+  for(i=0; i<SQLITE_MEMSYS6_SHARDS; i++){
+    Mem6Shard *pShard = &mem6.aShard[i];
+    sqlite3_mutex_enter(pShard->mutex);
+    for(j=0; j<MEM6_NCLASS; j++){
+      Mem6Free *pFree = pShard->apFree[j];
+      while( pFree ){
+        Mem6Free *pNext = pFree->pNext;
+        free(&((Mem6Hdr*)pFree)[-1]);
+        pFree = pNext;
+      }
+      pShard->apFree[j] = 0;
+      pShard->anFree[j] = 0;
+    }
+    pShard->nCached = 0;
+    sqlite3_mutex_leave(pShard->mutex);
+  }
+}
+
+/*
+** Initialize this module.
+**
+** Until isInit is set every request is passed straight to malloc(),
+** so the shard mutexes can themselves be allocated from here.
+*/
+static int memsys6Init(void *NotUsed){
+  int i, j;
+  UNUSED_PARAMETER(NotUsed);
+
+  assert( (SQLITE_MEMSYS6_SHARDS & (SQLITE_MEMSYS6_SHARDS-1))==0 );
+  assert( sizeof(Mem6Hdr)==8 );
+  memset(&mem6, 0, sizeof(mem6));
+  for(i=0, j=0; i<=MEM6_MAX_SIZE/16; i++){
+    while( aMem6Class[j]<i*16 ) j++;
+    mem6.aSizeToClass[i] = (u8)j;
+  }
+  for(j=0; j<MEM6_NCLASS; j++){
+    mem6.anMaxFree[j] = SQLITE_MEMSYS6_CACHE/aMem6Class[j];
+    if( mem6.anMaxFree[j]<2 ) mem6.anMaxFree[j] = 2;
+  }
+  for(i=0; i<SQLITE_MEMSYS6_SHARDS; i++){
+    mem6.aShard[i].mutex = sqlite3MutexAlloc(SQLITE_MUTEX_FAST);
+    if( sqlite3GlobalConfig.bCoreMutex && mem6.aShard[i].mutex==0 ){
+      while( --i>=0 ){
+        sqlite3_mutex_free(mem6.aShard[i].mutex);
+        mem6.aShard[i].mutex = 0;
+      }
+      return SQLITE_NOMEM;
+    }
+  }
+  mem6.isInit = 1;
+  return SQLITE_OK;
+}
+
+/*
+** Deinitialize this module.
+*/
+static void memsys6Shutdown(void *NotUsed){
+  int i;
+  UNUSED_PARAMETER(NotUsed);
+  memsys6Drain();
+  mem6.isInit = 0;
+  for(i=0; i<SQLITE_MEMSYS6_SHARDS; i++){
+    sqlite3_mutex_free(mem6.aShard[i].mutex);
+    mem6.aShard[i].mutex = 0;
+  }
+}
+
+#ifdef SQLITE_TEST
+/*
+** Open the file indicated and write the allocator statistics, summed
+** over all shards, into it.
+*/
+void sqlite3Memsys6Dump(const char *zFilename){
+  FILE *out;
+  int i, j;
+  sqlite3_int64 nAlloc = 0, nHit = 0, nCached = 0;
+
+  if( zFilename==0 || zFilename[0]==0 ){
+    out = stdout;
+  }else{
+    out = fopen(zFilename, "w");
+    if( out==0 ){
+      fprintf(stderr, "** Unable to output memory debug output log: %s **\n",
+                      zFilename);
+      return;
+    }
+  }
+  for(j=0; j<MEM6_NCLASS; j++){
+    int n = 0;
+    for(i=0; i<SQLITE_MEMSYS6_SHARDS; i++){
+      n += mem6.aShard[i].anFree[j];
+    }
+    fprintf(out, "freelist items of size %d: %d\n", aMem6Class[j], n);
+  }
+  for(i=0; i<SQLITE_MEMSYS6_SHARDS; i++){
+    Mem6Shard *pShard = &mem6.aShard[i];
+    sqlite3_mutex_enter(pShard->mutex);
+    nAlloc += pShard->nAlloc;
+    nHit += pShard->nHit;
+    nCached += pShard->nCached;
+    sqlite3_mutex_leave(pShard->mutex);
+  }
+  fprintf(out, "mem6.nAlloc       = %lld\n", nAlloc);
+  fprintf(out, "mem6.nHit         = %lld\n", nHit);
+  fprintf(out, "mem6.nCached      = %lld\n", nCached);
+  if( out==stdout ){
+    fflush(stdout);
+  }else{
+    fclose(out);
+  }
+}
+#endif
+
+/*
+** This routine is the only routine in this file with external
+** linkage. It returns a pointer to a static sqlite3_mem_methods
+** struct populated with the memsys6 methods.
+*/
+const sqlite3_mem_methods *sqlite3MemGetMemsys6(void){
+  static const sqlite3_mem_methods memsys6Methods = {
+     memsys6Malloc,
+     memsys6Free,
+     memsys6Realloc,
+     memsys6Size,
+     memsys6Roundup,
+     memsys6Init,
+     memsys6Shutdown,
+     0
+  };
+  return &memsys6Methods;
+}
+
+#endif /* SQLITE_ENABLE_MEMSYS6 */
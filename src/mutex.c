@@ -158,6 +158,53 @@ void sqlite3_mutex_leave(sqlite3_mutex *p){
   }
 }
 
+/*
+** Contention counters, by mutex type.  aWait[i][0] counts the times a
+** mutex of type i was found busy on entry, and aWait[i][1] how many of
+** those times the thread had to block.  They are kept by the built-in
+** mutex implementations through sqlite3MutexContended().
+*/
+static SQLITE_WSD struct MutexWaitStat {
+  int aWait[SQLITE_MUTEX_NTYPE][2];
+} mutexWaitStat = { {{0,0},} };
+#define wsdMutexWait GLOBAL(struct MutexWaitStat, mutexWaitStat).aWait
+
+/*
+** Record that a mutex of type iType was found busy.  bBlocked is true
+** if the caller had to block rather than obtaining it by spinning.
+*/
+void sqlite3MutexContended(int iType, int bBlocked){
+  assert( iType>=0 && iType<SQLITE_MUTEX_NTYPE );
+#if SQLITE_STATUS_LOCKFREE
+  __atomic_add_fetch(&wsdMutexWait[iType][0], 1, __ATOMIC_RELAXED);
+  if( bBlocked ){
+    __atomic_add_fetch(&wsdMutexWait[iType][1], 1, __ATOMIC_RELAXED);
+  }
+#else
+  wsdMutexWait[iType][0]++;
+  if( bBlocked ) wsdMutexWait[iType][1]++;
+#endif
+}
+
+/*
+** Report the contention counters for mutex type iType, and zero them
+** if resetFlag is true.
+*/
+void sqlite3MutexWaitStatus(
+  int iType,              /* Mutex type, SQLITE_MUTEX_FAST or higher */
+  int *pnWait,            /* OUT: Times found busy */
+  int *pnBlock,           /* OUT: Times the caller had to block */
+  int resetFlag           /* Zero the counters if true */
+){
+  assert( iType>=0 && iType<SQLITE_MUTEX_NTYPE );
+  *pnWait = wsdMutexWait[iType][0];
+  *pnBlock = wsdMutexWait[iType][1];
+  if( resetFlag ){
+    wsdMutexWait[iType][0] = 0;
+    wsdMutexWait[iType][1] = 0;
+  }
+}
+
 #ifndef NDEBUG
 /*
 ** The sqlite3_mutex_held() and sqlite3_mutex_notheld() routine are
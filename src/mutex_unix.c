@@ -40,8 +40,8 @@
 */
 struct sqlite3_mutex {
   pthread_mutex_t mutex;     /* Mutex controlling the lock */
-#if SQLITE_MUTEX_NREF
   int id;                    /* Mutex type */
+#if SQLITE_MUTEX_NREF
   volatile int nRef;         /* Number of entrances */
   volatile pthread_t owner;  /* Thread that is within this mutex */
   int trace;                 /* True to trace changes */
@@ -50,7 +50,7 @@ struct sqlite3_mutex {
 #if SQLITE_MUTEX_NREF
 #define SQLITE3_MUTEX_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0, 0, (pthread_t)0, 0 }
 #else
-#define SQLITE3_MUTEX_INITIALIZER { PTHREAD_MUTEX_INITIALIZER }
+#define SQLITE3_MUTEX_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0 }
 #endif
 
 /*
@@ -152,18 +152,14 @@ static sqlite3_mutex *pthreadMutexAlloc(int iType){
         pthread_mutex_init(&p->mutex, &recursiveAttr);
         pthread_mutexattr_destroy(&recursiveAttr);
 #endif
-#if SQLITE_MUTEX_NREF
         p->id = iType;
-#endif
       }
       break;
     }
     case SQLITE_MUTEX_FAST: {
       p = sqlite3MallocZero( sizeof(*p) );
       if( p ){
-#if SQLITE_MUTEX_NREF
         p->id = iType;
-#endif
         pthread_mutex_init(&p->mutex, 0);
       }
       break;
@@ -172,9 +168,7 @@ static sqlite3_mutex *pthreadMutexAlloc(int iType){
       assert( iType-2 >= 0 );
       assert( iType-2 < ArraySize(staticMutexes) );
       p = &staticMutexes[iType-2];
-#if SQLITE_MUTEX_NREF
       p->id = iType;
-#endif
       break;
     }
   }
@@ -194,6 +188,47 @@ static void pthreadMutexFree(sqlite3_mutex *p){
   sqlite3_free(p);
 }
 
+/*
+** Number of times to retry a busy mutex before blocking on it.  The
+** static mutexes guard very short critical sections, so the holder is
+** usually about to leave.  Spinning briefly avoids the cost of putting
+** the thread to sleep and waking it again.  Set to 0 to always block
+** at once, as is best on single-processor systems.
+*/
+#ifndef SQLITE_MUTEX_SPIN
+# define SQLITE_MUTEX_SPIN 100
+#endif
+
+/*
+** Tell the processor that this is a spin-wait loop.
+*/
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# define pthreadMutexPause()  __asm__ __volatile__("pause")
+#elif defined(__GNUC__) && defined(__aarch64__)
+# define pthreadMutexPause()  __asm__ __volatile__("yield")
+#else
+# define pthreadMutexPause()
+#endif
+
+/*
+** Obtain the underlying pthread mutex of p.  Spin for a little while
+** if it is busy, then block.  Record any contention against the type
+** of p.
+*/
+static void pthreadMutexLock(sqlite3_mutex *p){
+  int i;
+  if( pthread_mutex_trylock(&p->mutex)==0 ) return;
+  for(i=0; i<SQLITE_MUTEX_SPIN; i++){
+    pthreadMutexPause();
+    if( pthread_mutex_trylock(&p->mutex)==0 ){
+      sqlite3MutexContended(p->id, 0);
+      return;
+    }
+  }
+  sqlite3MutexContended(p->id, 1);
+  pthread_mutex_lock(&p->mutex);
+}
+
 /*
 ** The sqlite3_mutex_enter() and sqlite3_mutex_try() routines attempt
 ** to enter a mutex.  If another thread is already within the mutex,
@@ -224,7 +259,7 @@ static void pthreadMutexEnter(sqlite3_mutex *p){
     if( p->nRef>0 && pthread_equal(p->owner, self) ){
       p->nRef++;
     }else{
-      pthread_mutex_lock(&p->mutex);
+      pthreadMutexLock(p);
       assert( p->nRef==0 );
       p->owner = self;
       p->nRef = 1;
@@ -233,7 +268,7 @@ static void pthreadMutexEnter(sqlite3_mutex *p){
 #else
   /* Use the built-in recursive mutexes if they are available.
   */
-  pthread_mutex_lock(&p->mutex);
+  pthreadMutexLock(p);
 #if SQLITE_MUTEX_NREF
   assert( p->nRef>0 || p->owner==0 );
   p->owner = pthread_self();
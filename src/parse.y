@@ -1118,11 +1118,17 @@ nexprlist(A) ::= nexprlist(X) COMMA expr(Y).
 nexprlist(A) ::= expr(Y).
     {A = sqlite3ExprListAppend(pParse,0,Y.pExpr);}
 
+// A list of literals that sqlite3RunParser() has already turned into an
+// ExprList.  See literalList() in tokenize.c.
+nexprlist(A) ::= LITLIST.
+    {A = pParse->pLitList; pParse->pLitList = 0;}
+
 
 ///////////////////////////// The CREATE INDEX command ///////////////////////
 //
 cmd ::= createkw(S) uniqueflag(U) INDEX ifnotexists(NE) nm(X) dbnm(D)
-        ON nm(Y) LP idxlist(Z) RP(E). {
+        ON nm(Y) LP sortlist(Z) RP(E). {
+  sqlite3ExprListCheckLength(pParse, Z, "index");
   sqlite3CreateIndex(pParse, &X, &D, 
                      sqlite3SrcListAppend(pParse->db,0,&Y,0), Z, U,
                       &S, &E, SQLITE_SO_ASC, NE);
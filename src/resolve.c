@@ -589,6 +589,26 @@ static int resolveExprStep(Walker *pWalker, Expr *pExpr){
         }
       }
 #endif
+      if( pDef && (pNC->ncFlags & NC_IdxExpr)!=0
+       && (pDef->flags & SQLITE_FUNC_CONSTANT)==0 && !is_agg ){
+        /* An index holds values computed when each row was written, so
+        ** only functions that always give the same result may appear */
+        sqlite3ErrorMsg(pParse,
+            "non-deterministic functions prohibited in index expressions");
+        pNC->nErr++;
+      }
+      if( pDef && !is_agg
+       && !ExprHasAnyProperty(pExpr, EP_Reduced|EP_TokenOnly)
+      ){
+        /* Remember the properties of the function that code generation
+        ** needs, so that it does not have to look the function up again */
+        if( pDef->flags & SQLITE_FUNC_CONSTANT ){
+          pExpr->flags2 |= EP2_Constant;
+        }
+        if( pDef->flags & SQLITE_FUNC_NOERROR ){
+          pExpr->flags2 |= EP2_NoError;
+        }
+      }
       if( is_agg && (pNC->ncFlags & NC_AllowAgg)==0 ){
         sqlite3ErrorMsg(pParse, "misuse of aggregate function %.*s()", nId,zId);
         pNC->nErr++;
@@ -632,6 +652,9 @@ static int resolveExprStep(Walker *pWalker, Expr *pExpr){
           sqlite3ErrorMsg(pParse,"subqueries prohibited in CHECK constraints");
         }
 #endif
+        if( (pNC->ncFlags & NC_IdxExpr)!=0 ){
+          sqlite3ErrorMsg(pParse,"subqueries prohibited in index expressions");
+        }
         sqlite3WalkSelect(pWalker, pExpr->x.pSelect);
         assert( pNC->nRef>=nRef );
         if( nRef!=pNC->nRef ){
@@ -640,14 +663,17 @@ static int resolveExprStep(Walker *pWalker, Expr *pExpr){
       }
       break;
     }
-#ifndef SQLITE_OMIT_CHECK
     case TK_VARIABLE: {
+#ifndef SQLITE_OMIT_CHECK
       if( (pNC->ncFlags & NC_IsCheck)!=0 ){
         sqlite3ErrorMsg(pParse,"parameters prohibited in CHECK constraints");
       }
+#endif
+      if( (pNC->ncFlags & NC_IdxExpr)!=0 ){
+        sqlite3ErrorMsg(pParse,"parameters prohibited in index expressions");
+      }
       break;
     }
-#endif
   }
   return (pParse->nErr || pParse->db->mallocFailed) ? WRC_Abort : WRC_Continue;
 }
@@ -34,69 +34,97 @@
 ** TEST checks to see if an element is already in the RowSet.  SMALLEST
 ** extracts the least value from the RowSet.
 **
-** The INSERT primitive might allocate additional memory.  Memory is
-** allocated in chunks so most INSERTs do no allocation.  There is an 
-** upper bound on the size of allocated memory.  No memory is freed
-** until DESTROY.
+** The INSERT primitive might allocate additional memory.  Values are
+** first appended to an unsorted array of pending values, which is
+** sorted and merged into the main structure whenever it fills up.  No
+** memory is freed until DESTROY, except that SMALLEST releases each part
+** of the main structure once it has been read through.
+**
+** The main structure is a compressed bitmap in the style of "roaring"
+** bitmaps.  Rowids are grouped by their upper 48 bits into containers
+** kept in a sorted array.  A container holds the lower 16 bits of its
+** values either as a sorted array of u16 (2 bytes per rowid) or, once it
+** has more than ROWSET_ARRAY_MAX values, as a 65536-bit bitmap (as
+** little as 1 bit per rowid).  A set of 50 million consecutive rowids
+** takes about 6MB, rather than the 1.2GB needed by a node per rowid.
+** Groups of fewer than ROWSET_SPARSE_MAX values get no container.  Their
+** values are kept whole in a sorted array of i64 instead, so that a set
+** of widely spaced rowids costs 8 bytes per rowid.
 **
 ** The TEST primitive includes a "batch" number.  The TEST primitive
-** will only see elements that were inserted before the last change
-** in the batch number.  In other words, if an INSERT occurs between
-** two TESTs where the TESTs have the same batch nubmer, then the
-** value added by the INSERT will not be visible to the second TEST.
-** The initial batch number is zero, so if the very first TEST contains
-** a non-zero batch number, it will see all prior INSERTs.
+** will see all elements that were inserted before the last change
+** in the batch number.  It may or may not see elements inserted since
+** then, depending on whether or not the pending values have been merged
+** yet.  The VDBE tests for values of earlier batches while inserting
+** those of a later one, and the values within a batch are distinct, so
+** this makes no difference to it.  The initial batch number is zero, so
+** if the very first TEST contains a non-zero batch number, it will see
+** all prior INSERTs.
 **
 ** No INSERTs may occurs after a SMALLEST.  An assertion will fail if
 ** that is attempted.
 **
-** The cost of an INSERT is roughly constant.  (Sometime new memory
-** has to be allocated on an INSERT.)  The cost of a TEST with a new
-** batch number is O(NlogN) where N is the number of elements in the RowSet.
-** The cost of a TEST using the same batch number is O(logN).  The cost
-** of the first SMALLEST is O(NlogN).  Second and subsequent SMALLEST
-** primitives are constant time.  The cost of DESTROY is O(N).
-**
-** There is an added cost of O(N) when switching between TEST and
-** SMALLEST primitives.
+** The amortized cost of an INSERT is O(logN), for sorting and merging
+** the pending values.  A merge takes time proportional to the number of
+** pending values plus the size of the main structure, so the pending
+** array is allowed to grow as large as the main structure before it is
+** merged.  The cost of a TEST with a new batch number is
+** that of a merge.  The cost of a TEST using the same batch number is
+** O(logN).  The cost of the first SMALLEST is that of a merge.  Second
+** and subsequent SMALLEST primitives are constant time, amortized over
+** the words of a bitmap.  The cost of DESTROY is proportional to the
+** number of containers.
 */
 #include "sqliteInt.h"
 
+/*
+** Pending values are merged into the containers when there are
+** ROWSET_PENDING_MIN of them.  That threshold doubles after each merge,
+** up to ROWSET_PENDING_MAX, so that a large RowSet is merged only
+** O(logN) times before the threshold stops growing.
+*/
+#define ROWSET_PENDING_MIN  1024
+#define ROWSET_PENDING_MAX  (1<<20)
 
 /*
-** Target size for allocation chunks.
+** The most values an array container may hold.  Above this a bitmap
+** container is no larger.
 */
-#define ROWSET_ALLOCATION_SIZE 1024
+#define ROWSET_ARRAY_MAX    4096
 
 /*
-** The number of rowset entries per allocation chunk.
+** The fewest values that share a container.  A smaller group is kept in
+** RowSet.aSparse[], where it takes less memory than a container of 24
+** bytes plus a separate allocation for the u16 array.
 */
-#define ROWSET_ENTRY_PER_CHUNK  \
-                       ((ROWSET_ALLOCATION_SIZE-8)/sizeof(struct RowSetEntry))
+#define ROWSET_SPARSE_MAX   8
 
 /*
-** Each entry in a RowSet is an instance of the following object.
-**
-** This same object is reused to store a linked list of trees of RowSetEntry
-** objects.  In that alternative use, pRight points to the next entry
-** in the list, pLeft points to the tree, and v is unused.  The
-** RowSet.pForest value points to the head of this forest list.
+** Number of u64 words in a bitmap container, and the value of
+** RowSetContainer.nAlloc that marks a bitmap container.
 */
-struct RowSetEntry {            
-  i64 v;                        /* ROWID value for this entry */
-  struct RowSetEntry *pRight;   /* Right subtree (larger entries) or list */
-  struct RowSetEntry *pLeft;    /* Left subtree (smaller entries) */
-};
+#define ROWSET_BITMAP_WORDS 1024
+#define ROWSET_BITMAP       (-1)
 
 /*
-** RowSetEntry objects are allocated in large chunks (instances of the
-** following structure) to reduce memory allocation overhead.  The
-** chunks are kept on a linked list so that they can be deallocated
-** when the RowSet is destroyed.
+** Split a rowid into the key of its container and the lower 16 bits
+** stored in the container, and join them back together.
 */
-struct RowSetChunk {
-  struct RowSetChunk *pNextChunk;        /* Next chunk on list of them all */
-  struct RowSetEntry aEntry[ROWSET_ENTRY_PER_CHUNK]; /* Allocated entries */
+#define rowSetKey(v)        ((v)>>16)
+#define rowSetLow(v)        ((u16)((v)&0xffff))
+#define rowSetValue(k,l)    ((i64)(((u64)(k)<<16)|(l)))
+
+/*
+** A container of the rowids that share the same upper 48 bits.
+*/
+struct RowSetContainer {
+  i64 iKey;                     /* rowSetKey() of every value */
+  int n;                        /* Number of values in the container */
+  int nAlloc;                   /* Slots in u.aLow[], or ROWSET_BITMAP */
+  union {
+    u16 *aLow;                  /* Sorted lower 16 bits of each value */
+    u64 *aBit;                  /* Bitmap of the lower 16 bits */
+  } u;
 };
 
 /*
@@ -105,13 +133,19 @@ struct RowSetChunk {
 ** A typedef of this structure if found in sqliteInt.h.
 */
 struct RowSet {
-  struct RowSetChunk *pChunk;    /* List of all chunk allocations */
   sqlite3 *db;                   /* The database connection */
-  struct RowSetEntry *pEntry;    /* List of entries using pRight */
-  struct RowSetEntry *pLast;     /* Last entry on the pEntry list */
-  struct RowSetEntry *pFresh;    /* Source of new entry objects */
-  struct RowSetEntry *pForest;   /* List of binary trees of entries */
-  u16 nFresh;                    /* Number of objects on pFresh */
+  i64 *aPend;                    /* Values not yet merged */
+  struct RowSetContainer *aCont; /* Containers in order of increasing iKey */
+  i64 *aSparse;                  /* Sorted values of keys with no container */
+  int nPend;                     /* Number of values in aPend[] */
+  int nPendAlloc;                /* Slots allocated for aPend[] */
+  int nPendMax;                  /* Merge when nPend reaches this */
+  int nCont;                     /* Number of entries in aCont[] */
+  int nContAlloc;                /* Slots allocated for aCont[] */
+  int nSparse;                   /* Number of values in aSparse[] */
+  int iCont;                     /* Container holding the next SMALLEST */
+  int iLow;                      /* Index or bit of the next SMALLEST */
+  int iSparse;                   /* Index in aSparse[] of the next SMALLEST */
   u8 rsFlags;                    /* Various flags */
   u8 iBatch;                     /* Current insert batch */
 };
@@ -119,7 +153,7 @@ struct RowSet {
 /*
 ** Allowed values for RowSet.rsFlags
 */
-#define ROWSET_SORTED  0x01   /* True if RowSet.pEntry is sorted */
+#define ROWSET_SORTED  0x01   /* True if RowSet.aPend is sorted */
 #define ROWSET_NEXT    0x02   /* True if sqlite3RowSetNext() has been called */
 
 /*
@@ -129,287 +163,328 @@ struct RowSet {
 ** Return a pointer to the new RowSet object.
 **
 ** It must be the case that N is sufficient to make a Rowset.  If not
-** an assertion fault occurs.
-** 
-** If N is larger than the minimum, use the surplus as an initial
-** allocation of entries available to be filled.
+** an assertion fault occurs.  Any surplus is unused.
 */
 RowSet *sqlite3RowSetInit(sqlite3 *db, void *pSpace, unsigned int N){
   RowSet *p;
   assert( N >= ROUND8(sizeof(*p)) );
+  UNUSED_PARAMETER(N);
   p = pSpace;
-  p->pChunk = 0;
+  memset(p, 0, sizeof(*p));
   p->db = db;
-  p->pEntry = 0;
-  p->pLast = 0;
-  p->pForest = 0;
-  p->pFresh = (struct RowSetEntry*)(ROUND8(sizeof(*p)) + (char*)p);
-  p->nFresh = (u16)((N - ROUND8(sizeof(*p)))/sizeof(struct RowSetEntry));
+  p->nPendMax = ROWSET_PENDING_MIN;
   p->rsFlags = ROWSET_SORTED;
-  p->iBatch = 0;
   return p;
 }
 
 /*
-** Deallocate all chunks from a RowSet.  This frees all memory that
+** Deallocate all memory held by a RowSet.  This frees all memory that
 ** the RowSet has allocated over its lifetime.  This routine is
 ** the destructor for the RowSet.
 */
 void sqlite3RowSetClear(RowSet *p){
-  struct RowSetChunk *pChunk, *pNextChunk;
-  for(pChunk=p->pChunk; pChunk; pChunk = pNextChunk){
-    pNextChunk = pChunk->pNextChunk;
-    sqlite3DbFree(p->db, pChunk);
+  int i;
+  for(i=0; i<p->nCont; i++){
+    sqlite3DbFree(p->db, p->aCont[i].u.aLow);
   }
-  p->pChunk = 0;
-  p->nFresh = 0;
-  p->pEntry = 0;
-  p->pLast = 0;
-  p->pForest = 0;
+  sqlite3DbFree(p->db, p->aCont);
+  sqlite3DbFree(p->db, p->aPend);
+  sqlite3DbFree(p->db, p->aSparse);
+  p->aCont = 0;
+  p->aPend = 0;
+  p->aSparse = 0;
+  p->nPend = 0;
+  p->nPendAlloc = 0;
+  p->nPendMax = ROWSET_PENDING_MIN;
+  p->nCont = 0;
+  p->nContAlloc = 0;
+  p->nSparse = 0;
+  p->iCont = 0;
+  p->iLow = 0;
+  p->iSparse = 0;
   p->rsFlags = ROWSET_SORTED;
 }
 
 /*
-** Allocate a new RowSetEntry object that is associated with the
-** given RowSet.  Return a pointer to the new and completely uninitialized
-** objected.
-**
-** In an OOM situation, the RowSet.db->mallocFailed flag is set and this
-** routine returns NULL.
+** Restore the heap property of the subtree of a[] rooted at a[i],
+** where a[] has n elements.
 */
-static struct RowSetEntry *rowSetEntryAlloc(RowSet *p){
-  assert( p!=0 );
-  if( p->nFresh==0 ){
-    struct RowSetChunk *pNew;
-    pNew = sqlite3DbMallocRaw(p->db, sizeof(*pNew));
-    if( pNew==0 ){
-      return 0;
-    }
-    pNew->pNextChunk = p->pChunk;
-    p->pChunk = pNew;
-    p->pFresh = pNew->aEntry;
-    p->nFresh = ROWSET_ENTRY_PER_CHUNK;
+static void rowSetSiftDown(i64 *a, int i, int n){
+  i64 v = a[i];
+  for(;;){
+    int c = i*2+1;
+    if( c>=n ) break;
+    if( c+1<n && a[c+1]>a[c] ) c++;
+    if( a[c]<=v ) break;
+    a[i] = a[c];
+    i = c;
   }
-  p->nFresh--;
-  return p->pFresh++;
+  a[i] = v;
 }
 
 /*
-** Insert a new value into a RowSet.
-**
-** The mallocFailed flag of the database connection is set if a
-** memory allocation fails.
+** Sort the n values in a[] into increasing order.  A heapsort is used
+** because it needs no extra memory and has no bad cases.
 */
-void sqlite3RowSetInsert(RowSet *p, i64 rowid){
-  struct RowSetEntry *pEntry;  /* The new entry */
-  struct RowSetEntry *pLast;   /* The last prior entry */
-
-  /* This routine is never called after sqlite3RowSetNext() */
-  assert( p!=0 && (p->rsFlags & ROWSET_NEXT)==0 );
+static void rowSetSort(i64 *a, int n){
+  int i;
+  for(i=n/2-1; i>=0; i--){
+    rowSetSiftDown(a, i, n);
+  }
+  for(i=n-1; i>0; i--){
+    i64 t = a[0];
+    a[0] = a[i];
+    a[i] = t;
+    rowSetSiftDown(a, 0, i);
+  }
+}
 
-  pEntry = rowSetEntryAlloc(p);
-  if( pEntry==0 ) return;
-  pEntry->v = rowid;
-  pEntry->pRight = 0;
-  pLast = p->pLast;
-  if( pLast ){
-    if( (p->rsFlags & ROWSET_SORTED)!=0 && rowid<=pLast->v ){
-      p->rsFlags &= ~ROWSET_SORTED;
-    }
-    pLast->pRight = pEntry;
-  }else{
-    p->pEntry = pEntry;
+/*
+** Change container pC from an array into a bitmap.
+*/
+static void rowSetToBitmap(RowSet *p, struct RowSetContainer *pC){
+  u64 *aBit;
+  int i;
+  assert( pC->nAlloc!=ROWSET_BITMAP );
+  aBit = sqlite3DbMallocZero(p->db, ROWSET_BITMAP_WORDS*sizeof(u64));
+  if( aBit==0 ) return;
+  for(i=0; i<pC->n; i++){
+    u16 x = pC->u.aLow[i];
+    aBit[x>>6] |= ((u64)1)<<(x&63);
   }
-  p->pLast = pEntry;
+  sqlite3DbFree(p->db, pC->u.aLow);
+  pC->u.aBit = aBit;
+  pC->nAlloc = ROWSET_BITMAP;
 }
 
 /*
-** Merge two lists of RowSetEntry objects.  Remove duplicates.
-**
-** The input lists are connected via pRight pointers and are 
-** assumed to each already be in sorted order.
+** Add the nVal values in aVal[] to container pC.  The values are sorted,
+** may contain duplicates, and all have the same key as pC.
 */
-static struct RowSetEntry *rowSetEntryMerge(
-  struct RowSetEntry *pA,    /* First sorted list to be merged */
-  struct RowSetEntry *pB     /* Second sorted list to be merged */
+static void rowSetContainerAdd(
+  RowSet *p,                    /* The RowSet that owns pC */
+  struct RowSetContainer *pC,   /* Container to add to */
+  const i64 *aVal,              /* Sorted values to add */
+  int nVal                      /* Number of entries in aVal[] */
 ){
-  struct RowSetEntry head;
-  struct RowSetEntry *pTail;
-
-  pTail = &head;
-  while( pA && pB ){
-    assert( pA->pRight==0 || pA->v<=pA->pRight->v );
-    assert( pB->pRight==0 || pB->v<=pB->pRight->v );
-    if( pA->v<pB->v ){
-      pTail->pRight = pA;
-      pA = pA->pRight;
-      pTail = pTail->pRight;
-    }else if( pB->v<pA->v ){
-      pTail->pRight = pB;
-      pB = pB->pRight;
-      pTail = pTail->pRight;
+  int nNew = 0;                 /* Values in aVal[] not already in pC */
+  int iA, iB, iOut;
+
+  if( pC->nAlloc!=ROWSET_BITMAP ){
+    /* Count the distinct values that are not already present */
+    for(iA=iB=0; iB<nVal; iB++){
+      u16 x = rowSetLow(aVal[iB]);
+      if( iB>0 && aVal[iB]==aVal[iB-1] ) continue;
+      while( iA<pC->n && pC->u.aLow[iA]<x ) iA++;
+      if( iA>=pC->n || pC->u.aLow[iA]!=x ) nNew++;
+    }
+    if( nNew==0 ) return;
+    if( pC->n+nNew>ROWSET_ARRAY_MAX ){
+      rowSetToBitmap(p, pC);
+      if( pC->nAlloc!=ROWSET_BITMAP ) return;
     }else{
-      pA = pA->pRight;
+      if( pC->n+nNew>pC->nAlloc ){
+        int nAlloc = pC->nAlloc*2;
+        u16 *aNew;
+        if( nAlloc<pC->n+nNew ) nAlloc = pC->n+nNew;
+        if( nAlloc>ROWSET_ARRAY_MAX ) nAlloc = ROWSET_ARRAY_MAX;
+        aNew = sqlite3DbRealloc(p->db, pC->u.aLow, nAlloc*sizeof(u16));
+        if( aNew==0 ) return;
+        pC->u.aLow = aNew;
+        pC->nAlloc = nAlloc;
+      }
+
+      /* Merge from the end so that the array can be updated in place */
+      iA = pC->n;
+      iB = nVal;
+      iOut = pC->n+nNew;
+      while( iB>0 ){
+        u16 x = rowSetLow(aVal[iB-1]);
+        if( iB>1 && aVal[iB-2]==aVal[iB-1] ){
+          iB--;
+        }else if( iA>0 && pC->u.aLow[iA-1]>x ){
+          pC->u.aLow[--iOut] = pC->u.aLow[--iA];
+        }else{
+          if( iA==0 || pC->u.aLow[iA-1]!=x ) pC->u.aLow[--iOut] = x;
+          iB--;
+        }
+      }
+      assert( iOut==iA );
+      pC->n += nNew;
+      return;
     }
   }
-  if( pA ){
-    assert( pA->pRight==0 || pA->v<=pA->pRight->v );
-    pTail->pRight = pA;
-  }else{
-    assert( pB==0 || pB->pRight==0 || pB->v<=pB->pRight->v );
-    pTail->pRight = pB;
-  }
-  return head.pRight;
-}
 
-/*
-** Sort all elements on the list of RowSetEntry objects into order of
-** increasing v.
-*/ 
-static struct RowSetEntry *rowSetEntrySort(struct RowSetEntry *pIn){
-  unsigned int i;
-  struct RowSetEntry *pNext, *aBucket[40];
-
-  memset(aBucket, 0, sizeof(aBucket));
-  while( pIn ){
-    pNext = pIn->pRight;
-    pIn->pRight = 0;
-    for(i=0; aBucket[i]; i++){
-      pIn = rowSetEntryMerge(aBucket[i], pIn);
-      aBucket[i] = 0;
+  for(iB=0; iB<nVal; iB++){
+    u16 x = rowSetLow(aVal[iB]);
+    u64 m = ((u64)1)<<(x&63);
+    if( (pC->u.aBit[x>>6] & m)==0 ){
+      pC->u.aBit[x>>6] |= m;
+      pC->n++;
     }
-    aBucket[i] = pIn;
-    pIn = pNext;
   }
-  pIn = 0;
-  for(i=0; i<sizeof(aBucket)/sizeof(aBucket[0]); i++){
-    pIn = rowSetEntryMerge(pIn, aBucket[i]);
-  }
-  return pIn;
 }
 
-
 /*
-** The input, pIn, is a binary tree (or subtree) of RowSetEntry objects.
-** Convert this tree into a linked list connected by the pRight pointers
-** and return pointers to the first and last elements of the new list.
+** Return the number of entries at the start of a[], which has n
+** entries, with key iKey.
 */
-static void rowSetTreeToList(
-  struct RowSetEntry *pIn,         /* Root of the input tree */
-  struct RowSetEntry **ppFirst,    /* Write head of the output list here */
-  struct RowSetEntry **ppLast      /* Write tail of the output list here */
-){
-  assert( pIn!=0 );
-  if( pIn->pLeft ){
-    struct RowSetEntry *p;
-    rowSetTreeToList(pIn->pLeft, ppFirst, &p);
-    p->pRight = pIn;
-  }else{
-    *ppFirst = pIn;
-  }
-  if( pIn->pRight ){
-    rowSetTreeToList(pIn->pRight, &pIn->pRight, ppLast);
-  }else{
-    *ppLast = pIn;
-  }
-  assert( (*ppLast)->pRight==0 );
+static int rowSetKeyRun(const i64 *a, int n, i64 iKey){
+  int i = 0;
+  while( i<n && rowSetKey(a[i])==iKey ) i++;
+  return i;
 }
 
-
 /*
-** Convert a sorted list of elements (connected by pRight) into a binary
-** tree with depth of iDepth.  A depth of 1 means the tree contains a single
-** node taken from the head of *ppList.  A depth of 2 means a tree with
-** three nodes.  And so forth.
-**
-** Use as many entries from the input list as required and update the
-** *ppList to point to the unused elements of the list.  If the input
-** list contains too few elements, then construct an incomplete tree
-** and leave *ppList set to NULL.
-**
-** Return a pointer to the root of the constructed binary tree.
+** Sort the pending values of p and merge them into its containers and
+** its sparse values.  A key that has a container keeps it.  A key that
+** has none gets one if it now has ROWSET_SPARSE_MAX or more values, and
+** otherwise its values stay in, or are added to, aSparse[].
 */
-static struct RowSetEntry *rowSetNDeepTree(
-  struct RowSetEntry **ppList,
-  int iDepth
-){
-  struct RowSetEntry *p;         /* Root of the new tree */
-  struct RowSetEntry *pLeft;     /* Left subtree */
-  if( *ppList==0 ){
-    return 0;
+static void rowSetMerge(RowSet *p){
+  i64 *a = p->aPend;
+  int n = p->nPend;
+  i64 *aOld = p->aSparse;       /* Sparse values before the merge */
+  int nOld = p->nSparse;
+  i64 *aSparse = 0;             /* Sparse values after the merge */
+  int nSparse = 0;
+  int nNew = 0;                 /* Keys given a new container */
+  int i, j, k, iS;
+
+  if( n==0 ) return;
+  p->nPend = 0;
+  if( p->nPendMax<ROWSET_PENDING_MAX ) p->nPendMax *= 2;
+  if( (p->rsFlags & ROWSET_SORTED)==0 ){
+    rowSetSort(a, n);
+    p->rsFlags |= ROWSET_SORTED;
   }
-  if( iDepth==1 ){
-    p = *ppList;
-    *ppList = p->pRight;
-    p->pLeft = p->pRight = 0;
-    return p;
+
+  /* Count the new containers and the values that will be sparse */
+  for(i=j=iS=0; i<n || iS<nOld; ){
+    i64 iKey = i<n ? rowSetKey(a[i]) : rowSetKey(aOld[iS]);
+    int nA, nS;
+    if( iS<nOld && rowSetKey(aOld[iS])<iKey ) iKey = rowSetKey(aOld[iS]);
+    nA = rowSetKeyRun(&a[i], n-i, iKey);
+    nS = rowSetKeyRun(&aOld[iS], nOld-iS, iKey);
+    i += nA;
+    iS += nS;
+    while( j<p->nCont && p->aCont[j].iKey<iKey ) j++;
+    if( j<p->nCont && p->aCont[j].iKey==iKey ){
+      assert( nS==0 );
+    }else if( nA+nS>=ROWSET_SPARSE_MAX ){
+      nNew++;
+    }else{
+      nSparse += nA+nS;
+    }
   }
-  pLeft = rowSetNDeepTree(ppList, iDepth-1);
-  p = *ppList;
-  if( p==0 ){
-    return pLeft;
+  if( p->nCont+nNew>p->nContAlloc ){
+    int nAlloc = (p->nCont+nNew)*2;
+    struct RowSetContainer *aNew;
+    aNew = sqlite3DbRealloc(p->db, p->aCont, nAlloc*sizeof(aNew[0]));
+    if( aNew==0 ) return;
+    p->aCont = aNew;
+    p->nContAlloc = nAlloc;
+  }
+  if( nSparse>0 ){
+    aSparse = sqlite3DbMallocRaw(p->db, nSparse*sizeof(i64));
+    if( aSparse==0 ) return;
   }
-  p->pLeft = pLeft;
-  *ppList = p->pRight;
-  p->pRight = rowSetNDeepTree(ppList, iDepth-1);
-  return p;
-}
 
-/*
-** Convert a sorted list of elements into a binary tree. Make the tree
-** as deep as it needs to be in order to contain the entire list.
-*/
-static struct RowSetEntry *rowSetListToTree(struct RowSetEntry *pList){
-  int iDepth;           /* Depth of the tree so far */
-  struct RowSetEntry *p;       /* Current tree root */
-  struct RowSetEntry *pLeft;   /* Left subtree */
-
-  assert( pList!=0 );
-  p = pList;
-  pList = p->pRight;
-  p->pLeft = p->pRight = 0;
-  for(iDepth=1; pList; iDepth++){
-    pLeft = p;
-    p = pList;
-    pList = p->pRight;
-    p->pLeft = pLeft;
-    p->pRight = rowSetNDeepTree(&pList, iDepth);
+  /* Build the new aSparse[] from the keys that have too few values for
+  ** a container, dropping duplicates */
+  nSparse = 0;
+  for(i=j=iS=0; i<n || iS<nOld; ){
+    i64 iKey = i<n ? rowSetKey(a[i]) : rowSetKey(aOld[iS]);
+    int nA, nS;
+    if( iS<nOld && rowSetKey(aOld[iS])<iKey ) iKey = rowSetKey(aOld[iS]);
+    nA = rowSetKeyRun(&a[i], n-i, iKey);
+    nS = rowSetKeyRun(&aOld[iS], nOld-iS, iKey);
+    while( j<p->nCont && p->aCont[j].iKey<iKey ) j++;
+    if( (j>=p->nCont || p->aCont[j].iKey!=iKey) && nA+nS<ROWSET_SPARSE_MAX ){
+      int iA = i, iB = iS;
+      while( iA<i+nA || iB<iS+nS ){
+        i64 v;
+        if( iB>=iS+nS || (iA<i+nA && a[iA]<aOld[iB]) ){
+          v = a[iA++];
+        }else{
+          v = aOld[iB++];
+        }
+        if( nSparse==0 || aSparse[nSparse-1]!=v ) aSparse[nSparse++] = v;
+      }
+    }
+    i += nA;
+    iS += nS;
   }
-  return p;
+
+  /* Merge from the end so that aCont[] can be updated in place */
+  i = n;
+  iS = nOld;
+  j = p->nCont;
+  k = p->nCont+nNew;
+  while( i>0 || iS>0 ){
+    i64 iKey = i>0 ? rowSetKey(a[i-1]) : rowSetKey(aOld[iS-1]);
+    int iFirst = i;
+    int iFirstS = iS;
+    if( iS>0 && rowSetKey(aOld[iS-1])>iKey ) iKey = rowSetKey(aOld[iS-1]);
+    while( iFirst>0 && rowSetKey(a[iFirst-1])==iKey ) iFirst--;
+    while( iFirstS>0 && rowSetKey(aOld[iFirstS-1])==iKey ) iFirstS--;
+    while( j>0 && p->aCont[j-1].iKey>iKey ){
+      p->aCont[--k] = p->aCont[--j];
+    }
+    if( j>0 && p->aCont[j-1].iKey==iKey ){
+      p->aCont[--k] = p->aCont[--j];
+    }else if( (i-iFirst)+(iS-iFirstS)>=ROWSET_SPARSE_MAX ){
+      struct RowSetContainer *pNew = &p->aCont[--k];
+      pNew->iKey = iKey;
+      pNew->n = 0;
+      pNew->nAlloc = 0;
+      pNew->u.aLow = 0;
+      rowSetContainerAdd(p, pNew, &aOld[iFirstS], iS-iFirstS);
+    }else{
+      i = iFirst;
+      iS = iFirstS;
+      continue;
+    }
+    rowSetContainerAdd(p, &p->aCont[k], &a[iFirst], i-iFirst);
+    i = iFirst;
+    iS = iFirstS;
+  }
+  assert( j==k );
+  p->nCont += nNew;
+  sqlite3DbFree(p->db, aOld);
+  p->aSparse = aSparse;
+  p->nSparse = nSparse;
+
+  /* A merge costs time in proportion to the size of the main structure,
+  ** so let at least as many values as that collect before the next one */
+  if( p->nPendMax<p->nCont+p->nSparse ) p->nPendMax = p->nCont+p->nSparse;
 }
 
 /*
-** Take all the entries on p->pEntry and on the trees in p->pForest and
-** sort them all together into one big ordered list on p->pEntry.
+** Insert a new value into a RowSet.
 **
-** This routine should only be called once in the life of a RowSet.
+** The mallocFailed flag of the database connection is set if a
+** memory allocation fails.
 */
-static void rowSetToList(RowSet *p){
-
-  /* This routine is called only once */
+void sqlite3RowSetInsert(RowSet *p, i64 rowid){
+  /* This routine is never called after sqlite3RowSetNext() */
   assert( p!=0 && (p->rsFlags & ROWSET_NEXT)==0 );
 
-  if( (p->rsFlags & ROWSET_SORTED)==0 ){
-    p->pEntry = rowSetEntrySort(p->pEntry);
-  }
-
-  /* While this module could theoretically support it, sqlite3RowSetNext()
-  ** is never called after sqlite3RowSetText() for the same RowSet.  So
-  ** there is never a forest to deal with.  Should this change, simply
-  ** remove the assert() and the #if 0. */
-  assert( p->pForest==0 );
-#if 0
-  while( p->pForest ){
-    struct RowSetEntry *pTree = p->pForest->pLeft;
-    if( pTree ){
-      struct RowSetEntry *pHead, *pTail;
-      rowSetTreeToList(pTree, &pHead, &pTail);
-      p->pEntry = rowSetEntryMerge(p->pEntry, pHead);
+  if( p->nPend>=p->nPendAlloc ){
+    if( p->nPend>=p->nPendMax ){
+      rowSetMerge(p);
+    }else{
+      int nNew = p->nPendAlloc ? p->nPendAlloc*2 : 64;
+      i64 *aNew = sqlite3DbRealloc(p->db, p->aPend, nNew*sizeof(i64));
+      if( aNew==0 ) return;
+      p->aPend = aNew;
+      p->nPendAlloc = nNew;
     }
-    p->pForest = p->pForest->pRight;
   }
-#endif
-  p->rsFlags |= ROWSET_NEXT;  /* Verify this routine is never called again */
+  if( p->nPend>0 && rowid<=p->aPend[p->nPend-1] ){
+    p->rsFlags &= ~ROWSET_SORTED;
+  }
+  p->aPend[p->nPend++] = rowid;
 }
 
 /*
@@ -418,91 +493,129 @@ static void rowSetToList(RowSet *p){
 ** 0 if the RowSet is already empty.
 **
 ** After this routine has been called, the sqlite3RowSetInsert()
-** routine may not be called again.  
+** routine may not be called again.
 */
 int sqlite3RowSetNext(RowSet *p, i64 *pRowid){
   assert( p!=0 );
 
-  /* Merge the forest into a single sorted list on first call */
-  if( (p->rsFlags & ROWSET_NEXT)==0 ) rowSetToList(p);
+  /* Merge the pending values into the containers on first call */
+  if( (p->rsFlags & ROWSET_NEXT)==0 ){
+    rowSetMerge(p);
+    p->rsFlags |= ROWSET_NEXT;
+  }
+
+  for(;;){
+    struct RowSetContainer *pC = p->iCont<p->nCont ? &p->aCont[p->iCont] : 0;
 
-  /* Return the next entry on the list */
-  if( p->pEntry ){
-    *pRowid = p->pEntry->v;
-    p->pEntry = p->pEntry->pRight;
-    if( p->pEntry==0 ){
-      sqlite3RowSetClear(p);
+    /* Sparse values lie between containers, as their keys differ */
+    if( p->iSparse<p->nSparse
+     && (pC==0 || rowSetKey(p->aSparse[p->iSparse])<pC->iKey)
+    ){
+      *pRowid = p->aSparse[p->iSparse++];
+      return 1;
     }
-    return 1;
-  }else{
-    return 0;
+    if( pC==0 ) break;
+    if( pC->nAlloc==ROWSET_BITMAP ){
+      while( p->iLow<ROWSET_BITMAP_WORDS*64 ){
+        u64 w = pC->u.aBit[p->iLow>>6] >> (p->iLow&63);
+        if( w==0 ){
+          p->iLow = (p->iLow|63)+1;
+        }else{
+          while( (w&1)==0 ){
+            w >>= 1;
+            p->iLow++;
+          }
+          *pRowid = rowSetValue(pC->iKey, p->iLow);
+          p->iLow++;
+          return 1;
+        }
+      }
+    }else if( p->iLow<pC->n ){
+      *pRowid = rowSetValue(pC->iKey, pC->u.aLow[p->iLow]);
+      p->iLow++;
+      return 1;
+    }
+
+    /* This container has been read through.  Release its memory now,
+    ** as very large sets are read in DELETE and UPDATE. */
+    sqlite3DbFree(p->db, pC->u.aLow);
+    pC->u.aLow = 0;
+    p->iCont++;
+    p->iLow = 0;
   }
+  sqlite3RowSetClear(p);
+  return 0;
 }
 
 /*
 ** Check to see if element iRowid was inserted into the rowset as
 ** part of any insert batch prior to iBatch.  Return 1 or 0.
 **
-** If this is the first test of a new batch and if there exist entires
-** on pRowSet->pEntry, then sort those entires into the forest at
-** pRowSet->pForest so that they can be tested.
+** If this is the first test of a new batch, merge the pending values
+** into the containers so that they can be tested.
 */
 int sqlite3RowSetTest(RowSet *pRowSet, u8 iBatch, sqlite3_int64 iRowid){
-  struct RowSetEntry *p, *pTree;
+  i64 iKey = rowSetKey(iRowid);
+  u16 x = rowSetLow(iRowid);
+  struct RowSetContainer *pC;
+  int lo, hi;
 
   /* This routine is never called after sqlite3RowSetNext() */
   assert( pRowSet!=0 && (pRowSet->rsFlags & ROWSET_NEXT)==0 );
 
-  /* Sort entries into the forest on the first test of a new batch 
-  */
   if( iBatch!=pRowSet->iBatch ){
-    p = pRowSet->pEntry;
-    if( p ){
-      struct RowSetEntry **ppPrevTree = &pRowSet->pForest;
-      if( (pRowSet->rsFlags & ROWSET_SORTED)==0 ){
-        p = rowSetEntrySort(p);
-      }
-      for(pTree = pRowSet->pForest; pTree; pTree=pTree->pRight){
-        ppPrevTree = &pTree->pRight;
-        if( pTree->pLeft==0 ){
-          pTree->pLeft = rowSetListToTree(p);
-          break;
-        }else{
-          struct RowSetEntry *pAux, *pTail;
-          rowSetTreeToList(pTree->pLeft, &pAux, &pTail);
-          pTree->pLeft = 0;
-          p = rowSetEntryMerge(pAux, p);
-        }
-      }
-      if( pTree==0 ){
-        *ppPrevTree = pTree = rowSetEntryAlloc(pRowSet);
-        if( pTree ){
-          pTree->v = 0;
-          pTree->pRight = 0;
-          pTree->pLeft = rowSetListToTree(p);
-        }
-      }
-      pRowSet->pEntry = 0;
-      pRowSet->pLast = 0;
-      pRowSet->rsFlags |= ROWSET_SORTED;
-    }
+    rowSetMerge(pRowSet);
     pRowSet->iBatch = iBatch;
   }
 
-  /* Test to see if the iRowid value appears anywhere in the forest.
-  ** Return 1 if it does and 0 if not.
-  */
-  for(pTree = pRowSet->pForest; pTree; pTree=pTree->pRight){
-    p = pTree->pLeft;
-    while( p ){
-      if( p->v<iRowid ){
-        p = p->pRight;
-      }else if( p->v>iRowid ){
-        p = p->pLeft;
+  /* Find the container for iRowid */
+  lo = 0;
+  hi = pRowSet->nCont-1;
+  pC = 0;
+  while( lo<=hi ){
+    int mid = (lo+hi)/2;
+    if( pRowSet->aCont[mid].iKey<iKey ){
+      lo = mid+1;
+    }else if( pRowSet->aCont[mid].iKey>iKey ){
+      hi = mid-1;
+    }else{
+      pC = &pRowSet->aCont[mid];
+      break;
+    }
+  }
+  if( pC==0 ){
+    lo = 0;
+    hi = pRowSet->nSparse-1;
+    while( lo<=hi ){
+      int mid = (lo+hi)/2;
+      if( pRowSet->aSparse[mid]<iRowid ){
+        lo = mid+1;
+      }else if( pRowSet->aSparse[mid]>iRowid ){
+        hi = mid-1;
       }else{
         return 1;
       }
     }
+    return 0;
+  }
+
+  /* Test to see if the lower bits of iRowid appear in the container.
+  ** Return 1 if they do and 0 if not.
+  */
+  if( pC->nAlloc==ROWSET_BITMAP ){
+    return (int)((pC->u.aBit[x>>6] >> (x&63)) & 1);
+  }
+  lo = 0;
+  hi = pC->n-1;
+  while( lo<=hi ){
+    int mid = (lo+hi)/2;
+    if( pC->u.aLow[mid]<x ){
+      lo = mid+1;
+    }else if( pC->u.aLow[mid]>x ){
+      hi = mid-1;
+    }else{
+      return 1;
+    }
   }
   return 0;
 }
@@ -4451,6 +4451,10 @@ int sqlite3Select(
   if( !isAgg && pGroupBy==0 ){
     ExprList *pDist = (isDistinct ? p->pEList : 0);
 
+    /* Evaluate constant subexpressions of the result set once, rather
+    ** than once for each row. */
+    sqlite3ExprListCodeConstants(pParse, pEList);
+
     /* Begin the database scan. 
 	**开始数据库扫描
 	*/
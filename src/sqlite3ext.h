@@ -236,6 +236,9 @@ struct sqlite3_api_routines {
   int (*blob_reopen)(sqlite3_blob*,sqlite3_int64);
   int (*vtab_config)(sqlite3*,int op,...);
   int (*vtab_on_conflict)(sqlite3*);
+  int (*step_batch)(sqlite3_stmt*,int,sqlite3_batch_column*,int*);
+  int (*execute_batch)(sqlite3_stmt*,int,int,const sqlite3_batch_column*,
+                       int*);
 };
 
 /*
@@ -439,6 +442,8 @@ struct sqlite3_api_routines {
 #define sqlite3_blob_reopen            sqlite3_api->blob_reopen
 #define sqlite3_vtab_config            sqlite3_api->vtab_config
 #define sqlite3_vtab_on_conflict       sqlite3_api->vtab_on_conflict
+#define sqlite3_step_batch             sqlite3_api->step_batch
+#define sqlite3_execute_batch          sqlite3_api->execute_batch
 #endif /* SQLITE_CORE */
 
 #define SQLITE_EXTENSION_INIT1     const sqlite3_api_routines *sqlite3_api = 0;
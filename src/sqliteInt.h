@@ -652,9 +652,12 @@ typedef struct FuncDefHash FuncDefHash;
 typedef struct IdList IdList;
 typedef struct Index Index;
 typedef struct IndexSample IndexSample;
+typedef struct IndexedExpr IndexedExpr;
 typedef struct KeyClass KeyClass;
 typedef struct KeyInfo KeyInfo;
 typedef struct Lookaside Lookaside;
+typedef struct LookasideChunk LookasideChunk;
+typedef struct LookasideClass LookasideClass;
 typedef struct LookasideSlot LookasideSlot;
 typedef struct Module Module;
 typedef struct NameContext NameContext;
@@ -794,17 +797,50 @@ struct Schema {
 ** is shared by multiple database connections.  Therefore, while parsing
 ** schema information, the Lookaside.bEnabled flag is cleared so that
 ** lookaside allocations are not used to construct the schema objects. //因此，当解析模式信息时，Lookaside.bEnabled标志将会被清除，来保证后备内存分配不会被用来构建模式对象。
-*/
+**
+** The lookaside memory is cut into chunks of Lookaside.sz bytes, each
+** holding buffers of one of up to LOOKASIDE_NCLASS size classes.  The
+** LookasideChunk objects that record the class of each chunk follow the
+** last chunk, at Lookaside.pEnd.  A request is served from the smallest
+** class that fits it, or from a larger class if that one is empty.
+** After SQLITE_LOOKASIDE_ADAPT full misses, sqlite3LookasideAdapt()
+** moves chunks that have no buffers checked out to the classes in most
+** demand.  If the miss rate was high, the memory is also grown, up to
+** mxByte bytes, the next time no buffers at all are checked out.
+*/
+#define LOOKASIDE_NCLASS 4
+#ifndef SQLITE_LOOKASIDE_ADAPT
+# define SQLITE_LOOKASIDE_ADAPT 64
+#endif
+struct LookasideClass {
+  u16 sz;                 /* Size of each buffer in this class */
+  u16 nPer;               /* Buffers per chunk */
+  u32 nReq;               /* Requests best fit by this class since layout */
+  int nChunk;             /* Chunks assigned to this class */
+  LookasideSlot *pFree;   /* List of available buffers of this class */
+};
+struct LookasideChunk {
+  u8 iClass;              /* Index in aClass[], or LOOKASIDE_NCLASS if none */
+  u8 bMoved;              /* True while being given to a new class */
+  u16 nFree;              /* Free buffers, counted by sqlite3LookasideAdapt() */
+};
 struct Lookaside {
-  u16 sz;                 /* Size of each buffer in bytes , u16是sqlite内部自定义的一个类型，即是UINT16_TYPE，2-byte unsigned integer，两字节的无符号整数，sz代表每一个缓冲区的大小，即其所包含的字节数。*/
+  u16 sz;                 /* Size of the largest buffer in bytes , u16是sqlite内部自定义的一个类型，即是UINT16_TYPE，2-byte unsigned integer，两字节的无符号整数，sz代表每一个缓冲区的大小，即其所包含的字节数。*/
   u8 bEnabled;            /* False to disable new lookaside allocations , bEnabled是一个标志位，占用两个字节的无符号整数，表示可以进行新的后备内存区的分配。*/
   u8 bMalloced;           /* True if pStart obtained from sqlite3_malloc()  如果有足够的后备内存区，则bMalloced的值即为真。 */
+  u8 nClass;              /* Number of entries in aClass[] in use */
+  u8 bGrow;               /* Grow the memory once nOut reaches zero */
   int nOut;               /* Number of buffers currently checked out 当前已知的缓冲区数量。 */
   int mxOut;              /* Highwater mark for nOut nOut的最大标记? */
   int anStat[3];          /* 0: hits.  1: size misses.  2: full misses   */
-  LookasideSlot *pFree;   /* List of available buffers  可用缓冲区列表*/
+  int nMiss;              /* Full misses since the last layout */
+  int nByte;              /* Bytes of memory at pStart */
+  int mxByte;             /* Largest size pStart may grow to */
+  int nChunk;             /* Number of chunks */
+  LookasideChunk *aChunk; /* One entry per chunk, stored at pEnd */
   void *pStart;           /* First byte of available memory space  可用内存空间的第一个字节*/
   void *pEnd;             /* First byte past end of available space 可用空间后的首个字节*/
+  LookasideClass aClass[LOOKASIDE_NCLASS];  /* Size classes, smallest first */
 };
 struct LookasideSlot {
   LookasideSlot *pNext;    /* Next buffer in the list of free buffers , pNext是一个LookasideSlot结构体类型的指针，指向的是空间缓冲区列表中的下一个缓冲区。*/
@@ -815,9 +851,12 @@ struct LookasideSlot {
 **
 ** Hash each FuncDef structure into one of the FuncDefHash.a[] slots.
 ** Collisions are on the FuncDef.pHash chain. //将每个FuncDef结构散列进FuncDefHash.a[]槽中，在FuncDef.pHash链上存在碰撞。
+** The slot is chosen by SQLITE_FUNC_HASH() of the function name.
 */
+#define SQLITE_FUNC_HASH_SZ 64
+#define SQLITE_FUNC_HASH(z,n) (sqlite3StrIHash(z,n) & (SQLITE_FUNC_HASH_SZ-1))
 struct FuncDefHash {
-  FuncDef *a[23];       /* Hash table for functions 函数的哈希表*/
+  FuncDef *a[SQLITE_FUNC_HASH_SZ];  /* Hash table for functions 函数的哈希表*/
 };
 
 /*
@@ -1006,7 +1045,7 @@ struct sqlite3 {
 struct FuncDef {
   i16 nArg;            /* Number of arguments.  -1 means unlimited 参数的数量，1表示无限制*/
   u8 iPrefEnc;         /* Preferred text encoding (SQLITE_UTF8, 16LE, 16BE) 所选择的文本编码方式*/
-  u8 flags;            /* Some combination of SQLITE_FUNC_* ， SQLITE_FUNC_*的某种组合*/
+  u16 flags;           /* Some combination of SQLITE_FUNC_* ， SQLITE_FUNC_*的某种组合*/
   void *pUserData;     /* User data parameter 用户数据参数*/
   FuncDef *pNext;      /* Next function with same name 重名的下一个函数*/
   void (*xFunc)(sqlite3_context*,int,sqlite3_value**); /* Regular function 常规功能*/
@@ -1056,6 +1095,8 @@ FuncDef.flags的可能的值。需要注意的是_length和_TYPEOF值必须与OP
 #define SQLITE_FUNC_COALESCE 0x20 /* Built-in coalesce() or ifnull() function 内置coalesce()或ifnull()函数*/
 #define SQLITE_FUNC_LENGTH   0x40 /* Built-in length() function 内置length()函数*/
 #define SQLITE_FUNC_TYPEOF   0x80 /* Built-in typeof() function 内置typeof()函数*/
+#define SQLITE_FUNC_CONSTANT 0x100 /* Same arguments always give same result */
+#define SQLITE_FUNC_NOERROR  0x200 /* Cannot fail, other than by OOM */
 
 /*
 ** The following three macros, FUNCTION(), LIKEFUNC() and AGGREGATE() are
@@ -1068,6 +1109,9 @@ FuncDef.flags的可能的值。需要注意的是_length和_TYPEOF值必须与OP
 **     value passed as iArg is cast to a (void*) and made available
 **     as the user-data (sqlite3_user_data()) for the function. If 
 **     argument bNC is true, then the SQLITE_FUNC_NEEDCOLL flag is set.
+**     The function is marked SQLITE_FUNC_CONSTANT so that repeated calls
+**     on the same row can share one result, and SQLITE_FUNC_NOERROR so
+**     that calls with constant arguments can be factored out of loops.
 **FUNCTION(zName, nArg, iArg, bNC, xFunc)创建了功能zName的标量函数定义，zName函数由接受nArg参数的C函数xFunc来实现.
 **作为iArg参数被传递的值被转换成无类型，并且通过函数sqlite3_user_data()成为函数可以使用的用户数据.
 **若参数bNC 为真，那么将会设置SQLITE_FUNC_NEEDCOLL标志的值.
@@ -1091,12 +1135,29 @@ FuncDef.flags的可能的值。需要注意的是_length和_TYPEOF值必须与OP
 **参数pArg被转换成一个无类型数据，后通过函数sqlite3_user_data()转换成用户可利用的数据.
 **FuncDef.flags变量被设置为传递的标志参数的值.
 **
+**   VFUNCTION(zName, nArg, iArg, bNC, xFunc)
+**     Like FUNCTION(), but for a function whose result may differ between
+**     two calls with the same arguments, such as random() or changes().
+**
+**   EFUNCTION(zName, nArg, iArg, bNC, xFunc)
+**     Like FUNCTION(), but for a function that can raise an error for some
+**     arguments, such as abs() or zeroblob().  A call is not factored out
+**     of a loop, as the error must not be raised unless the call is
+**     actually reached.
 */
 #define FUNCTION(zName, nArg, iArg, bNC, xFunc) \
+  {nArg, SQLITE_UTF8, \
+   (bNC*SQLITE_FUNC_NEEDCOLL)|SQLITE_FUNC_CONSTANT|SQLITE_FUNC_NOERROR, \
+   SQLITE_INT_TO_PTR(iArg), 0, xFunc, 0, 0, #zName, 0, 0}
+#define EFUNCTION(zName, nArg, iArg, bNC, xFunc) \
+  {nArg, SQLITE_UTF8, (bNC*SQLITE_FUNC_NEEDCOLL)|SQLITE_FUNC_CONSTANT, \
+   SQLITE_INT_TO_PTR(iArg), 0, xFunc, 0, 0, #zName, 0, 0}
+#define VFUNCTION(zName, nArg, iArg, bNC, xFunc) \
   {nArg, SQLITE_UTF8, (bNC*SQLITE_FUNC_NEEDCOLL), \
    SQLITE_INT_TO_PTR(iArg), 0, xFunc, 0, 0, #zName, 0, 0}
 #define FUNCTION2(zName, nArg, iArg, bNC, xFunc, extraFlags) \
-  {nArg, SQLITE_UTF8, (bNC*SQLITE_FUNC_NEEDCOLL)|extraFlags, \
+  {nArg, SQLITE_UTF8, (bNC*SQLITE_FUNC_NEEDCOLL)|SQLITE_FUNC_CONSTANT| \
+   SQLITE_FUNC_NOERROR|extraFlags, \
    SQLITE_INT_TO_PTR(iArg), 0, xFunc, 0, 0, #zName, 0, 0}
 #define STR_FUNCTION(zName, nArg, pArg, bNC, xFunc) \
   {nArg, SQLITE_UTF8, bNC*SQLITE_FUNC_NEEDCOLL, \
@@ -1582,6 +1643,12 @@ struct UnpackedRecord {
 ** first column to be indexed (c3) has an index of 2 in Ex1.aCol[].
 ** The second column to be indexed (c1) has an index of 0 in
 ** Ex1.aCol[], hence Ex2.aiColumn[1]==0.
+**
+** An index column may also be an expression over the columns of the
+** table, as in "CREATE INDEX Ex3 ON Ex1(c1+c2)".  Such a column has
+** aiColumn[] set to XN_EXPR and the expression itself is stored in the
+** corresponding slot of Index.aColExpr.  TK_COLUMN nodes within the
+** expression have iTable==-1, the same as for CHECK constraints.
 **在所描述的表结构Ex1中，nCol的值为3，因为在该表中存在三列.
 **在所描述的索引结构Ex2中,当Ex1中三列中由两列被索引了之后，nColumn的值为2.
 **aiColumn数组的值为{2, 0}. aiColumn[0]的值为2，因为被索引的第一列c3在Ex1.aCol[]中的下标为2.
@@ -1610,6 +1677,7 @@ struct Index {
   Schema *pSchema; /* Schema containing this index 含有这种索引的模式*/
   u8 *aSortOrder;  /* Array of size Index.nColumn. True==DESC, False==ASC , Index.nColumn长度的数组，True==DESC, False==ASC*/
   char **azColl;   /* Array of collation sequence names for index 为索引名字进行排序的排序序列数组*/
+  ExprList *aColExpr; /* Expressions for XN_EXPR columns, or NULL */
   int nColumn;     /* Number of columns in the table used by this index 通过该索引使用的表的列数*/
   int tnum;        /* Page containing root of this index in database file 在数据库文件中包含该索引的根的页*/
   u8 onError;      /* OE_Abort, OE_Ignore, OE_Replace, or OE_None */
@@ -1622,6 +1690,27 @@ struct Index {
 #endif
 };
 
+/*
+** While the body of a WHERE loop that scans an index with expression
+** columns is being coded, each such column is described by an instance
+** of this structure on the Parse.pIdxExpr list, so that the expression
+** is read back from the index instead of being computed again.
+*/
+struct IndexedExpr {
+  Expr *pExpr;             /* The index expression.  Owned by the Index */
+  int iDataCur;            /* Cursor of the table the expression reads */
+  int iIdxCur;             /* Cursor of the index */
+  int iIdxCol;             /* Column of the index that holds the value */
+  IndexedExpr *pIENext;    /* Next entry in the list */
+};
+
+/*
+** Special value for Index.aiColumn[] and WhereTerm.u.leftColumn meaning
+** the column is an expression held in Index.aColExpr rather than a
+** column of the table.  The value -1 is already taken by the rowid.
+*/
+#define XN_EXPR      (-2)
+
 /*
 ** Each sample stored in the sqlite_stat3 table is represented in memory 
 ** using a structure of this type.  See documentation at the top of the
@@ -1858,6 +1947,8 @@ struct Expr {
 */
 #define EP2_MallocedToken  0x0001  /* Need to sqlite3DbFree() Expr.zToken */
 #define EP2_Irreducible    0x0002  /* Cannot EXPRDUP_REDUCE this Expr */
+#define EP2_Constant       0x0004  /* Function is SQLITE_FUNC_CONSTANT */
+#define EP2_NoError        0x0008  /* Function is SQLITE_FUNC_NOERROR */
 
 /*
 ** The pseudo-routine sqlite3ExprSetIrreducible sets the EP2_Irreducible	伪例程sqlite3ExprSetlrreducible通过表达式结构来设置EP2_Irreducible标志
@@ -2127,6 +2218,7 @@ struct WhereInfo {
   struct WhereClause *pWC;       /* Decomposition of the WHERE clause 		分解WHERE子句*/
   double savedNQueryLoop;        /* pParse->nQueryLoop outside the WHERE loop 	外循环之外pParse->nQueryLoop*/
   double nRowOut;                /* Estimated number of output rows 		输出行的估计数*/
+  IndexedExpr *pSavedIdxExpr;    /* Parse.pIdxExpr before this loop began */
   WhereLevel a[1];               /* Information about each nest loop in WHERE 	WHERE中每个嵌套循环的信息*/
 };
 
@@ -2172,6 +2264,7 @@ struct NameContext {
 #define NC_HasAgg    0x02    /* One or more aggregate functions seen 		一个或多个聚合函数可见*/
 #define NC_IsCheck   0x04    /* True if resolving names in a CHECK constraint 	在CHECK约束中解析名称为真*/
 #define NC_InAggFunc 0x08    /* True if analyzing arguments to an agg func 	如果分析参数*/
+#define NC_IdxExpr   0x10    /* True if resolving names in an index expression */
 
 /*
 ** An instance of the following structure contains all information		以下结构的一个实例包含需要生成代码的一个SELECT语句的所有信息
@@ -2365,6 +2458,7 @@ struct Parse {
     int iLevel;           /* Nesting level 					嵌套层次*/
     int iReg;             /* Reg with value of this column. 0 means none. 	保存这个column.0的寄存器表示空*/
     int lru;              /* Least recently used entry has the smallest value 	最近最少使用条目的最小值*/
+    Expr *pExpr;          /* Cached function call, or NULL for a table column */
   } aColCache[SQLITE_N_COLCACHE];  /* One for each column cache entry 		一个用于每列缓存条目*/
   yDbMask writeMask;   /* Start a write transaction on these databases 		开始对这些数据库进行写事务*/
   yDbMask cookieMask;  /* Bitmask of schema verified databases 			位掩码模式验证数据库*/
@@ -2379,6 +2473,12 @@ struct Parse {
   TableLock *aTableLock; /* Required table locks for shared-cache mode 		要求表的共享缓存模式的锁*/
 #endif
   AutoincInfo *pAinc;  /* Information about AUTOINCREMENT counters 		有关AUTOINCREMENT计数器的信息*/
+  int nConstExpr;      /* Number of entries in aConstExpr[] */
+  struct ParseConst {
+    Expr *pExpr;         /* Copy of a constant expression */
+    int iReg;            /* Register holding its value */
+  } *aConstExpr;       /* Constants evaluated once by the init code */
+  IndexedExpr *pIdxExpr; /* Expressions readable from open index cursors */
 
   /* Information used while coding trigger programs. 				当编码触发程序时使用的信息*/
   Parse *pToplevel;    /* Parse structure for main program (or NULL) 		解析主程序的结构(或空)*/
@@ -2421,6 +2521,7 @@ struct Parse {
 #endif
   Table *pZombieTab;        /* List of Table objects to delete after code gen 	代码生成后删除表对象列表*/
   TriggerPrg *pTriggerPrg;  /* Linked list of coded triggers 			编码触发器链表*/
+  ExprList *pLitList;       /* List for the pending LITLIST token 		待处理LITLIST符号的列表*/
 };
 
 /*
@@ -2747,6 +2848,8 @@ void *sqlite3Realloc(void*, int);
 void *sqlite3DbReallocOrFree(sqlite3 *, void *, int);
 void *sqlite3DbRealloc(sqlite3 *, void *, int);
 void sqlite3DbFree(sqlite3*, void*);
+void sqlite3LookasideInit(sqlite3*);
+void sqlite3LookasideAdapt(sqlite3*);
 int sqlite3MallocSize(void*);
 int sqlite3DbMallocSize(sqlite3*, void*);
 void *sqlite3ScratchMalloc(int);
@@ -2783,6 +2886,9 @@ const sqlite3_mem_methods *sqlite3MemGetMemsys3(void);
 #ifdef SQLITE_ENABLE_MEMSYS5
 const sqlite3_mem_methods *sqlite3MemGetMemsys5(void);
 #endif
+#ifdef SQLITE_ENABLE_MEMSYS6
+const sqlite3_mem_methods *sqlite3MemGetMemsys6(void);
+#endif
 
 
 #ifndef SQLITE_MUTEX_OMIT
@@ -2791,6 +2897,28 @@ const sqlite3_mem_methods *sqlite3MemGetMemsys5(void);
   sqlite3_mutex *sqlite3MutexAlloc(int);
   int sqlite3MutexInit(void);
   int sqlite3MutexEnd(void);
+  void sqlite3MutexContended(int, int);
+  void sqlite3MutexWaitStatus(int, int*, int*, int);
+#endif
+
+/*
+** Number of mutex types, SQLITE_MUTEX_FAST through SQLITE_MUTEX_STATIC_LRU2,
+** for which contention is counted.
+*/
+#define SQLITE_MUTEX_NTYPE 8
+
+/*
+** SQLITE_STATUS_LOCKFREE is true if the sqlite3_status() counters are
+** kept with atomic instructions, so that sqlite3StatusAdd() and
+** sqlite3StatusSet() may be called without holding any mutex.
+*/
+#ifndef SQLITE_STATUS_LOCKFREE
+# if SQLITE_THREADSAFE && defined(__GNUC__) \
+      && (__GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=7))
+#  define SQLITE_STATUS_LOCKFREE 1
+# else
+#  define SQLITE_STATUS_LOCKFREE 0
+# endif
 #endif
 
 int sqlite3StatusValue(int);
@@ -2952,6 +3080,7 @@ WhereInfo *sqlite3WhereBegin(
 void sqlite3WhereEnd(WhereInfo*);
 int sqlite3ExprCodeGetColumn(Parse*, Table*, int, int, int, u8);
 void sqlite3ExprCodeGetColumnOfTable(Vdbe*, Table*, int, int, int);
+void sqlite3ExprCodeLoadIndexColumn(Parse*, Index*, int, int, int);
 void sqlite3ExprCodeMove(Parse*, int, int, int);
 void sqlite3ExprCodeCopy(Parse*, int, int, int);
 void sqlite3ExprCacheStore(Parse*, int, int, int);
@@ -2965,6 +3094,8 @@ int sqlite3ExprCodeTemp(Parse*, Expr*, int*);
 int sqlite3ExprCodeTarget(Parse*, Expr*, int);
 int sqlite3ExprCodeAndCache(Parse*, Expr*, int);
 void sqlite3ExprCodeConstants(Parse*, Expr*);
+void sqlite3ExprListCodeConstants(Parse*, ExprList*);
+void sqlite3ExprCodeInitConstants(Parse*);
 int sqlite3ExprCodeExprList(Parse*, ExprList*, int, int);
 void sqlite3ExprIfTrue(Parse*, Expr*, int, int);
 void sqlite3ExprIfFalse(Parse*, Expr*, int, int);
@@ -2978,6 +3109,7 @@ int sqlite3RunVacuum(char**, sqlite3*);
 char *sqlite3NameFromToken(sqlite3*, Token*);
 int sqlite3ExprCompare(Expr*, Expr*);
 int sqlite3ExprListCompare(ExprList*, ExprList*);
+int sqlite3ExprCompareIndexExpr(Expr*, Expr*, int);
 void sqlite3ExprAnalyzeAggregates(NameContext*, Expr*);
 void sqlite3ExprAnalyzeAggList(NameContext*,ExprList*);
 int sqlite3FunctionUsesThisSrc(Expr*, SrcList*);
@@ -3089,10 +3221,18 @@ int sqlite3FixExpr(DbFixer*, Expr*);
 int sqlite3FixExprList(DbFixer*, ExprList*);
 int sqlite3FixTriggerStep(DbFixer*, TriggerStep*);
 int sqlite3AtoF(const char *z, double*, int, u8);
+int sqlite3Int64ToText(i64, char*);
+#ifndef SQLITE_OMIT_FLOATING_POINT
+int sqlite3RealToText(double, char*);
+#else
+# define sqlite3RealToText(r,z) 0
+#endif
 int sqlite3GetInt32(const char *, int*);
 int sqlite3Atoi(const char*);
 int sqlite3Utf16ByteLen(const void *pData, int nChar);
 int sqlite3Utf8CharLen(const char *pData, int nByte);
+const u8 *sqlite3Utf8Skip(const u8*, int, i64);
+void sqlite3Utf8ChangeCase(u8*, const u8*, int, int);
 u32 sqlite3Utf8Read(const u8*, const u8**);
 
 /*
@@ -3176,6 +3316,7 @@ char *sqlite3Utf16to8(sqlite3 *, const void*, int, u8);
 char *sqlite3Utf8to16(sqlite3 *, u8, char *, int, int *);
 #endif
 int sqlite3ValueFromExpr(sqlite3 *, Expr *, u8, u8, sqlite3_value **);
+int sqlite3ValueRecordsFromExpr(sqlite3*, ExprList**, int, u8, sqlite3_value**);
 void sqlite3ValueApplyAffinity(sqlite3_value *, u8, u8);
 #ifndef SQLITE_AMALGAMATION
 extern const unsigned char sqlite3OpcodeProperty[];
@@ -18,11 +18,38 @@
 
 /*
 ** Variables in which to record status information.
+**
+** When SQLITE_STATUS_LOCKFREE is true, the counters are updated with
+** relaxed atomic instructions and no mutex.  So that threads do not
+** all write the same cache line, each thread adds into its own shard
+** of aShard[] and moves the accumulated delta into nowValue[] only once
+** it reaches aStatusBatch[] in either direction.  The current value is
+** nowValue[] plus the deltas of all shards.
+**
+** High-water marks are raised whenever a delta is moved and whenever
+** sqlite3_status() is called.  They may therefore be low by up to
+** STATUS_SHARDS*aStatusBatch[] for the counters that are added to.
+**
+** Counters that are set rather than added to (the *_SIZE counters and
+** SQLITE_STATUS_PARSER_STACK) keep their current value in the shard
+** of the thread that set it.  Only their high-water mark is shared.
 */
+#if SQLITE_STATUS_LOCKFREE
+# define STATUS_SHARDS 16
+typedef struct sqlite3StatShard sqlite3StatShard;
+struct sqlite3StatShard {
+  int aValue[10];           /* Delta not yet in nowValue[], or value set */
+  int aPad[6];              /* Pad to 64 bytes */
+};
+#endif
 typedef struct sqlite3StatType sqlite3StatType;
 static SQLITE_WSD struct sqlite3StatType {
   int nowValue[10];         /* Current value */
   int mxValue[10];          /* Maximum value */
+#if SQLITE_STATUS_LOCKFREE
+  int iNextShard;           /* Shard for the next new thread */
+  sqlite3StatShard aShard[STATUS_SHARDS];
+#endif
 } sqlite3Stat = { {0,}, {0,} };
 
 
@@ -40,26 +67,101 @@ static SQLITE_WSD struct sqlite3StatType {
 # define wsdStat sqlite3Stat
 #endif
 
+#if SQLITE_STATUS_LOCKFREE
+#define statusLoad(P)      __atomic_load_n((P), __ATOMIC_RELAXED)
+#define statusStore(P,V)   __atomic_store_n((P), (V), __ATOMIC_RELAXED)
+#define statusAdd(P,N)     __atomic_add_fetch((P), (N), __ATOMIC_RELAXED)
+#define statusSwap(P,V)    __atomic_exchange_n((P), (V), __ATOMIC_RELAXED)
+#define statusCas(P,E,V)   __atomic_compare_exchange_n((P), (E), (V), 1, \
+                               __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+
+/*
+** True for the counters that are set rather than added to.
+*/
+#define statusIsSet(op)    ((0x1e0>>(op))&1)
+
+/*
+** How far a shard's delta may drift before it is moved into nowValue[].
+*/
+static const int aStatusBatch[10] = {
+  4096,     /* SQLITE_STATUS_MEMORY_USED */
+  16,       /* SQLITE_STATUS_PAGECACHE_USED */
+  4096,     /* SQLITE_STATUS_PAGECACHE_OVERFLOW */
+  16,       /* SQLITE_STATUS_SCRATCH_USED */
+  4096,     /* SQLITE_STATUS_SCRATCH_OVERFLOW */
+  0, 0, 0, 0,
+  16,       /* SQLITE_STATUS_MALLOC_COUNT */
+};
+
+/*
+** Return the shard used by the calling thread.
+*/
+static sqlite3StatShard *statusShard(void){
+  static __thread int iShard = -1;
+  wsdStatInit;
+  if( iShard<0 ){
+    iShard = statusAdd(&wsdStat.iNextShard, 1) & (STATUS_SHARDS-1);
+  }
+  return &wsdStat.aShard[iShard];
+}
+
+/*
+** Raise the high-water mark of status op to at least v.
+*/
+static void statusRaise(int op, int v){
+  int mx;
+  wsdStatInit;
+  mx = statusLoad(&wsdStat.mxValue[op]);
+  while( v>mx && !statusCas(&wsdStat.mxValue[op], &mx, v) ){}
+}
+#endif /* SQLITE_STATUS_LOCKFREE */
+
 /*
 ** Return the current value of a status parameter.
 */
 int sqlite3StatusValue(int op){
   wsdStatInit;
   assert( op>=0 && op<ArraySize(wsdStat.nowValue) );
+#if SQLITE_STATUS_LOCKFREE
+  if( statusIsSet(op) ){
+    return statusLoad(&statusShard()->aValue[op]);
+  }else{
+    int i;
+    int v = statusLoad(&wsdStat.nowValue[op]);
+    for(i=0; i<STATUS_SHARDS; i++){
+      v += statusLoad(&wsdStat.aShard[i].aValue[op]);
+    }
+    return v;
+  }
+#else
   return wsdStat.nowValue[op];
+#endif
 }
 
 /*
 ** Add N to the value of a status record.  It is assumed that the
-** caller holds appropriate locks.
+** caller holds appropriate locks, unless SQLITE_STATUS_LOCKFREE is
+** true.
 */
 void sqlite3StatusAdd(int op, int N){
   wsdStatInit;
   assert( op>=0 && op<ArraySize(wsdStat.nowValue) );
+#if SQLITE_STATUS_LOCKFREE
+  {
+    sqlite3StatShard *pShard = statusShard();
+    int d = statusAdd(&pShard->aValue[op], N);
+    assert( !statusIsSet(op) );
+    if( d>=aStatusBatch[op] || d<=-aStatusBatch[op] ){
+      d = statusSwap(&pShard->aValue[op], 0);
+      statusRaise(op, statusAdd(&wsdStat.nowValue[op], d));
+    }
+  }
+#else
   wsdStat.nowValue[op] += N;
   if( wsdStat.nowValue[op]>wsdStat.mxValue[op] ){
     wsdStat.mxValue[op] = wsdStat.nowValue[op];
   }
+#endif
 }
 
 /*
@@ -68,29 +170,56 @@ void sqlite3StatusAdd(int op, int N){
 void sqlite3StatusSet(int op, int X){
   wsdStatInit;
   assert( op>=0 && op<ArraySize(wsdStat.nowValue) );
+#if SQLITE_STATUS_LOCKFREE
+  assert( statusIsSet(op) );
+  statusStore(&statusShard()->aValue[op], X);
+  statusRaise(op, X);
+#else
   wsdStat.nowValue[op] = X;
   if( wsdStat.nowValue[op]>wsdStat.mxValue[op] ){
     wsdStat.mxValue[op] = wsdStat.nowValue[op];
   }
+#endif
 }
 
 /*
 ** Query status information.
 **
-** This implementation assumes that reading or writing an aligned
-** 32-bit integer is an atomic operation.  If that assumption is not true,
-** then this routine is not threadsafe.
+** Unless SQLITE_STATUS_LOCKFREE is true, this implementation assumes
+** that reading or writing an aligned 32-bit integer is an atomic
+** operation.  If that assumption is not true, then this routine is
+** not threadsafe.
 */
 int sqlite3_status(int op, int *pCurrent, int *pHighwater, int resetFlag){
   wsdStatInit;
+  if( op>=SQLITE_STATUS_MUTEX_WAIT
+   && op<SQLITE_STATUS_MUTEX_WAIT+SQLITE_MUTEX_NTYPE
+  ){
+#ifndef SQLITE_MUTEX_OMIT
+    sqlite3MutexWaitStatus(op-SQLITE_STATUS_MUTEX_WAIT,
+                           pCurrent, pHighwater, resetFlag);
+#else
+    *pCurrent = *pHighwater = 0;
+#endif
+    return SQLITE_OK;
+  }
   if( op<0 || op>=ArraySize(wsdStat.nowValue) ){
     return SQLITE_MISUSE_BKPT;
   }
+#if SQLITE_STATUS_LOCKFREE
+  *pCurrent = sqlite3StatusValue(op);
+  statusRaise(op, *pCurrent);
+  *pHighwater = statusLoad(&wsdStat.mxValue[op]);
+  if( resetFlag ){
+    statusStore(&wsdStat.mxValue[op], *pCurrent);
+  }
+#else
   *pCurrent = wsdStat.nowValue[op];
   *pHighwater = wsdStat.mxValue[op];
   if( resetFlag ){
     wsdStat.mxValue[op] = wsdStat.nowValue[op];
   }
+#endif
   return SQLITE_OK;
 }
 
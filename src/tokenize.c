@@ -234,14 +234,22 @@ int sqlite3GetToken(const unsigned char *z, int *tokenType){
       testcase( delim=='`' );
       testcase( delim=='\'' );
       testcase( delim=='"' );
-      for(i=1; (c=z[i])!=0; i++){
-        if( c==delim ){
-          if( z[i+1]==delim ){
-            i++;
-          }else{
-            break;
-          }
+      /* Jump from one delimiter to the next using strchr(), which the C
+      ** library scans a word or vector at a time, rather than testing
+      ** each byte of a long literal here. */
+      for(i=1; ; i++){
+        const char *zEnd = strchr((const char*)&z[i], delim);
+        if( zEnd==0 ){
+          i += sqlite3Strlen30((const char*)&z[i]);
+          c = 0;
+          break;
         }
+        i = (int)(zEnd - (const char*)z);
+        if( z[i+1]!=delim ){
+          c = delim;
+          break;
+        }
+        i++;
       }
       if( c=='\'' ){
         *tokenType = TK_STRING;
@@ -352,14 +360,21 @@ int sqlite3GetToken(const unsigned char *z, int *tokenType){
     case 'x': case 'X': {
       testcase( z[0]=='x' ); testcase( z[0]=='X' );
       if( z[1]=='\'' ){
+        /* Find the closing quote with strchr(), as for strings above,
+        ** and only then check that the digits between are hex */
+        const char *zEnd = strchr((const char*)&z[2], '\'');
+        int nEnd;
+        if( zEnd==0 ){
+          *tokenType = TK_ILLEGAL;
+          return 2 + sqlite3Strlen30((const char*)&z[2]);
+        }
+        nEnd = (int)(zEnd - (const char*)z);
         *tokenType = TK_BLOB;
-        for(i=2; sqlite3Isxdigit(z[i]); i++){}
-        if( z[i]!='\'' || i%2 ){
+        for(i=2; i<nEnd && sqlite3Isxdigit(z[i]); i++){}
+        if( i<nEnd || nEnd%2 ){
           *tokenType = TK_ILLEGAL;
-          while( z[i] && z[i]!='\'' ){ i++; }
         }
-        if( z[i] ) i++;
-        return i;
+        return nEnd+1;
       }
       /* Otherwise fall through to the next case */
     }
@@ -377,6 +392,78 @@ int sqlite3GetToken(const unsigned char *z, int *tokenType){
   return 1;
 }
 
+/*
+** Lists of at least this many literals are built by literalList()
+** rather than by the parser.
+*/
+#ifndef SQLITE_LITLIST_MIN
+# define SQLITE_LITLIST_MIN 8
+#endif
+
+/*
+** True if token type T is a literal that the grammar turns into a
+** leaf expression holding nothing but the text of the token.
+*/
+#define isListLiteral(T) \
+  ((T)==TK_INTEGER || (T)==TK_FLOAT || (T)==TK_STRING \
+   || (T)==TK_BLOB || (T)==TK_NULL)
+
+/*
+** zSql points just past the "(" that opens an IN list or a row of a
+** VALUES clause.  If the text that follows is a comma-separated list of
+** at least SQLITE_LITLIST_MIN literals closed by ")", build the ExprList
+** for it, store the list in pParse->pLitList and return the number of
+** bytes of zSql that it covers, up to the end of the last literal.
+** Otherwise return 0 and leave the text to the parser.
+**
+** A large IN list or a bulk INSERT otherwise costs a trip through the
+** LALR engine, with a shift and several reductions, for every literal
+** and every comma.  The text is scanned once to check that it qualifies
+** before anything is allocated, so that short lists and lists that turn
+** out to hold something other than literals cost only the tokenizing.
+*/
+static int literalList(Parse *pParse, const char *zSql){
+  ExprList *pList = 0;    /* The list being built */
+  int bBuild;             /* 0 while checking, 1 while building */
+  int i;                  /* Offset of the current token in zSql */
+  int n;                  /* Length of the current token */
+  int tokenType;          /* Type of the current token */
+  int nLit;               /* Number of literals seen */
+  int iEnd = 0;           /* Offset of the end of the last literal */
+  int bLiteral;           /* True if a literal is expected next */
+
+  assert( pParse->pLitList==0 );
+  for(bBuild=0; bBuild<2; bBuild++){
+    nLit = 0;
+    bLiteral = 1;
+    for(i=0; zSql[i]; i+=n){
+      n = sqlite3GetToken((unsigned char*)&zSql[i], &tokenType);
+      if( tokenType==TK_SPACE ) continue;
+      if( bLiteral ){
+        if( !isListLiteral(tokenType) ) return 0;
+        if( bBuild ){
+          Token tok;
+          tok.z = &zSql[i];
+          tok.n = n;
+          pList = sqlite3ExprListAppend(pParse, pList,
+                      sqlite3PExpr(pParse, tokenType, 0, 0, &tok));
+          if( pList==0 ) return 0;
+        }
+        nLit++;
+        iEnd = i+n;
+      }else if( tokenType==TK_RP ){
+        break;
+      }else if( tokenType!=TK_COMMA ){
+        return 0;
+      }
+      bLiteral = !bLiteral;
+    }
+    if( zSql[i]==0 || nLit<SQLITE_LITLIST_MIN ) return 0;
+  }
+  pParse->pLitList = pList;
+  return iEnd;
+}
+
 /*
 ** Run the parser on the given SQL string.  The parser structure is
 ** passed in.  An SQLITE_ status code is returned.  If an error occurs
@@ -393,6 +480,7 @@ int sqlite3RunParser(Parse *pParse, const char *zSql, char **pzErrMsg){
   u8 enableLookaside;             /* Saved value of db->lookaside.bEnabled */
   sqlite3 *db = pParse->db;       /* The database connection */
   int mxSqlLen;                   /* Max length of an SQL string */
+  u8 bValues = 0;                 /* True after VALUES in this statement */
 
 
   mxSqlLen = db->aLimit[SQLITE_LIMIT_SQL_LENGTH];
@@ -442,10 +530,33 @@ int sqlite3RunParser(Parse *pParse, const char *zSql, char **pzErrMsg){
       }
       case TK_SEMI: {
         pParse->zTail = &zSql[i];
+        bValues = 0;
         /* Fall thru into the default case */
       }
       default: {
         sqlite3Parser(pEngine, tokenType, pParse->sLastToken, pParse);
+        if( tokenType==TK_VALUES ) bValues = 1;
+
+        /* An "(" that opens an IN list or a row of a VALUES clause may be
+        ** followed by a long list of literals.  If so, pass the whole list
+        ** to the parser as a single LITLIST token. */
+        if( tokenType==TK_LP && pParse->rc==SQLITE_OK
+         && (lastTokenParsed==TK_IN || lastTokenParsed==TK_VALUES
+             || (lastTokenParsed==TK_COMMA && bValues))
+        ){
+          int n = literalList(pParse, &zSql[i]);
+          if( n>0 ){
+            pParse->sLastToken.z = &zSql[i];
+            pParse->sLastToken.n = n;
+            i += n;
+            if( i>mxSqlLen ){
+              pParse->rc = SQLITE_TOOBIG;
+              goto abort_parse;
+            }
+            tokenType = TK_LITLIST;
+            sqlite3Parser(pEngine, tokenType, pParse->sLastToken, pParse);
+          }
+        }
         lastTokenParsed = tokenType;
         if( pParse->rc!=SQLITE_OK ){
           goto abort_parse;
@@ -468,6 +579,8 @@ abort_parse:
   );
 #endif /* YYDEBUG */
   sqlite3ParserFree(pEngine, sqlite3_free);
+  sqlite3ExprListDelete(db, pParse->pLitList);
+  pParse->pLitList = 0;
   db->lookaside.bEnabled = enableLookaside;
   if( db->mallocFailed ){
     pParse->rc = SQLITE_NOMEM;
@@ -486,6 +599,20 @@ abort_parse:
     sqlite3VdbeDelete(pParse->pVdbe);
     pParse->pVdbe = 0;
   }
+  sqlite3ExprCacheClear(pParse);
+  if( pParse->nested==0 ){
+    for(i=0; i<pParse->nConstExpr; i++){
+      sqlite3ExprDelete(db, pParse->aConstExpr[i].pExpr);
+    }
+    sqlite3DbFree(db, pParse->aConstExpr);
+    pParse->aConstExpr = 0;
+    pParse->nConstExpr = 0;
+    while( pParse->pIdxExpr ){
+      IndexedExpr *p = pParse->pIdxExpr;
+      pParse->pIdxExpr = p->pIENext;
+      sqlite3DbFree(db, p);
+    }
+  }
 #ifndef SQLITE_OMIT_SHARED_CACHE
   if( pParse->nested==0 ){
     sqlite3DbFree(db, pParse->aTableLock);
@@ -935,6 +935,7 @@ static TriggerPrg *codeRowTrigger(
 		sqlite3VdbeDelete(v);
 	}
 
+	sqlite3ExprCacheClear(pSubParse);
 	assert(!pSubParse->pAinc       && !pSubParse->pZombieTab);
 	assert(!pSubParse->pTriggerPrg && !pSubParse->nMaxArg);
 	sqlite3StackFree(db, pSubParse);
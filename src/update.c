@@ -264,7 +264,8 @@ void sqlite3Update(
     }else{
       reg = 0;
       for(i=0; i<pIdx->nColumn; i++){
-        if( aXRef[pIdx->aiColumn[i]]>=0 ){
+        /* An expression column may depend on any column of the row */
+        if( pIdx->aiColumn[i]==XN_EXPR || aXRef[pIdx->aiColumn[i]]>=0 ){
           reg = ++pParse->nMem;
           break;
         }
@@ -506,6 +507,11 @@ void sqlite3Update(
         sqlite3ColumnDefault(v, pTab, i, regNew+i);
       }
     }
+
+    /* Values cached before the triggers ran, including the results of
+    ** function calls on this row, may no longer match the row.  They
+    ** must not be used for the old keys of expression indexes. */
+    sqlite3ExprCacheClear(pParse);
   }
 
   if( !isView ){
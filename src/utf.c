@@ -141,6 +141,110 @@ static const unsigned char sqlite3Utf8Trans1[] = {
   }                                                                   \
 }
 
+/*
+** The routines below process runs of ASCII text eight bytes at a time
+** using ordinary 64-bit integer arithmetic.  Each group of eight bytes is
+** loaded with memcpy(), which compilers turn into a single (possibly
+** unaligned) load, so no assumptions are made about alignment or byte
+** order.  This is portable C, so no run-time CPU detection is required.
+**
+** UTF8_ONES has 0x01 in every byte and UTF8_HIGHS has 0x80 in every byte.
+*/
+#define UTF8_ONES   ((((u64)0x01010101)<<32) | (u64)0x01010101)
+#define UTF8_HIGHS  (UTF8_ONES*0x80)
+
+/*
+** Load eight bytes from address z.
+*/
+static u64 utf8Load64(const u8 *z){
+  u64 w;
+  memcpy(&w, z, 8);
+  return w;
+}
+
+/*
+** Return the number of bytes at the start of the n-byte buffer z that
+** are 7-bit ASCII, rounded down to a multiple of 8.  If bStopAtNul is
+** true, 0x00 bytes are treated as non-ASCII so that the run also ends
+** at the first nul terminator.
+*/
+static int utf8AsciiRun(const u8 *z, int n, int bStopAtNul){
+  int i = 0;
+  if( bStopAtNul ){
+    /* A byte with its high bit clear produces a borrow in (w - UTF8_ONES)
+    ** only if it is 0x00. */
+    while( i+8<=n ){
+      u64 w = utf8Load64(&z[i]);
+      if( ((w | (w - UTF8_ONES)) & UTF8_HIGHS)!=0 ) break;
+      i += 8;
+    }
+  }else{
+    while( i+8<=n ){
+      if( (utf8Load64(&z[i]) & UTF8_HIGHS)!=0 ) break;
+      i += 8;
+    }
+  }
+  return i;
+}
+
+/*
+** Return a pointer to the first byte past the first nChar characters
+** of the nByte-byte UTF-8 string z.  Fewer characters are skipped if
+** a 0x00 byte is encountered first.  The string must be nul-terminated
+** (z[nByte]==0).
+*/
+const u8 *sqlite3Utf8Skip(const u8 *z, int nByte, i64 nChar){
+  const u8 *zTerm = &z[nByte];
+  while( nChar>0 && *z ){
+    if( nChar>=8 ){
+      int n = utf8AsciiRun(z, (int)(zTerm - z), 1);
+      if( n>nChar ) n = (int)(nChar & ~7);
+      if( n>0 ){
+        z += n;
+        nChar -= n;
+        continue;
+      }
+    }
+    SQLITE_SKIP_UTF8(z);
+    nChar--;
+  }
+  return z;
+}
+
+/*
+** Copy the n bytes of text in zIn to zOut, converting ASCII lower-case
+** letters to upper-case (if bUpper is true) or upper-case letters to
+** lower-case (if bUpper is false).  Other bytes are copied unchanged.
+** This does the same thing as applying sqlite3Toupper() or sqlite3Tolower()
+** to each byte.
+*/
+void sqlite3Utf8ChangeCase(u8 *zOut, const u8 *zIn, int n, int bUpper){
+  int i = 0;
+#ifdef SQLITE_ASCII
+  /* For each byte b of w with the high bit clear, the high bit of the
+  ** corresponding byte of (w&0x7f..) + (0x80 - lo) is set if b>=lo, and
+  ** the high bit of (w&0x7f..) + (0x7f - hi) is set if b>hi.  Neither
+  ** sum carries into the next byte.  Bytes between lo and hi inclusive
+  ** have 0x20 flipped. */
+  const u8 lo = bUpper ? 'a' : 'A';
+  const u8 hi = bUpper ? 'z' : 'Z';
+  const u64 addLo = UTF8_ONES*(0x80 - lo);
+  const u64 addHi = UTF8_ONES*(0x7f - hi);
+  for(; i+8<=n; i+=8){
+    u64 w = utf8Load64(&zIn[i]);
+    u64 h = w & ~UTF8_HIGHS;
+    u64 m = (h + addLo) & ~(h + addHi) & ~w & UTF8_HIGHS;
+    w ^= (m>>2);
+    memcpy(&zOut[i], &w, 8);
+  }
+#endif
+  if( bUpper ){
+    for(; i<n; i++) zOut[i] = (u8)sqlite3Toupper(zIn[i]);
+  }else{
+    for(; i<n; i++) zOut[i] = sqlite3Tolower(zIn[i]);
+  }
+}
+
 /*
 ** Translate a single UTF-8 character.  Return the unicode value.
 **
@@ -257,6 +361,7 @@ int sqlite3VdbeMemTranslate(Mem *pMem, u8 desiredEnc){
   unsigned char *zTerm;                 /* 输入结束 */
   unsigned char *z;                     /* 输出迭代器 */
   unsigned int c;
+  int i;
 
   assert( pMem->db==0 || sqlite3_mutex_held(pMem->db->mutex) );
   assert( pMem->flags&MEM_Str );
@@ -348,6 +453,12 @@ int sqlite3VdbeMemTranslate(Mem *pMem, u8 desiredEnc){
     if( desiredEnc==SQLITE_UTF16LE ){
       /* UTF-8 -> UTF-16 Little-endian */
       while( zIn<zTerm ){
+        int n = utf8AsciiRun(zIn, (int)(zTerm - zIn), 0);
+        if( n>0 ){
+          for(i=0; i<n; i++){ z[0] = zIn[i]; z[1] = 0; z += 2; }
+          zIn += n;
+          continue;
+        }
         /* c = sqlite3Utf8Read(zIn, zTerm, (const u8**)&zIn); */
         READ_UTF8(zIn, zTerm, c);
         WRITE_UTF16LE(z, c);
@@ -356,6 +467,12 @@ int sqlite3VdbeMemTranslate(Mem *pMem, u8 desiredEnc){
       assert( desiredEnc==SQLITE_UTF16BE );
       /* UTF-8 -> UTF-16 Big-endian */
       while( zIn<zTerm ){
+        int n = utf8AsciiRun(zIn, (int)(zTerm - zIn), 0);
+        if( n>0 ){
+          for(i=0; i<n; i++){ z[0] = 0; z[1] = zIn[i]; z += 2; }
+          zIn += n;
+          continue;
+        }
         /* c = sqlite3Utf8Read(zIn, zTerm, (const u8**)&zIn); */
         READ_UTF8(zIn, zTerm, c);
         WRITE_UTF16BE(z, c);
@@ -364,16 +481,32 @@ int sqlite3VdbeMemTranslate(Mem *pMem, u8 desiredEnc){
     pMem->n = (int)(z - zOut);
     *z++ = 0;
   }else{
+    /* A group of four UTF-16 code units is all ASCII if the bytes that
+    ** are set in aAsciiLE[] or aAsciiBE[] are all clear. */
+    static const u8 aAsciiLE[8] = {0x80,0xff,0x80,0xff,0x80,0xff,0x80,0xff};
+    static const u8 aAsciiBE[8] = {0xff,0x80,0xff,0x80,0xff,0x80,0xff,0x80};
+    u64 mAscii;
     assert( desiredEnc==SQLITE_UTF8 );
+    mAscii = utf8Load64(pMem->enc==SQLITE_UTF16LE ? aAsciiLE : aAsciiBE);
     if( pMem->enc==SQLITE_UTF16LE ){
       /* UTF-16 Little-endian -> UTF-8 */
       while( zIn<zTerm ){
+        if( zTerm-zIn>=8 && (utf8Load64(zIn) & mAscii)==0 ){
+          for(i=0; i<8; i+=2){ *z++ = zIn[i]; }
+          zIn += 8;
+          continue;
+        }
         READ_UTF16LE(zIn, zIn<zTerm, c); 
         WRITE_UTF8(z, c);
       }
     }else{
       /* UTF-16 Big-endian -> UTF-8 */
       while( zIn<zTerm ){
+        if( zTerm-zIn>=8 && (utf8Load64(zIn) & mAscii)==0 ){
+          for(i=1; i<8; i+=2){ *z++ = zIn[i]; }
+          zIn += 8;
+          continue;
+        }
         READ_UTF16BE(zIn, zIn<zTerm, c); 
         WRITE_UTF8(z, c);
       }
@@ -470,6 +603,14 @@ int sqlite3Utf8CharLen(const char *zIn, int nByte){
   }
   assert( z<=zTerm );
   while( *z!=0 && z<zTerm ){
+    if( nByte>=0 ){
+      int n = utf8AsciiRun(z, (int)(zTerm - z), 1);
+      if( n>0 ){
+        z += n;
+        r += n;
+        continue;
+      }
+    }
     SQLITE_SKIP_UTF8(z);
     r++;
   }
@@ -409,6 +409,16 @@ do_atof_calc:
     /* In the IEEE 754 standard, zero is signed.
     ** Add the sign if we've seen at least one digit */
     result = (sign<0 && nDigits) ? -(double)0 : (double)0;
+  } else if( s<=((i64)1<<53) && e<=22 ) {
+    /* Both the significand and 10^e are exactly representable as doubles,
+    ** so a single multiplication or division gives the correctly rounded
+    ** result (Clinger's fast path).  Most numbers fall into this case. */
+    static const double aPow10[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    result = esign<0 ? (double)s/aPow10[e] : (double)s*aPow10[e];
+    if( sign<0 ) result = -result;
   } else {
     /* attempt to reduce exponent */
     if( esign>0 ){
@@ -466,6 +476,52 @@ do_atof_calc:
 #endif /* SQLITE_OMIT_FLOATING_POINT */
 }
 
+/*
+** Write the text representation of integer v into zOut as "%lld" would.
+** zOut must have space for at least 21 bytes.  The result is
+** nul-terminated.  Return the number of bytes written, not counting the
+** nul terminator.
+*/
+int sqlite3Int64ToText(i64 v, char *zOut){
+  char zTemp[22];
+  int i = sizeof(zTemp)-1;
+  int n;
+  u64 x = v<0 ? (u64)0 - (u64)v : (u64)v;
+  zTemp[i] = 0;
+  do{
+    zTemp[--i] = (char)('0' + x%10);
+    x /= 10;
+  }while( x );
+  if( v<0 ) zTemp[--i] = '-';
+  n = (int)sizeof(zTemp)-1-i;
+  memcpy(zOut, &zTemp[i], n+1);
+  return n;
+}
+
+#ifndef SQLITE_OMIT_FLOATING_POINT
+/*
+** If the text that "%!.15g" generates for r can be produced without going
+** through the general floating point conversion in sqlite3VXPrintf(),
+** write it into zOut and return the number of bytes written (not
+** counting the nul terminator).  Otherwise write nothing and return 0.
+**
+** Whole numbers of magnitude less than 1e15 are handled this way.  They
+** render as their integer digits followed by ".0", which is the common
+** case for REAL values that came from integer-valued text.  zOut must have
+** space for at least 24 bytes.
+*/
+int sqlite3RealToText(double r, char *zOut){
+  i64 v;
+  int n;
+  if( !(r>-1e15 && r<1e15) ) return 0;
+  v = (i64)r;
+  if( (double)v!=r ) return 0;
+  n = sqlite3Int64ToText(v, zOut);
+  memcpy(&zOut[n], ".0", 3);
+  return n+2;
+}
+#endif /* SQLITE_OMIT_FLOATING_POINT */
+
 /*
 ** Compare the 19-character string zNum against the text representation
 ** value 2^63:  9223372036854775808.  Return negative, zero, or positive
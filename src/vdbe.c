@@ -1609,6 +1609,7 @@ case OP_Function: {
   MemSetTypeFlag(&ctx.s, MEM_Null);
 
   ctx.isError = 0;
+  ctx.constMask = (u32)pOp->p1;
   if( ctx.pFunc->flags & SQLITE_FUNC_NEEDCOLL ){
     assert( pOp>aOp );
     assert( pOp[-1].p4type==P4_COLLSEQ );
@@ -2408,6 +2409,112 @@ case OP_NotNull: {            /* same as TK_NOTNULL, jump, in1 */
   break;
 }
 
+/* Opcode: NotInIntList P1 P2 * P4 *
+**
+** P4 is an array of distinct integers in ascending order, preceded by
+** the number of integers.  Jump to P2 unless the value in register P1
+** compares equal to one of them.  A NULL, string or blob never compares
+** equal to an integer.  A real value compares equal to an integer if
+** the two have the same value as doubles, as in OP_Eq.
+**
+** This is used for "x IN (1,2,3,...)", where the list holds only
+** integer constants, in place of an ephemeral index and OP_NotFound.
+*/
+case OP_NotInIntList: {       /* jump, in1 */
+  i64 *aVal;                  /* Count of values, then sorted values */
+  i64 iVal;                   /* Value to search for */
+  double r;                   /* Value of a MEM_Real in P1 */
+  int lo, hi, mid;            /* Binary search bounds */
+  int bFound;                 /* True if P1 is found in P4 */
+
+  assert( pOp->p4type==P4_INT64ARRAY );
+  aVal = pOp->p4.pI64;
+  pIn1 = &aMem[pOp->p1];
+  lo = 1;
+  hi = (int)aVal[0];
+  bFound = 0;
+  iVal = 0;
+  if( pIn1->flags & MEM_Int ){
+    iVal = pIn1->u.i;
+  }else if( pIn1->flags & MEM_Real ){
+    r = pIn1->r;
+    if( r>-9007199254740992.0 && r<9007199254740992.0 ){
+      iVal = (i64)r;
+      if( (double)iVal!=r ) hi = 0;
+    }else{
+      /* Beyond 2^53 several integers round to the same double, so
+      ** search for any of them with a linear scan. */
+      for(; lo<=hi && !bFound; lo++){
+        bFound = (double)aVal[lo]==r;
+      }
+      hi = 0;
+    }
+  }else{
+    hi = 0;
+  }
+  while( lo<=hi ){
+    mid = (lo+hi)/2;
+    if( aVal[mid]==iVal ){
+      bFound = 1;
+      break;
+    }else if( aVal[mid]<iVal ){
+      lo = mid+1;
+    }else{
+      hi = mid-1;
+    }
+  }
+  if( !bFound ){
+    pc = pOp->p2 - 1;
+  }
+  break;
+}
+
+/* Opcode: ValuesRow P1 P2 P3 P4 *
+**
+** P4 is a blob holding a sequence of records in the format built by
+** OP_MakeRecord, one for each row of a multi-row VALUES clause.
+** Register P1 holds the offset in P4 of the next record.  If there are
+** no more records, jump to P2.  Otherwise load the fields of the next
+** record into registers P3, P3+1, ... and advance P1 to the record
+** that follows.
+**
+** Strings and blobs are loaded as ephemeral values that point into P4.
+*/
+case OP_ValuesRow: {        /* jump, in1 */
+  Mem *pRows;               /* The blob of records */
+  const u8 *aRec;           /* The record to load */
+  u32 szHdr;                /* Size of the record header */
+  u32 iHdr;                 /* Offset of the next serial type in aRec */
+  u32 iData;                /* Offset of the next field in aRec */
+  u32 t;                    /* A serial type */
+
+  assert( pOp->p4type==P4_MEM );
+  pRows = pOp->p4.pMem;
+  assert( pRows->flags & MEM_Blob );
+  pIn1 = &aMem[pOp->p1];
+  assert( pIn1->flags & MEM_Int );
+  if( pIn1->u.i>=pRows->n ){
+    pc = pOp->p2 - 1;
+    break;
+  }
+  aRec = (const u8*)&pRows->z[pIn1->u.i];
+  iHdr = getVarint32(aRec, szHdr);
+  iData = szHdr;
+  pOut = &aMem[pOp->p3];
+  while( iHdr<szHdr ){
+    assert( pOut<=&aMem[p->nMem] );
+    memAboutToChange(p, pOut);
+    VdbeMemRelease(pOut);
+    iHdr += getVarint32(&aRec[iHdr], t);
+    iData += sqlite3VdbeSerialGet(&aRec[iData], t, pOut);
+    pOut->enc = encoding;
+    REGISTER_TRACE((int)(pOut-aMem), pOut);
+    pOut++;
+  }
+  pIn1->u.i += iData;
+  break;
+}
+
 /* Opcode: Column P1 P2 P3 P4 P5
 **
 ** Interpret the data that cursor P1 points to as a structure built using
@@ -2466,7 +2573,6 @@ case OP_Column: {
   int len;           /* The length of the serialized data for the column
                      ** 序列化数据列的长度
                      */
-  int i;             /* Loop counter */
   char *zData;       /* Part of the record being decoded */
   Mem *pDest;        /* Where to write the extracted value
                      ** 被提取的值卸载*pDest所指的内存位置
@@ -2481,9 +2587,6 @@ case OP_Column: {
                      ** *zEndHdr指向索引头后的第一个字节
                      */
   u32 offset;        /* Offset into the data */
-  u32 szField;       /* Number of bytes in the content of a field
-                     ** 
-                     */
   int szHdr;         /* Size of the header size field at start of record */
   int avail;         /* Number of bytes of available data */
   u32 t;             /* A type code from the record header */
@@ -2694,35 +2797,8 @@ case OP_Column: {
     ** 通过扫描头文件以获取数组aType[]和aOffset[]的值。aType[i]存储了第i个列的整型数据，
     ** aOffset[i]存储了从记录的起始地址到第i个列中数据存储的首地址的偏移量。
     */
-    for(i=0; i<nField; i++){
-      if( zIdx<zEndHdr ){
-        aOffset[i] = offset;
-        if( zIdx[0]<0x80 ){
-          t = zIdx[0];
-          zIdx++;
-        }else{
-          zIdx += sqlite3GetVarint32(zIdx, &t);
-        }
-        aType[i] = t;
-        szField = sqlite3VdbeSerialTypeLen(t);
-        offset += szField;
-        if( offset<szField ){  /* True if offset overflows */
-          zIdx = &zEndHdr[1];  /* Forces SQLITE_CORRUPT return below */
-          break;
-        }
-      }else{
-        /* If i is less that nField, then there are fewer fields in this
-        ** record than SetNumColumns indicated there are columns in the
-        ** table. Set the offset for any extra columns not present in
-        ** the record to 0. This tells code below to store the default value
-        ** for the column instead of deserializing a value from the record.
-        ** 如果i小于nField，那么记录中的字段是比SetNumColumns小，SetNumColumns是表中的列数。
-        ** 将offset设置为一个额外的、在记录总不存在的列，并赋值为0。也就是说，下面的代码将
-        ** 这一列赋值为默认值，而不是将记录中反序列化后的值赋值给它。
-        */
-        aOffset[i] = 0;
-      }
-    }
+    zIdx = (u8*)sqlite3VdbeDecodeHeader(zIdx, zEndHdr, nField,
+                                        aType, aOffset, &offset);
     sqlite3VdbeMemRelease(&sMem);
     sMem.flags = MEM_Null;
 
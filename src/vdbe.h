@@ -56,7 +56,7 @@ struct VdbeOp {
 		int i;                 /* Integer value if p4type==P4_INT32 */
 		void *p;               /* Generic pointer */
 		char *z;               /* Pointer to data for string (char array) types */
-		i64 *pI64;             /* Used when p4type is P4_INT64 */
+		i64 *pI64;             /* Used when p4type is P4_INT64 or P4_INT64ARRAY */
 		double *pReal;         /* Used when p4type is P4_REAL */
 		FuncDef *pFunc;        /* Used when p4type is P4_FUNCDEF */
 		VdbeFunc *pVdbeFunc;   /* Used when p4type is P4_VDBEFUNC */
@@ -125,6 +125,7 @@ typedef struct VdbeOpList VdbeOpList;
 #define P4_INTARRAY (-15) /* P4 is a vector of 32-bit integers P4是一个32位整形的vector(C++里的???怎么跑这里了?调用STL库了????)*/
 #define P4_SUBPROGRAM  (-18) /* P4 is a pointer to a SubProgram structure P4是指向SubProgram结构体的指针*/
 #define P4_ADVANCE  (-19) /* P4 is a pointer to BtreeNext() or BtreePrev() P4是指向BtreeNext()函数或者BtreePrev()函数的指针*/
+#define P4_INT64ARRAY (-20) /* P4 is a count followed by sorted 64-bit integers P4是一个计数及其后的有序64位整数*/
 
 /* When adding a P4 argument using P4_KEYINFO, a copy of the KeyInfo structure
 ** is made.  That copy is freed when the Vdbe is finalized.  But if the
@@ -221,6 +222,7 @@ void sqlite3VdbeSwap(Vdbe*, Vdbe*);
 VdbeOp *sqlite3VdbeTakeOpArray(Vdbe*, int*, int*);
 sqlite3_value *sqlite3VdbeGetValue(Vdbe*, int, u8);
 void sqlite3VdbeSetVarmask(Vdbe*, int);
+int sqlite3VdbeArgIsConstant(sqlite3_context*, int);
 #ifndef SQLITE_OMIT_TRACE
 char *sqlite3VdbeExpandSql(Vdbe*, const char*);
 #endif
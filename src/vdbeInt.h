@@ -283,6 +283,7 @@ struct VdbeFunc {
 struct sqlite3_context {
   FuncDef *pFunc;       /* Pointer to function information.  MUST BE FIRST */
   VdbeFunc *pVdbeFunc;  /* Auxilary data, if created. 辅助数据*/
+  u32 constMask;        /* Mask of constant arguments (P1 of OP_Function) */
   Mem s;                /* The return value is stored here 返回值被存在这里*/
   Mem *pMem;            /* Memory cell used to store aggregate context 用来存储上下文集合的内存空间*/
   CollSeq *pColl;       /* Collating sequence 核对结果*/
@@ -355,6 +356,7 @@ struct Vdbe {
   u8 usesStmtJournal;     /* True if uses a statement journal 如果使用这个声明日志则为真*/
   u8 readOnly;            /* True for read-only statements 只读声明则为真*/
   u8 isPrepareV2;         /* True if prepared with prepare_v2()用此方法准备则为真 */
+  u8 batchPending;        /* Current row not yet copied by sqlite3_step_batch() */
   int nChange;            /* Number of db changes made since last reset 自上一次重置数据库引起的数据库变化数目*/
   yDbMask btreeMask;      /* Bitmask of db->aDb[] entries referenced 被引用的数组入口的位掩码*/
   yDbMask lockMask;       /* Subset of btreeMask that requires a lock 位掩码的子集需要一个锁。*/
@@ -403,6 +405,7 @@ int sqlite3VdbeCursorMoveto(VdbeCursor*);
 void sqlite3VdbePrintOp(FILE*, int, Op*);
 #endif
 u32 sqlite3VdbeSerialTypeLen(u32);
+const u8 *sqlite3VdbeDecodeHeader(const u8*,const u8*,int,u32*,u32*,u32*);
 u32 sqlite3VdbeSerialType(Mem*, int);
 u32 sqlite3VdbeSerialPut(unsigned char*, int, Mem*, int);
 u32 sqlite3VdbeSerialGet(const unsigned char*, u32, Mem*);
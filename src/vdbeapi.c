@@ -462,26 +462,21 @@ end_of_step:
 #endif
 
 /*
-** This is the top-level implementation of sqlite3_step().  Call
-** sqlite3Step() to do most of the work.  If a schema error occurs,
-** call sqlite3Reprepare() and try again.
+** Call sqlite3Step() to run statement v to its next row.  If a schema
+** error occurs, call sqlite3Reprepare() and try again.  The caller must
+** hold the database connection mutex.
 */
-int sqlite3_step(sqlite3_stmt *pStmt){
+static int vdbeStepWithRetry(Vdbe *v){
   int rc = SQLITE_OK;      /* Result from sqlite3Step() */
   int rc2 = SQLITE_OK;     /* Result from sqlite3Reprepare() */
-  Vdbe *v = (Vdbe*)pStmt;  /* the prepared statement */
   int cnt = 0;             /* Counter to prevent infinite loop of reprepares */
-  sqlite3 *db;             /* The database connection */
+  sqlite3 *db = v->db;     /* The database connection */
 
-  if( vdbeSafetyNotNull(v) ){
-    return SQLITE_MISUSE_BKPT;
-  }
-  db = v->db;
-  sqlite3_mutex_enter(db->mutex);
+  assert( sqlite3_mutex_held(db->mutex) );
   while( (rc = sqlite3Step(v))==SQLITE_SCHEMA
          && cnt++ < SQLITE_MAX_SCHEMA_RETRY
          && (rc2 = rc = sqlite3Reprepare(v))==SQLITE_OK ){
-    sqlite3_reset(pStmt);
+    sqlite3_reset((sqlite3_stmt*)v);
     assert( v->expired==0 );
   }
   if( rc2!=SQLITE_OK && ALWAYS(v->isPrepareV2) && ALWAYS(db->pErr) ){
@@ -503,6 +498,141 @@ int sqlite3_step(sqlite3_stmt *pStmt){
       v->rc = rc = SQLITE_NOMEM;
     }
   }
+  return rc;
+}
+
+/*
+** This is the top-level implementation of sqlite3_step().
+*/
+int sqlite3_step(sqlite3_stmt *pStmt){
+  int rc;                  /* Result from vdbeStepWithRetry() */
+  Vdbe *v = (Vdbe*)pStmt;  /* the prepared statement */
+  sqlite3 *db;             /* The database connection */
+
+  if( vdbeSafetyNotNull(v) ){
+    return SQLITE_MISUSE_BKPT;
+  }
+  db = v->db;
+  sqlite3_mutex_enter(db->mutex);
+  v->batchPending = 0;
+  rc = vdbeStepWithRetry(v);
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Copy the current result row of statement p into row iRow of the
+** column arrays aCol[].  Text and blob values are appended to the
+** zBuf of their column.
+**
+** Return SQLITE_OK on success.  Return SQLITE_FULL, having copied
+** nothing, if some text or blob value does not fit in the space left
+** in its column buffer.  Return SQLITE_NOMEM if a malloc() fails while
+** converting a value.
+*/
+static int vdbeBatchCopyRow(Vdbe *p, int iRow, sqlite3_batch_column *aCol){
+  Mem *aMem = p->pResultSet;
+  int nCol = p->nResColumn;
+  int i;
+
+  /* Convert every text and blob value first and check that it fits, so
+  ** that a row is either copied in full or not at all. */
+  for(i=0; i<nCol; i++){
+    sqlite3_batch_column *pCol = &aCol[i];
+    if( pCol->eType==SQLITE_TEXT || pCol->eType==SQLITE_BLOB ){
+      Mem *pMem = &aMem[i];
+      if( pCol->eType==SQLITE_TEXT ){
+        sqlite3_value_text(pMem);
+      }else{
+        sqlite3_value_blob(pMem);
+      }
+      if( p->db->mallocFailed ) return SQLITE_NOMEM;
+      if( sqlite3_value_bytes(pMem) > pCol->nBuf - pCol->aOffset[iRow] ){
+        return SQLITE_FULL;
+      }
+    }
+  }
+
+  for(i=0; i<nCol; i++){
+    sqlite3_batch_column *pCol = &aCol[i];
+    Mem *pMem = &aMem[i];
+    if( pCol->aNull ){
+      pCol->aNull[iRow] = (pMem->flags & MEM_Null)!=0;
+    }
+    switch( pCol->eType ){
+      case SQLITE_INTEGER: {
+        pCol->aInt[iRow] = sqlite3VdbeIntValue(pMem);
+        break;
+      }
+      case SQLITE_FLOAT: {
+        pCol->aReal[iRow] = sqlite3VdbeRealValue(pMem);
+        break;
+      }
+      case SQLITE_TEXT:
+      case SQLITE_BLOB: {
+        int iOff = pCol->aOffset[iRow];
+        int n = sqlite3_value_bytes(pMem);
+        if( n>0 ) memcpy(&pCol->zBuf[iOff], pMem->z, n);
+        pCol->aOffset[iRow+1] = iOff + n;
+        break;
+      }
+    }
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Step statement pStmt up to nRowMax times, copying each result row
+** into the caller's column arrays.  The connection mutex is taken once
+** for the whole batch rather than once per column value.
+**
+** A row that did not fit in the text and blob buffers is left as the
+** current row and copied first by the next call.
+*/
+int sqlite3_step_batch(
+  sqlite3_stmt *pStmt,             /* The statement to run */
+  int nRowMax,                     /* Maximum number of rows to return */
+  sqlite3_batch_column *aCol,      /* One entry per result column */
+  int *pnRow                       /* OUT: Number of rows copied */
+){
+  Vdbe *v = (Vdbe*)pStmt;
+  sqlite3 *db;
+  int rc = SQLITE_OK;
+  int nRow = 0;
+  int i;
+
+  *pnRow = 0;
+  if( vdbeSafetyNotNull(v) || nRowMax<=0 || aCol==0 ){
+    return SQLITE_MISUSE_BKPT;
+  }
+  db = v->db;
+  sqlite3_mutex_enter(db->mutex);
+  for(i=0; i<v->nResColumn; i++){
+    if( aCol[i].eType==SQLITE_TEXT || aCol[i].eType==SQLITE_BLOB ){
+      aCol[i].aOffset[0] = 0;
+    }
+  }
+  while( nRow<nRowMax ){
+    if( v->batchPending==0 ){
+      rc = vdbeStepWithRetry(v);
+      if( rc!=SQLITE_ROW ) break;
+    }
+    v->batchPending = 0;
+    rc = vdbeBatchCopyRow(v, nRow, aCol);
+    if( rc!=SQLITE_OK ){
+      if( rc==SQLITE_FULL ){
+        v->batchPending = 1;
+        rc = nRow>0 ? SQLITE_ROW : SQLITE_TOOBIG;
+      }else{
+        v->rc = SQLITE_NOMEM;
+      }
+      break;
+    }
+    nRow++;
+    rc = SQLITE_ROW;
+  }
+  *pnRow = nRow;
   rc = sqlite3ApiExit(db, rc);
   sqlite3_mutex_leave(db->mutex);
   return rc;
@@ -597,6 +727,17 @@ void *sqlite3_get_auxdata(sqlite3_context *pCtx, int iArg){
   return pVdbeFunc->apAux[iArg].pAux;
 }
 
+/*
+** Return true if the iArg'th argument to the scalar function defined by
+** pCtx is known to be constant, so that auxiliary data attached to it
+** with sqlite3_set_auxdata() is kept for later rows.  For any other
+** argument the auxiliary data is discarded as soon as the function
+** returns.
+*/
+int sqlite3VdbeArgIsConstant(sqlite3_context *pCtx, int iArg){
+  return iArg>=0 && iArg<32 && (pCtx->constMask & (((u32)1)<<iArg))!=0;
+}
+
 /*
 ** Set the auxilary data pointer and delete function, for the iArg'th
 ** argument to the user-function defined by pCtx. Any previous value is
@@ -968,6 +1109,27 @@ const void *sqlite3_column_origin_name16(sqlite3_stmt *pStmt, int N){
 ** 
 ** Routines used to attach values to wildcards in a compiled SQL statement.
 */
+/*
+** Note that the value bound to variable i (numbered from 0) of
+** statement p has changed.
+**
+** If the bit corresponding to this variable in Vdbe.expmask is set, then 
+** binding a new value to this variable invalidates the current query plan.
+**
+** IMPLEMENTATION-OF: R-48440-37595 If the specific value bound to host
+** parameter in the WHERE clause might influence the choice of query plan
+** for a statement, then the statement will be automatically recompiled,
+** as if there had been a schema change, on the first sqlite3_step() call
+** following any change to the bindings of that parameter.
+*/
+static void vdbeVarChanged(Vdbe *p, int i){
+  if( p->isPrepareV2 &&
+     ((i<32 && p->expmask & ((u32)1 << i)) || p->expmask==0xffffffff)
+  ){
+    p->expired = 1;
+  }
+}
+
 /*
 ** Unbind the value bound to variable i in virtual machine p. This is the 
 ** the same as binding a NULL value to the column. If the "i" parameter is
@@ -1002,21 +1164,7 @@ static int vdbeUnbind(Vdbe *p, int i){
   sqlite3VdbeMemRelease(pVar);
   pVar->flags = MEM_Null;
   sqlite3Error(p->db, SQLITE_OK, 0);
-
-  /* If the bit corresponding to this variable in Vdbe.expmask is set, then 
-  ** binding a new value to this variable invalidates the current query plan.
-  **
-  ** IMPLEMENTATION-OF: R-48440-37595 If the specific value bound to host
-  ** parameter in the WHERE clause might influence the choice of query plan
-  ** for a statement, then the statement will be automatically recompiled,
-  ** as if there had been a schema change, on the first sqlite3_step() call
-  ** following any change to the bindings of that parameter.
-  */
-  if( p->isPrepareV2 &&
-     ((i<32 && p->expmask & ((u32)1 << i)) || p->expmask==0xffffffff)
-  ){
-    p->expired = 1;
-  }
+  vdbeVarChanged(p, i);
   return SQLITE_OK;
 }
 
@@ -1160,6 +1308,132 @@ int sqlite3_bind_zeroblob(sqlite3_stmt *pStmt, int i, int n){
   return rc;
 }
 
+/*
+** Bind row iRow of the parameter array pCol to variable i (numbered
+** from 0) of statement p.  Text and blob values are not copied: they
+** point into the caller's buffer, which sqlite3_execute_batch() keeps
+** valid for as long as they are used.
+*/
+static int vdbeBindBatchValue(
+  Vdbe *p,
+  int i,
+  const sqlite3_batch_column *pCol,
+  int iRow
+){
+  Mem *pVar = &p->aVar[i];
+  int rc = SQLITE_OK;
+
+  if( pCol->eType==0 ) return SQLITE_OK;
+  if( pCol->aNull && pCol->aNull[iRow] ){
+    sqlite3VdbeMemSetNull(pVar);
+  }else{
+    switch( pCol->eType ){
+      case SQLITE_INTEGER: {
+        sqlite3VdbeMemSetInt64(pVar, pCol->aInt[iRow]);
+        break;
+      }
+      case SQLITE_FLOAT: {
+        sqlite3VdbeMemSetDouble(pVar, pCol->aReal[iRow]);
+        break;
+      }
+      default: {
+        int iOff = pCol->aOffset[iRow];
+        int n = pCol->aOffset[iRow+1] - iOff;
+        assert( pCol->eType==SQLITE_TEXT || pCol->eType==SQLITE_BLOB );
+        if( pCol->eType==SQLITE_TEXT ){
+          rc = sqlite3VdbeMemSetStr(pVar, &pCol->zBuf[iOff], n,
+                                    SQLITE_UTF8, SQLITE_STATIC);
+          if( rc==SQLITE_OK ){
+            rc = sqlite3VdbeChangeEncoding(pVar, ENC(p->db));
+          }
+        }else{
+          rc = sqlite3VdbeMemSetStr(pVar, &pCol->zBuf[iOff], n,
+                                    0, SQLITE_STATIC);
+        }
+        break;
+      }
+    }
+  }
+  vdbeVarChanged(p, i);
+  return rc;
+}
+
+/*
+** Run statement pStmt once for each of the nRow rows of parameter
+** values in aParam[], discarding any result rows.  The connection
+** mutex is taken once for the whole batch, and values are written
+** directly into the statement variables instead of going through
+** the sqlite3_bind_*() interfaces.
+**
+** The statement is reset after every row, and after an error.  The
+** number of rows that ran to completion is written to *pnDone.
+*/
+int sqlite3_execute_batch(
+  sqlite3_stmt *pStmt,                /* The statement to run */
+  int nRow,                           /* Number of rows of parameters */
+  int nParam,                         /* Number of entries in aParam[] */
+  const sqlite3_batch_column *aParam, /* Values for parameters 1..nParam */
+  int *pnDone                         /* OUT: Number of rows completed */
+){
+  Vdbe *p = (Vdbe*)pStmt;
+  sqlite3 *db;
+  int rc = SQLITE_OK;
+  int rc2;
+  int nDone = 0;
+  int i;
+
+  if( pnDone ) *pnDone = 0;
+  if( vdbeSafetyNotNull(p) || nRow<0 || (nParam>0 && aParam==0) ){
+    return SQLITE_MISUSE_BKPT;
+  }
+  db = p->db;
+  sqlite3_mutex_enter(db->mutex);
+  if( nParam>p->nVar ){
+    sqlite3Error(db, SQLITE_RANGE, 0);
+    sqlite3_mutex_leave(db->mutex);
+    return SQLITE_RANGE;
+  }
+  if( p->magic!=VDBE_MAGIC_RUN || p->pc>=0 ){
+    sqlite3VdbeReset(p);
+    sqlite3VdbeRewind(p);
+  }
+
+  while( rc==SQLITE_OK && nDone<nRow ){
+    for(i=0; rc==SQLITE_OK && i<nParam; i++){
+      rc = vdbeBindBatchValue(p, i, &aParam[i], nDone);
+    }
+    if( rc==SQLITE_OK ){
+      while( (rc = vdbeStepWithRetry(p))==SQLITE_ROW ){}
+      if( rc==SQLITE_DONE ) rc = SQLITE_OK;
+    }
+    rc2 = sqlite3VdbeReset(p);
+    sqlite3VdbeRewind(p);
+    if( rc==SQLITE_ERROR && rc2!=SQLITE_OK ){
+      /* Statement prepared with the legacy interface.  The specific
+      ** error code is only available from the reset. */
+      rc = rc2;
+    }
+    if( rc==SQLITE_OK ) nDone++;
+  }
+
+  /* Text and blob variables still point into the caller's buffers.
+  ** Give them their own copy so the bindings outlive this call. */
+  for(i=0; i<nParam; i++){
+    Mem *pVar = &p->aVar[i];
+    if( (aParam[i].eType==SQLITE_TEXT || aParam[i].eType==SQLITE_BLOB)
+     && (pVar->flags & MEM_Static)!=0
+     && sqlite3VdbeMemMakeWriteable(pVar)!=SQLITE_OK
+    ){
+      sqlite3VdbeMemSetNull(pVar);
+    }
+  }
+
+  if( pnDone ) *pnDone = nDone;
+  rc = sqlite3ApiExit(db, rc);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
 /*
 ** Return the number of wildcards that can be potentially bound to.
 ** This routine is added to support DBD::SQLite.  
@@ -656,6 +656,7 @@ static void freeP4(sqlite3 *db, int p4type, void *p4){
       case P4_DYNAMIC:
       case P4_KEYINFO:
       case P4_INTARRAY:
+      case P4_INT64ARRAY:
       case P4_KEYINFO_HANDOFF: {
         sqlite3DbFree(db, p4);
         break;
@@ -1015,6 +1016,10 @@ static char *displayP4(Op *pOp, char *zTemp, int nTemp){
       sqlite3_snprintf(nTemp, zTemp, "intarray");
       break;
     }
+    case P4_INT64ARRAY: {
+      sqlite3_snprintf(nTemp, zTemp, "intlist(%lld)", pOp->p4.pI64[0]);
+      break;
+    }
     case P4_SUBPROGRAM: {
       sqlite3_snprintf(nTemp, zTemp, "program");
       break;
@@ -1563,6 +1568,7 @@ void sqlite3VdbeRewind(Vdbe *p){
   p->errorAction = OE_Abort;
   p->magic = VDBE_MAGIC_RUN;
   p->nChange = 0;
+  p->batchPending = 0;
   p->cacheCtr = 1;
   p->minWriteFileFormat = 255;
   p->iStatement = 0;
@@ -2638,6 +2644,14 @@ int sqlite3VdbeReset(Vdbe *p){
   */
   Cleanup(p);
 
+  /* The memory of the run has just been returned, so this is a good
+  ** moment to move unused lookaside chunks to the size classes that
+  ** ran short.
+  */
+  if( db->lookaside.nMiss>=SQLITE_LOOKASIDE_ADAPT ){
+    sqlite3LookasideAdapt(db);
+  }
+
   /* 保存在VDBE运行是产生的分析信息
   opcode：表示具体执行什么样的操作
   cnt：指令会被执行多少次
@@ -2936,6 +2950,104 @@ u32 sqlite3VdbeSerialTypeLen(u32 serial_type){
   }
 }
 
+/*
+** Content sizes for the serial types that fit in a single-byte varint.
+** sqlite3VdbeDecodeHeader() uses this to avoid calling
+** sqlite3VdbeSerialTypeLen() for each column.
+*/
+#define ST(X) (((X)-12)/2), (((X)-11)/2)
+static const u8 aSerialLen1[128] = {
+  0, 1, 2, 3, 4, 6, 8, 8, 0, 0, 0, 0,
+  ST(12), ST(14), ST(16), ST(18), ST(20), ST(22), ST(24), ST(26), ST(28),
+  ST(30), ST(32), ST(34), ST(36), ST(38), ST(40), ST(42), ST(44), ST(46),
+  ST(48), ST(50), ST(52), ST(54), ST(56), ST(58), ST(60), ST(62), ST(64),
+  ST(66), ST(68), ST(70), ST(72), ST(74), ST(76), ST(78), ST(80), ST(82),
+  ST(84), ST(86), ST(88), ST(90), ST(92), ST(94), ST(96), ST(98), ST(100),
+  ST(102), ST(104), ST(106), ST(108), ST(110), ST(112), ST(114), ST(116),
+  ST(118), ST(120), ST(122), ST(124), ST(126)
+};
+#undef ST
+
+/*
+** Decode the serial types of the first nField columns of a record.  The
+** serial types start at zIdx and the header ends just before zEndHdr.
+** *pOffset is the offset of the content of the first column on input.
+**
+** For each column i, aType[i] is set to its serial type and aOffset[i]
+** to the offset of its content.  aOffset[i] is set to zero for columns
+** past the end of the header.  On return *pOffset holds the offset just
+** past the content of the last column present.
+**
+** The header bytes are examined eight at a time.  When all eight are less
+** than 0x80, as they are for nearly every record, they are eight complete
+** single-byte serial types and are decoded without any varint logic.
+**
+** Return a pointer to the byte following the last serial type read.  If
+** the content offset overflows, a pointer past zEndHdr is returned so
+** that the caller reports corruption.
+*/
+const u8 *sqlite3VdbeDecodeHeader(
+  const u8 *zIdx,          /* First serial type in the record header */
+  const u8 *zEndHdr,       /* First byte past the end of the header */
+  int nField,              /* Number of columns to decode */
+  u32 *aType,              /* OUT: Serial type of each column */
+  u32 *aOffset,            /* OUT: Offset of the content of each column */
+  u32 *pOffset             /* IN/OUT: Offset of the next column's content */
+){
+  u32 offset = *pOffset;
+  u32 szField;
+  u32 t;
+  int i = 0;
+
+  while( i<nField ){
+    if( i+8<=nField && zEndHdr-zIdx>=8 ){
+      u64 w;
+      memcpy(&w, zIdx, 8);
+      if( (w & ((((u64)0x80808080)<<32) | (u64)0x80808080))==0 ){
+        u32 iStart = offset;
+        int j;
+        for(j=0; j<8; j++){
+          aOffset[i+j] = offset;
+          aType[i+j] = zIdx[j];
+          offset += aSerialLen1[zIdx[j]];
+        }
+        zIdx += 8;
+        i += 8;
+        /* Eight columns add at most 8*57 bytes, so a wrap-around shows
+        ** up as the offset decreasing. */
+        if( offset<iStart ){
+          zIdx = &zEndHdr[1];  /* Forces SQLITE_CORRUPT return */
+          break;
+        }
+        continue;
+      }
+    }
+    if( zIdx<zEndHdr ){
+      aOffset[i] = offset;
+      if( zIdx[0]<0x80 ){
+        t = zIdx[0];
+        zIdx++;
+        szField = aSerialLen1[t];
+      }else{
+        zIdx += sqlite3GetVarint32(zIdx, &t);
+        szField = sqlite3VdbeSerialTypeLen(t);
+      }
+      aType[i] = t;
+      offset += szField;
+      if( offset<szField ){  /* True if offset overflows */
+        zIdx = &zEndHdr[1];  /* Forces SQLITE_CORRUPT return */
+        break;
+      }
+    }else{
+      /* Fewer fields in the record than the caller asked for */
+      aOffset[i] = 0;
+    }
+    i++;
+  }
+  *pOffset = offset;
+  return zIdx;
+}
+
 /*如果说我们需要在一个架构上面实现一个混合浮点数（例如：ARM7）那么我们需要讲低四位字节和高四位字节
   交换。然后在返回我们的结果。对于大多数硬件架构来说，不需要这样处理。
   混合浮点数问题在ARM7架构上只会出现在使用GCC时，在ARM7芯片上面不会出现异常。出现这样问题的原因是早期
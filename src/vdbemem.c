@@ -240,18 +240,22 @@ int sqlite3VdbeMemStringify(Mem *pMem, int enc){
 
   /* For a Real or Integer, use sqlite3_mprintf() to produce the UTF-8
   ** string representation of the value. Then, if the required encoding
-  ** is UTF-16le or UTF-16be do a translation.
+  ** is UTF-16le or UTF-16be do a translation.  Integers and whole-number
+  ** reals are rendered directly, without going through sqlite3_mprintf().
   ** 对于一个整数或者实数,使用sqlite3_mprintf()函数来产生代表这个值的UTF-8编码方式的字符串表示.
   ** 然后,如果这个被要求的编码方式是UTF-16le或者UTF-16be那就做一个转换.
   ** FIX ME: It would be better if sqlite3_snprintf() could do UTF-16.
   */
   if( fg & MEM_Int ){
-    sqlite3_snprintf(nByte, pMem->z, "%lld", pMem->u.i);
+    pMem->n = sqlite3Int64ToText(pMem->u.i, pMem->z);
   }else{
     assert( fg & MEM_Real );
-    sqlite3_snprintf(nByte, pMem->z, "%!.15g", pMem->r);
+    pMem->n = sqlite3RealToText(pMem->r, pMem->z);
+    if( pMem->n==0 ){
+      sqlite3_snprintf(nByte, pMem->z, "%!.15g", pMem->r);
+      pMem->n = sqlite3Strlen30(pMem->z);
+    }
   }
-  pMem->n = sqlite3Strlen30(pMem->z);
   pMem->enc = SQLITE_UTF8;
   pMem->flags |= MEM_Str|MEM_Term;
   sqlite3VdbeChangeEncoding(pMem, enc);
@@ -610,7 +614,7 @@ void sqlite3VdbeMemSetRowSet(Mem *pMem){
   assert( db!=0 );
   assert( (pMem->flags & MEM_RowSet)==0 );
   sqlite3VdbeMemRelease(pMem);
-  pMem->zMalloc = sqlite3DbMallocRaw(db, 64);
+  pMem->zMalloc = sqlite3DbMallocRaw(db, 80);
   if( db->mallocFailed ){
     pMem->flags = MEM_Null;
   }else{
@@ -1211,6 +1215,162 @@ no_mem:
   return SQLITE_NOMEM;
 }
 
+/*
+** Evaluate the literal pExpr of a VALUES row for
+** sqlite3ValueRecordsFromExpr().  Numbers are converted the way
+** codeInteger() and codeReal() in expr.c code them, so that 1.0 and 2e3
+** are stored as reals and oversized integers as reals, just as they are
+** when the row is coded with OP_Integer, OP_Int64 or OP_Real.  Strings,
+** blobs and NULL are left to sqlite3ValueFromExpr() with no affinity.
+** 按照codeInteger()和codeReal()的方式计算VALUES行中的常量。
+*/
+static int valuesRowLiteral(
+  sqlite3 *db,              /* The database connection 数据库连接*/
+  Expr *pExpr,              /* The literal to evaluate */
+  u8 enc,                   /* Encoding to use 用于编码*/
+  sqlite3_value **ppVal     /* Write the new value here 写入新的值*/
+){
+  Expr *p = pExpr;
+  int negFlag = 0;
+  sqlite3_value *pVal;
+
+  if( p->op==TK_UMINUS ){
+    p = p->pLeft;
+    negFlag = 1;
+  }
+  if( p->op!=TK_INTEGER && p->op!=TK_FLOAT ){
+    return sqlite3ValueFromExpr(db, pExpr, enc, SQLITE_AFF_NONE, ppVal);
+  }
+  pVal = sqlite3ValueNew(db);
+  if( pVal==0 ){
+    *ppVal = 0;
+    return SQLITE_NOMEM;
+  }
+  if( ExprHasProperty(p, EP_IntValue) ){
+    sqlite3VdbeMemSetInt64(pVal, negFlag ? -(i64)p->u.iValue : p->u.iValue);
+  }else{
+    const char *z = p->u.zToken;
+    i64 value;
+    int c = 1;
+    assert( z!=0 );
+    if( p->op==TK_INTEGER ){
+      c = sqlite3Atoi64(z, &value, sqlite3Strlen30(z), SQLITE_UTF8);
+    }
+    if( c==0 || (c==2 && negFlag) ){
+      if( negFlag ){ value = c==2 ? SMALLEST_INT64 : -value; }
+      sqlite3VdbeMemSetInt64(pVal, value);
+    }else{
+#ifndef SQLITE_OMIT_FLOATING_POINT
+      double r;
+      sqlite3AtoF(z, &r, sqlite3Strlen30(z), SQLITE_UTF8);
+      assert( !sqlite3IsNaN(r) );
+      sqlite3VdbeMemSetDouble(pVal, negFlag ? -r : r);
+#else
+      sqlite3ValueFree(pVal);
+      return sqlite3ValueFromExpr(db, pExpr, enc, SQLITE_AFF_NONE, ppVal);
+#endif
+    }
+  }
+  sqlite3VdbeMemStoreType(pVal);
+  *ppVal = pVal;
+  return SQLITE_OK;
+}
+
+/*
+** Encode the values of the nRow expression lists in apRow[] as a blob
+** holding nRow records, in the format built by OP_MakeRecord and with
+** text in encoding enc.  This is the P4 operand of OP_ValuesRow.  Every
+** list must have the same number of expressions, and each expression
+** must be a literal that valuesRowLiteral() can evaluate.
+** 将apRow[]中nRow个表达式列表的值编码为一个包含nRow条记录的blob。
+**
+** Write a new sqlite3_value holding the blob to *ppVal and return
+** SQLITE_OK, or set *ppVal to NULL and return an error code.  The
+** caller must free the value with sqlite3ValueFree().
+*/
+int sqlite3ValueRecordsFromExpr(
+  sqlite3 *db,              /* The database connection 数据库连接*/
+  ExprList **apRow,         /* Expression lists, one for each record */
+  int nRow,                 /* Number of entries in apRow[] */
+  u8 enc,                   /* Encoding to use 用于编码*/
+  sqlite3_value **ppVal     /* Write the new value here 写入新的值*/
+){
+  int nCol = apRow[0]->nExpr;  /* Number of fields in each record */
+  sqlite3_value **apVal;       /* Values of the current row */
+  u8 *z = 0;                   /* The blob of records */
+  i64 n = 0;                   /* Bytes of z[] used so far */
+  i64 nAlloc = 0;              /* Bytes allocated for z[] */
+  int rc = SQLITE_OK;
+  int i, j;
+
+  *ppVal = 0;
+  apVal = sqlite3DbMallocZero(db, nCol*sizeof(apVal[0]));
+  if( apVal==0 ) return SQLITE_NOMEM;
+  for(i=0; i<nRow && rc==SQLITE_OK; i++){
+    u32 nHdr = 0;              /* Size of the record header */
+    u32 nData = 0;             /* Size of the record content */
+    int nVarint;               /* Size of the header size varint */
+    u32 t;                     /* A serial type */
+
+    assert( apRow[i]->nExpr==nCol );
+    for(j=0; j<nCol && rc==SQLITE_OK; j++){
+      rc = valuesRowLiteral(db, apRow[i]->a[j].pExpr, enc, &apVal[j]);
+      if( rc==SQLITE_OK ){
+        assert( apVal[j]!=0 );
+        t = sqlite3VdbeSerialType(apVal[j], SQLITE_MAX_FILE_FORMAT);
+        nData += sqlite3VdbeSerialTypeLen(t);
+        nHdr += sqlite3VarintLen(t);
+      }
+    }
+    if( rc==SQLITE_OK ){
+      nHdr += nVarint = sqlite3VarintLen(nHdr);
+      if( nVarint<sqlite3VarintLen(nHdr) ){
+        nHdr++;
+      }
+      if( n+nHdr+nData>db->aLimit[SQLITE_LIMIT_LENGTH] ){
+        rc = SQLITE_TOOBIG;
+      }else if( n+nHdr+nData>nAlloc ){
+        u8 *zNew;
+        nAlloc = 2*(n+nHdr+nData);
+        zNew = sqlite3DbRealloc(db, z, nAlloc);
+        if( zNew==0 ){
+          rc = SQLITE_NOMEM;
+        }else{
+          z = zNew;
+        }
+      }
+    }
+    if( rc==SQLITE_OK ){
+      u32 iHdr = putVarint32(&z[n], nHdr);
+      u32 iData = nHdr;
+      for(j=0; j<nCol; j++){
+        t = sqlite3VdbeSerialType(apVal[j], SQLITE_MAX_FILE_FORMAT);
+        iHdr += putVarint32(&z[n+iHdr], t);
+        iData += sqlite3VdbeSerialPut(&z[n+iData], (int)(nAlloc-n-iData),
+                                      apVal[j], SQLITE_MAX_FILE_FORMAT);
+      }
+      assert( iHdr==nHdr && iData==nHdr+nData );
+      n += iData;
+    }
+    for(j=0; j<nCol; j++){
+      sqlite3ValueFree(apVal[j]);
+      apVal[j] = 0;
+    }
+  }
+  sqlite3DbFree(db, apVal);
+  if( rc==SQLITE_OK ){
+    *ppVal = sqlite3ValueNew(db);
+    if( *ppVal==0 ){
+      rc = SQLITE_NOMEM;
+    }else{
+      sqlite3VdbeMemSetStr(*ppVal, (char*)z, (int)n, 0, SQLITE_DYNAMIC);
+      return SQLITE_OK;
+    }
+  }
+  sqlite3DbFree(db, z);
+  return rc;
+}
+
 /*
 ** Change the string value of an sqlite3_value object改变这个对象的字符串值
 */
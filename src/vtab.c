@@ -1013,6 +1013,7 @@ FuncDef *sqlite3VtabOverloadFunction(
   pNew->xFunc = xFunc;
   pNew->pUserData = pArg;
   pNew->flags |= SQLITE_FUNC_EPHEM;
+  pNew->flags &= ~SQLITE_FUNC_CONSTANT;  /* Result may depend on the cursor */
   return pNew;
 }
 
@@ -651,6 +651,95 @@ static WhereTerm *findTerm(
   return 0;
 }
 
+/*
+** Search for a term in the WHERE clause that can be used with the
+** iIdxCol-th column of index pIdx on cursor iCur.  An iIdxCol equal to
+** pIdx->nColumn refers to the rowid that follows the indexed columns.
+**
+** For an ordinary column this is the same as findTerm().  An expression
+** column (XN_EXPR) matches a term whose left-hand side is the same
+** expression as the index holds, compared with the same collating
+** sequence as the index uses.
+*/
+static WhereTerm *findIndexTerm(
+  WhereClause *pWC,     /* The WHERE clause to be searched */
+  int iCur,             /* Cursor number of the table pIdx is on */
+  Index *pIdx,          /* The index */
+  int iIdxCol,          /* Column of the index */
+  Bitmask notReady,     /* RHS must not overlap with this mask */
+  u32 op                /* Mask of WO_xx values describing operator */
+){
+  WhereTerm *pTerm;
+  Expr *pIdxExpr;
+  int k;
+  if( iIdxCol>=pIdx->nColumn ){
+    return findTerm(pWC, iCur, -1, notReady, op, 0);
+  }
+  if( pIdx->aiColumn[iIdxCol]!=XN_EXPR ){
+    return findTerm(pWC, iCur, pIdx->aiColumn[iIdxCol], notReady, op, pIdx);
+  }
+  assert( pIdx->aColExpr!=0 );
+  pIdxExpr = pIdx->aColExpr->a[iIdxCol].pExpr;
+  op &= WO_ALL;
+  for(; pWC; pWC=pWC->pOuter){
+    for(pTerm=pWC->a, k=pWC->nTerm; k; k--, pTerm++){
+      if( pTerm->leftCursor==iCur
+         && (pTerm->prereqRight & notReady)==0
+         && pTerm->u.leftColumn==XN_EXPR
+         && (pTerm->eOperator & op)!=0
+         && sqlite3ExprCompareIndexExpr(pTerm->pExpr->pLeft, pIdxExpr, iCur)
+      ){
+        if( pTerm->eOperator!=WO_ISNULL ){
+          Expr *pX = pTerm->pExpr;
+          CollSeq *pColl;
+          pColl = sqlite3BinaryCompareCollSeq(pWC->pParse, pX->pLeft, pX->pRight);
+          if( pColl && sqlite3StrICmp(pColl->zName, pIdx->azColl[iIdxCol]) ){
+            continue;
+          }
+        }
+        return pTerm;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+** Expression pExpr is one side of a comparison and prereq is the set of
+** tables it uses.  If it reads exactly one table of the FROM clause and
+** is the same as an expression column of some index on that table, then
+** return the cursor number of the table.  Otherwise return -1.
+*/
+static int exprIndexedCursor(
+  SrcList *pSrc,            /* The FROM clause */
+  WhereMaskSet *pMaskSet,   /* Mapping from tables to bitmaps */
+  Expr *pExpr,              /* The expression to look for */
+  Bitmask prereq            /* Tables used by pExpr */
+){
+  int i;
+  if( prereq==0 || (prereq & (prereq-1))!=0 ) return -1;
+  for(i=0; i<pSrc->nSrc; i++){
+    struct SrcList_item *pItem = &pSrc->a[i];
+    Index *pIdx;
+    if( getMask(pMaskSet, pItem->iCursor)!=prereq ) continue;
+    if( pItem->pTab==0 ) return -1;
+    for(pIdx=pItem->pTab->pIndex; pIdx; pIdx=pIdx->pNext){
+      int j;
+      if( pIdx->aColExpr==0 ) continue;
+      for(j=0; j<pIdx->nColumn; j++){
+        if( pIdx->aiColumn[j]==XN_EXPR
+         && sqlite3ExprCompareIndexExpr(pExpr, pIdx->aColExpr->a[j].pExpr,
+                                        pItem->iCursor)
+        ){
+          return pItem->iCursor;
+        }
+      }
+    }
+    return -1;
+  }
+  return -1;
+}
+
 /* Forward reference */
 static void exprAnalyze(SrcList*, WhereClause*, int);
 
@@ -1062,7 +1151,8 @@ static void exprAnalyzeOrTerm(
         assert( pOrTerm->eOperator==WO_EQ );
         if( pOrTerm->leftCursor!=iCursor ){
           pOrTerm->wtFlags &= ~TERM_OR_OK;
-        }else if( pOrTerm->u.leftColumn!=iColumn ){
+        }else if( pOrTerm->u.leftColumn!=iColumn || iColumn==XN_EXPR ){
+          /* Two index expressions need not be the same expression */
           okToChngToIN = 0;
         }else{
           int affLeft, affRight;
@@ -1196,12 +1286,25 @@ static void exprAnalyze(
   if( allowedOp(op) && (pTerm->prereqRight & prereqLeft)==0 ){
     Expr *pLeft = pExpr->pLeft;
     Expr *pRight = pExpr->pRight;
+    int iCurRight = -1;    /* Cursor if pRight matches an index expression */
     if( pLeft->op==TK_COLUMN ){
       pTerm->leftCursor = pLeft->iTable;
       pTerm->u.leftColumn = pLeft->iColumn;
       pTerm->eOperator = operatorMask(op);
+    }else{
+      /* An expression that some index holds is as good as a column */
+      int iCurLeft = exprIndexedCursor(pSrc, pMaskSet, pLeft, prereqLeft);
+      if( iCurLeft>=0 ){
+        pTerm->leftCursor = iCurLeft;
+        pTerm->u.leftColumn = XN_EXPR;
+        pTerm->eOperator = operatorMask(op);
+      }
+    }
+    if( pRight && pRight->op!=TK_COLUMN ){
+      iCurRight = exprIndexedCursor(pSrc, pMaskSet, pRight,
+                                    pTerm->prereqRight);
     }
-    if( pRight && pRight->op==TK_COLUMN ){
+    if( pRight && (pRight->op==TK_COLUMN || iCurRight>=0) ){
       WhereTerm *pNew;
       Expr *pDup;
       if( pTerm->leftCursor>=0 ){
@@ -1224,8 +1327,13 @@ static void exprAnalyze(
       }
       exprCommute(pParse, pDup);
       pLeft = pDup->pLeft;
-      pNew->leftCursor = pLeft->iTable;
-      pNew->u.leftColumn = pLeft->iColumn;
+      if( iCurRight>=0 ){
+        pNew->leftCursor = iCurRight;
+        pNew->u.leftColumn = XN_EXPR;
+      }else{
+        pNew->leftCursor = pLeft->iTable;
+        pNew->u.leftColumn = pLeft->iColumn;
+      }
       testcase( (prereqLeft | extraRight) != prereqLeft );
       pNew->prereqRight = prereqLeft | extraRight;
       pNew->prereqAll = prereqAll;
@@ -1616,8 +1724,7 @@ static int isDistinctRedundant(
   for(pIdx=pTab->pIndex; pIdx; pIdx=pIdx->pNext){
     if( pIdx->onError==OE_None ) continue;
     for(i=0; i<pIdx->nColumn; i++){
-      int iCol = pIdx->aiColumn[i];
-      if( 0==findTerm(pWC, iBase, iCol, ~(Bitmask)0, WO_EQ, pIdx) ){
+      if( 0==findIndexTerm(pWC, iBase, pIdx, i, ~(Bitmask)0, WO_EQ) ){
         int iIdxCol = findIndexCol(pParse, pDistinct, iBase, pIdx, i);
         if( iIdxCol<0 || pTab->aCol[pIdx->aiColumn[i]].notNull==0 ){
           break;
@@ -1716,11 +1823,18 @@ static int isSortingIndex(
 	  CollSeq *pColl;    /* The collating sequence of pExpr *//* 排序序列pExpr*/
 	  int termSortOrder; /* Sort order for this term *//*对此项进行排序*/
 	  int iColumn;       /* The i-th column of the index.  -1 for rowid *//* 索引中的第i列*/
+	  int iExprCol;      /* Column of pExpr, or XN_EXPR for an expression *//* pExpr对应的列*/
 	  int iSortOrder;    /* 1 for DESC, 0 for ASC on the i-th index term *//* 第i个索引项中，DESC码为1，ASC码为0*/
 	  const char *zColl; /* Name of the collating sequence for i-th index term *//* 第i个索引项中排序序列的名称*/
 
     pExpr = pTerm->pExpr;
-    if( pExpr->op!=TK_COLUMN || pExpr->iTable!=base ){
+    if( pExpr->op==TK_COLUMN && pExpr->iTable==base ){
+      iExprCol = pExpr->iColumn;
+    }else if( pExpr->op!=TK_COLUMN && pIdx->aColExpr
+           && exprTableUsage(pMaskSet, pExpr)==getMask(pMaskSet, base) ){
+      /* Might match an expression column of the index */
+      iExprCol = XN_EXPR;
+    }else{
       /* Can not use an index sort on anything that is not a column in the
       ** left-most table of the FROM clause */
 	  /*  如果不是FROM子句中最左边表格的一个列则不能对任意项使用索引排序。
@@ -1743,7 +1857,10 @@ static int isSortingIndex(
       iSortOrder = 0;
       zColl = pColl->zName;
     }
-    if( pExpr->iColumn!=iColumn || sqlite3StrICmp(pColl->zName, zColl) ){
+    if( iExprCol!=iColumn || sqlite3StrICmp(pColl->zName, zColl)
+     || (iColumn==XN_EXPR && !sqlite3ExprCompareIndexExpr(pExpr,
+                                   pIdx->aColExpr->a[i].pExpr, base))
+    ){
       /* Term j of the ORDER BY clause does not match column i of the index */
       /* ORDER BY子句中的j项不匹配索引中的i列。
 	  */
@@ -1788,7 +1905,7 @@ static int isSortingIndex(
     }
     j++;
     pTerm++;
-    if( iColumn<0 && !referencesOtherTables(pOrderBy, pMaskSet, j, base) ){
+    if( iColumn==-1 && !referencesOtherTables(pOrderBy, pMaskSet, j, base) ){
       /* If the indexed column is the primary key and everything matches
       ** so far and none of the ORDER BY terms to the right reference other
       ** tables in the join, then we are assured that the index can be used 
@@ -1834,6 +1951,7 @@ static int isSortingIndex(
 	** 值,那么这个索引提供行所需的顺序。
 	*/
     for(i=nEqCol; i<pIdx->nColumn; i++){
+      if( pIdx->aiColumn[i]==XN_EXPR ) break;
       if( aCol[pIdx->aiColumn[i]].notNull==0 ) break;
     }
     return (i==pIdx->nColumn);
@@ -2045,6 +2163,7 @@ struct SrcList_item *pSrc,     /* Table we are trying to access *//* 尝试登
   if( pTerm->leftCursor!=pSrc->iCursor ) return 0;
   if( pTerm->eOperator!=WO_EQ ) return 0;
   if( (pTerm->prereqRight & notReady)!=0 ) return 0;
+  if( pTerm->u.leftColumn<0 ) return 0;
   aff = pSrc->pTab->aCol[pTerm->u.leftColumn].affinity;
   if( !sqlite3IndexAffinityOk(pTerm->pExpr, aff) ) return 0;
   return 1;
@@ -3003,7 +3122,8 @@ static int whereRangeScanEst(
     tRowcnt iLower = 0;
     tRowcnt iUpper = p->aiRowEst[0];
     tRowcnt a[2];
-    u8 aff = p->pTable->aCol[p->aiColumn[0]].affinity;
+    u8 aff = p->aiColumn[0]==XN_EXPR ? SQLITE_AFF_NONE :
+                 p->pTable->aCol[p->aiColumn[0]].affinity;
 
     if( pLower ){
       Expr *pExpr = pLower->pExpr->pRight;
@@ -3095,7 +3215,8 @@ static int whereEqualScanEst(
 
   assert( p->aSample!=0 );
   assert( p->nSample>0 );
-  aff = p->pTable->aCol[p->aiColumn[0]].affinity;
+  aff = p->aiColumn[0]==XN_EXPR ? SQLITE_AFF_NONE :
+            p->pTable->aCol[p->aiColumn[0]].affinity;
   if( pExpr ){
     rc = valueFromExpr(pParse, pExpr, aff, &pRhs);
     if( rc ) goto whereEqualScanEst_cancel;
@@ -3390,8 +3511,7 @@ static void bestBtreeIndex(
     计算nEq和nInMul值
     */
     for(nEq=0; nEq<pProbe->nColumn; nEq++){
-      int j = pProbe->aiColumn[nEq];
-      pTerm = findTerm(pWC, iCur, j, notReady, eqTermMask, pIdx);
+      pTerm = findIndexTerm(pWC, iCur, pProbe, nEq, notReady, eqTermMask);
       if( pTerm==0 ) break;
       wsFlags |= (WHERE_COLUMN_EQ|WHERE_ROWID_EQ);
       testcase( pTerm->pWC!=pWC );
@@ -3436,10 +3556,11 @@ static void bestBtreeIndex(
         wsFlags |= WHERE_UNIQUE;
       }
     }else if( pProbe->bUnordered==0 ){
-      int j = (nEq==pProbe->nColumn ? -1 : pProbe->aiColumn[nEq]);
-      if( findTerm(pWC, iCur, j, notReady, WO_LT|WO_LE|WO_GT|WO_GE, pIdx) ){
-        WhereTerm *pTop = findTerm(pWC, iCur, j, notReady, WO_LT|WO_LE, pIdx);
-        WhereTerm *pBtm = findTerm(pWC, iCur, j, notReady, WO_GT|WO_GE, pIdx);
+      if( findIndexTerm(pWC, iCur, pProbe, nEq, notReady,
+                        WO_LT|WO_LE|WO_GT|WO_GE) ){
+        WhereTerm *pTop, *pBtm;
+        pTop = findIndexTerm(pWC, iCur, pProbe, nEq, notReady, WO_LT|WO_LE);
+        pBtm = findIndexTerm(pWC, iCur, pProbe, nEq, notReady, WO_GT|WO_GE);
         //估计范围条件的代价
         whereRangeScanEst(pParse, pProbe, nEq, pBtm, pTop, &rangeDiv);
         if( pTop ){
@@ -3502,7 +3623,7 @@ static void bestBtreeIndex(
       int j;
       for(j=0; j<pIdx->nColumn; j++){
         int x = pIdx->aiColumn[j];
-        if( x<BMS-1 ){
+        if( x>=0 && x<BMS-1 ){
           m &= ~(((Bitmask)1)<<x);
         }
       }
@@ -4075,8 +4196,7 @@ static int codeAllEqualityTerms(
   assert( pIdx->nColumn>=nEq );
   for(j=0; j<nEq; j++){
     int r1;
-    int k = pIdx->aiColumn[j];
-    pTerm = findTerm(pWC, iCur, k, notReady, pLevel->plan.wsFlags, pIdx);
+    pTerm = findIndexTerm(pWC, iCur, pIdx, j, notReady, pLevel->plan.wsFlags);
     if( pTerm==0 ) break;
     /* The following true for indices with redundant columns. 
     以下适用于索引和冗余列。
@@ -4175,16 +4295,19 @@ static char *explainIndexRange(sqlite3 *db, WhereLevel *pLevel, Table *pTab){
   txt.db = db;
   sqlite3StrAccumAppend(&txt, " (", 2);
   for(i=0; i<nEq; i++){
-    explainAppendTerm(&txt, i, aCol[aiColumn[i]].zName, "=");
+    const char *z = aiColumn[i]==XN_EXPR ? "<expr>" : aCol[aiColumn[i]].zName;
+    explainAppendTerm(&txt, i, z, "=");
   }
 
   j = i;
   if( pPlan->wsFlags&WHERE_BTM_LIMIT ){
-    char *z = (j==pIndex->nColumn ) ? "rowid" : aCol[aiColumn[j]].zName;
+    const char *z = (j==pIndex->nColumn ) ? "rowid" :
+                    aiColumn[j]==XN_EXPR ? "<expr>" : aCol[aiColumn[j]].zName;
     explainAppendTerm(&txt, i++, z, ">");
   }
   if( pPlan->wsFlags&WHERE_TOP_LIMIT ){
-    char *z = (j==pIndex->nColumn ) ? "rowid" : aCol[aiColumn[j]].zName;
+    const char *z = (j==pIndex->nColumn ) ? "rowid" :
+                    aiColumn[j]==XN_EXPR ? "<expr>" : aCol[aiColumn[j]].zName;
     explainAppendTerm(&txt, i, z, "<");
   }
   sqlite3StrAccumAppend(&txt, ")", 1);
@@ -4574,7 +4697,6 @@ static Bitmask codeOneLoopStart(
 
     pIdx = pLevel->plan.u.pIdx;
     iIdxCur = pLevel->iIdxCur;
-    k = (nEq==pIdx->nColumn ? -1 : pIdx->aiColumn[nEq]);
 
     /* If this loop satisfies a sort order (pOrderBy) request that 
     ** was passed to this function to implement a "SELECT min(x) ..." 
@@ -4604,11 +4726,11 @@ static Bitmask codeOneLoopStart(
     找到任何不等式约束条件范围的开始和结束。
     */
     if( pLevel->plan.wsFlags & WHERE_TOP_LIMIT ){
-      pRangeEnd = findTerm(pWC, iCur, k, notReady, (WO_LT|WO_LE), pIdx);
+      pRangeEnd = findIndexTerm(pWC, iCur, pIdx, nEq, notReady, (WO_LT|WO_LE));
       nExtraReg = 1;
     }
     if( pLevel->plan.wsFlags & WHERE_BTM_LIMIT ){
-      pRangeStart = findTerm(pWC, iCur, k, notReady, (WO_GT|WO_GE), pIdx);
+      pRangeStart = findIndexTerm(pWC, iCur, pIdx, nEq, notReady, (WO_GT|WO_GE));
       nExtraReg = 1;
     }
 
@@ -5768,6 +5890,35 @@ WhereInfo *sqlite3WhereBegin(
   pWInfo->iTop = sqlite3VdbeCurrentAddr(v);
   if( db->mallocFailed ) goto whereBeginError;
 
+  /* Within the loops, an expression held by an index that is being
+  ** scanned is read from the index rather than computed again.  Not for
+  ** the right table of a LEFT JOIN though, as on the NULL row the index
+  ** gives NULL where the expression might not.  sqlite3WhereEnd() takes
+  ** these entries off the list again.
+  */
+  pWInfo->pSavedIdxExpr = pParse->pIdxExpr;
+  for(i=0; i<nTabList; i++){
+    Index *pIx;
+    int j;
+    pLevel = &pWInfo->a[i];
+    if( (pLevel->plan.wsFlags & WHERE_INDEXED)==0 ) continue;
+    if( (pTabList->a[pLevel->iFrom].jointype & JT_LEFT)!=0 ) continue;
+    pIx = pLevel->plan.u.pIdx;
+    if( pIx->aColExpr==0 ) continue;
+    for(j=0; j<pIx->nColumn; j++){
+      IndexedExpr *p;
+      if( pIx->aiColumn[j]!=XN_EXPR ) continue;
+      p = sqlite3DbMallocRaw(db, sizeof(IndexedExpr));
+      if( p==0 ) break;
+      p->pExpr = pIx->aColExpr->a[j].pExpr;
+      p->iDataCur = pLevel->iTabCur;
+      p->iIdxCur = pLevel->iIdxCur;
+      p->iIdxCol = j;
+      p->pIENext = pParse->pIdxExpr;
+      pParse->pIdxExpr = p;
+    }
+  }
+
   /* Generate the code to do the search.  Each iteration of the for
   ** loop below generates code for a single nested loop of the VM
   ** program.
@@ -5983,6 +6134,11 @@ void sqlite3WhereEnd(WhereInfo *pWInfo){
 
   /* Final cleanup 最后清理
   */
+  while( pParse->pIdxExpr!=pWInfo->pSavedIdxExpr ){
+    IndexedExpr *p = pParse->pIdxExpr;
+    pParse->pIdxExpr = p->pIENext;
+    sqlite3DbFree(db, p);
+  }
   pParse->nQueryLoop = pWInfo->savedNQueryLoop;
   whereInfoFree(db, pWInfo);
   return;